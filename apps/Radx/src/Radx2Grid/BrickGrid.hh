@@ -0,0 +1,140 @@
+#ifndef RADX_RADX2GRID_BRICK_GRID_H_
+#define RADX_RADX2GRID_BRICK_GRID_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+// Sparse 3D grid stored as 8x8x8 bricks, each allocated the first time
+// one of its cells is written with at(). Reads with get() of cells in
+// bricks never written return the fill value, without allocating.
+//
+// Bricks are allocated lock-free, so at() may be called from many
+// threads at once. As with vector3d, updates of the cells themselves
+// need the caller's own locking. Cells within a brick are stored with
+// k varying fastest, then j, then i, matching vector3d.
+
+template <typename T>
+class BrickGrid
+{
+public:
+  static const int BRICK_BITS = 3;
+  static const int BRICK_SIZE = 1 << BRICK_BITS;
+  static const int BRICK_MASK = BRICK_SIZE - 1;
+  static const int BRICK_CELLS = BRICK_SIZE * BRICK_SIZE * BRICK_SIZE;
+
+  BrickGrid(int nx, int ny, int nz, T fill = T())
+    : _nx(nx)
+    , _ny(ny)
+    , _nz(nz)
+    , _nbx((nx + BRICK_MASK) >> BRICK_BITS)
+    , _nby((ny + BRICK_MASK) >> BRICK_BITS)
+    , _nbz((nz + BRICK_MASK) >> BRICK_BITS)
+    , _fill(fill)
+    , _bricks(new std::atomic<T*>[size_t(_nbx) * _nby * _nbz])
+    , _nAllocated(0)
+  {
+    for (size_t ib = 0; ib < getNBricks(); ib++) {
+      _bricks[ib].store(nullptr, std::memory_order_relaxed);
+    }
+  }
+
+  ~BrickGrid()
+  {
+    for (size_t ib = 0; ib < getNBricks(); ib++) {
+      delete[] _bricks[ib].load(std::memory_order_relaxed);
+    }
+  }
+
+  BrickGrid(const BrickGrid&) = delete;
+  BrickGrid& operator=(const BrickGrid&) = delete;
+
+  // cell reference, allocating its brick if needed
+  inline T& at(int i, int j, int k)
+  {
+    std::atomic<T*>& slot = _bricks[brickIndex(
+      i >> BRICK_BITS, j >> BRICK_BITS, k >> BRICK_BITS)];
+    T* brick = slot.load(std::memory_order_acquire);
+    if (brick == nullptr) {
+      brick = _allocate(slot);
+    }
+    return brick[cellIndex(i, j, k)];
+  }
+
+  // cell value, the fill value if its brick was never written
+  inline T get(int i, int j, int k) const
+  {
+    const T* brick = getBrick(brickIndex(i >> BRICK_BITS, j >> BRICK_BITS,
+                                         k >> BRICK_BITS));
+    return brick == nullptr ? _fill : brick[cellIndex(i, j, k)];
+  }
+
+  // brick by index, nullptr if never written
+  inline const T* getBrick(size_t ib) const
+  {
+    return _bricks[ib].load(std::memory_order_acquire);
+  }
+
+  inline size_t brickIndex(int bi, int bj, int bk) const
+  {
+    return (size_t(bi) * _nby + bj) * _nbz + bk;
+  }
+
+  static inline int cellIndex(int i, int j, int k)
+  {
+    return (((i & BRICK_MASK) << BRICK_BITS | (j & BRICK_MASK))
+            << BRICK_BITS) |
+           (k & BRICK_MASK);
+  }
+
+  // true if no brick overlapping the cells [i0, i1] x [j0, j1] x [k0, k1]
+  // was written
+  bool isEmpty(int i0, int i1, int j0, int j1, int k0, int k1) const
+  {
+    for (int bi = i0 >> BRICK_BITS; bi <= (i1 >> BRICK_BITS); bi++) {
+      for (int bj = j0 >> BRICK_BITS; bj <= (j1 >> BRICK_BITS); bj++) {
+        for (int bk = k0 >> BRICK_BITS; bk <= (k1 >> BRICK_BITS); bk++) {
+          if (getBrick(brickIndex(bi, bj, bk)) != nullptr) {
+            return false;
+          }
+        }
+      }
+    }
+    return true;
+  }
+
+  inline int getNx() const { return _nx; }
+  inline int getNy() const { return _ny; }
+  inline int getNz() const { return _nz; }
+  inline int getNBricksX() const { return _nbx; }
+  inline int getNBricksY() const { return _nby; }
+  inline int getNBricksZ() const { return _nbz; }
+  inline size_t getNBricks() const { return size_t(_nbx) * _nby * _nbz; }
+  inline size_t getNAllocated() const { return _nAllocated.load(); }
+
+private:
+  int _nx, _ny, _nz;
+  int _nbx, _nby, _nbz;
+  T _fill;
+  std::unique_ptr<std::atomic<T*>[]> _bricks;
+  std::atomic<size_t> _nAllocated;
+
+  // allocate and publish a brick; if another thread got there first,
+  // use its brick instead
+  T* _allocate(std::atomic<T*>& slot)
+  {
+    T* brick = new T[BRICK_CELLS];
+    std::fill(brick, brick + BRICK_CELLS, _fill);
+    T* expected = nullptr;
+    if (slot.compare_exchange_strong(expected, brick,
+                                     std::memory_order_acq_rel)) {
+      _nAllocated.fetch_add(1, std::memory_order_relaxed);
+      return brick;
+    }
+    delete[] brick;
+    return expected;
+  }
+};
+
+#endif // RADX_RADX2GRID_BRICK_GRID_H_
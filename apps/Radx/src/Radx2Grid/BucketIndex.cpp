@@ -0,0 +1,224 @@
+#include "BucketIndex.hh"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_reduce.h>
+
+namespace {
+
+struct _Bounds
+{
+  double lo[SpatialIndex::DIM];
+  double hi[SpatialIndex::DIM];
+
+  _Bounds()
+  {
+    for (int dd = 0; dd < SpatialIndex::DIM; dd++) {
+      lo[dd] = std::numeric_limits<double>::max();
+      hi[dd] = -std::numeric_limits<double>::max();
+    }
+  }
+
+  void join(const _Bounds& rhs)
+  {
+    for (int dd = 0; dd < SpatialIndex::DIM; dd++) {
+      lo[dd] = std::min(lo[dd], rhs.lo[dd]);
+      hi[dd] = std::max(hi[dd], rhs.hi[dd]);
+    }
+  }
+};
+
+} // namespace
+
+BucketIndex::BucketIndex(double cellSize)
+  : _requestedCellSize(cellSize > 0.0 ? cellSize : 1.0)
+  , _cellSize(_requestedCellSize)
+{
+  for (int dd = 0; dd < DIM; dd++) {
+    _origin[dd] = 0.0;
+    _n[dd] = 0;
+  }
+}
+
+void
+BucketIndex::clear()
+{
+  SpatialIndex::clear();
+  _cellStart.clear();
+  for (int dd = 0; dd < DIM; dd++) {
+    _n[dd] = 0;
+  }
+}
+
+void
+BucketIndex::build(const double* coords, size_t nPoints)
+{
+  clear();
+  if (nPoints == 0) {
+    return;
+  }
+
+  // bounding box
+
+  _Bounds bounds = tbb::parallel_reduce(
+    tbb::blocked_range<size_t>(0, nPoints), _Bounds(),
+    [coords](const tbb::blocked_range<size_t>& r, _Bounds b) {
+      for (size_t ii = r.begin(); ii != r.end(); ++ii) {
+        for (int dd = 0; dd < DIM; dd++) {
+          b.lo[dd] = std::min(b.lo[dd], coords[ii * DIM + dd]);
+          b.hi[dd] = std::max(b.hi[dd], coords[ii * DIM + dd]);
+        }
+      }
+      return b;
+    },
+    [](_Bounds a, const _Bounds& b) {
+      a.join(b);
+      return a;
+    });
+
+  // bucket size, grown until the buckets are not too many for the points
+
+  const size_t maxCells = 8 * nPoints + 4096;
+  _cellSize = _requestedCellSize;
+  while (true) {
+    double cells = 1.0;
+    for (int dd = 0; dd < DIM; dd++) {
+      cells *= floor((bounds.hi[dd] - bounds.lo[dd]) / _cellSize) + 1.0;
+    }
+    if (cells <= double(maxCells)) {
+      break;
+    }
+    _cellSize *= 1.26; // doubles the bucket volume
+  }
+  size_t nCells = 1;
+  for (int dd = 0; dd < DIM; dd++) {
+    _origin[dd] = bounds.lo[dd];
+    _n[dd] = int((bounds.hi[dd] - bounds.lo[dd]) / _cellSize) + 1;
+    nCells *= size_t(_n[dd]);
+  }
+
+  // bucket of each point, and the bucket counts
+
+  const double invCellSize = 1.0 / _cellSize;
+  std::vector<int> cellOf(nPoints);
+  std::unique_ptr<std::atomic<int>[]> counts(new std::atomic<int>[nCells]);
+  for (size_t ic = 0; ic < nCells; ic++) {
+    counts[ic].store(0, std::memory_order_relaxed);
+  }
+  tbb::parallel_for(tbb::blocked_range<size_t>(0, nPoints),
+                    [&](const tbb::blocked_range<size_t>& r) {
+                      for (size_t ii = r.begin(); ii != r.end(); ++ii) {
+                        int ic[DIM];
+                        for (int dd = 0; dd < DIM; dd++) {
+                          ic[dd] = std::min(
+                            int((coords[ii * DIM + dd] - _origin[dd]) *
+                                invCellSize),
+                            _n[dd] - 1);
+                        }
+                        cellOf[ii] = int(_cellIndex(ic[0], ic[1], ic[2]));
+                        counts[cellOf[ii]].fetch_add(
+                          1, std::memory_order_relaxed);
+                      }
+                    });
+
+  _cellStart.resize(nCells + 1);
+  _cellStart[0] = 0;
+  for (size_t ic = 0; ic < nCells; ic++) {
+    _cellStart[ic + 1] =
+      _cellStart[ic] + counts[ic].load(std::memory_order_relaxed);
+    counts[ic].store(_cellStart[ic], std::memory_order_relaxed);
+  }
+
+  // scatter the points to their buckets, then restore the input order
+  // within each bucket so the results do not depend on the threading
+
+  std::vector<int> perm(nPoints);
+  tbb::parallel_for(tbb::blocked_range<size_t>(0, nPoints),
+                    [&](const tbb::blocked_range<size_t>& r) {
+                      for (size_t ii = r.begin(); ii != r.end(); ++ii) {
+                        perm[counts[cellOf[ii]].fetch_add(
+                          1, std::memory_order_relaxed)] = int(ii);
+                      }
+                    });
+  tbb::parallel_for(tbb::blocked_range<size_t>(0, nCells),
+                    [&](const tbb::blocked_range<size_t>& r) {
+                      for (size_t ic = r.begin(); ic != r.end(); ++ic) {
+                        std::sort(perm.begin() + _cellStart[ic],
+                                  perm.begin() + _cellStart[ic + 1]);
+                      }
+                    });
+
+  _copyPoints(coords, perm);
+}
+
+int
+BucketIndex::_search(const double* q, int k, double maxDistSq, int* pos,
+                     double* distSq, int nFound) const
+{
+  // bucket of the query, which may lie outside the grid
+
+  int qc[DIM];
+  int maxRing = 0;
+  for (int dd = 0; dd < DIM; dd++) {
+    double fc = floor((q[dd] - _origin[dd]) / _cellSize);
+    qc[dd] = int(std::min(std::max(fc, -1.0), double(_n[dd])));
+    maxRing = std::max(maxRing, std::max(qc[dd], _n[dd] - 1 - qc[dd]));
+  }
+
+  for (int ring = 0; ring <= maxRing; ring++) {
+
+    // buckets at Chebyshev distance ring from the query bucket
+
+    for (int d0 = -ring; d0 <= ring; d0++) {
+      const int ic0 = qc[0] + d0;
+      if (ic0 < 0 || ic0 >= _n[0]) {
+        continue;
+      }
+      for (int d1 = -ring; d1 <= ring; d1++) {
+        const int ic1 = qc[1] + d1;
+        if (ic1 < 0 || ic1 >= _n[1]) {
+          continue;
+        }
+        const bool onFace = d0 == -ring || d0 == ring || d1 == -ring ||
+                            d1 == ring;
+        const int step = onFace ? 1 : std::max(2 * ring, 1);
+        for (int d2 = -ring; d2 <= ring; d2 += step) {
+          const int ic2 = qc[2] + d2;
+          if (ic2 < 0 || ic2 >= _n[2]) {
+            continue;
+          }
+          const size_t ic = _cellIndex(ic0, ic1, ic2);
+          for (int ii = _cellStart[ic]; ii < _cellStart[ic + 1]; ii++) {
+            const double d = _distSq(q, &_coords[size_t(ii) * DIM]);
+            const double bound = nFound == k ? distSq[k - 1] : maxDistSq;
+            if (d <= bound && (nFound < k || d < distSq[k - 1])) {
+              nFound = _insert(k, ii, d, pos, distSq, nFound);
+            }
+          }
+        }
+      }
+    }
+
+    // distance from the query to the outside of the buckets searched so
+    // far - no point beyond can be closer
+
+    double reach = std::numeric_limits<double>::max();
+    for (int dd = 0; dd < DIM; dd++) {
+      const double lo = _origin[dd] + (qc[dd] - ring) * _cellSize;
+      const double hi = _origin[dd] + (qc[dd] + ring + 1) * _cellSize;
+      reach = std::min(reach, std::min(q[dd] - lo, hi - q[dd]));
+    }
+    if (reach > 0.0) {
+      const double reachSq = reach * reach;
+      if (reachSq > maxDistSq ||
+          (nFound == k && distSq[k - 1] <= reachSq)) {
+        break;
+      }
+    }
+  }
+  return nFound;
+}
@@ -0,0 +1,45 @@
+#ifndef RADX_RADX2GRID_BUCKET_INDEX_H_
+#define RADX_RADX2GRID_BUCKET_INDEX_H_
+
+#include "SpatialIndex.hh"
+
+// Read-only index of 3D points in a uniform grid of cubic buckets.
+//
+// The points are counting-sorted by bucket, in parallel, so the points of
+// each bucket are contiguous and a bucket is found by arithmetic alone.
+// A search visits the buckets in rings of increasing distance around the
+// query, and stops once no unvisited bucket can hold a closer point.
+// Suited to points spread fairly evenly, searched within a radius of a
+// few buckets - the reorder search radius, typically.
+
+class BucketIndex : public SpatialIndex
+{
+public:
+  // cellSize: edge of the buckets, in the units of the coordinates.
+  // Grown if needed to keep the number of buckets within a few times
+  // the number of points.
+  BucketIndex(double cellSize);
+
+  void build(const double* coords, size_t nPoints) override;
+  void clear() override;
+
+  inline double getCellSize() const { return _cellSize; }
+
+protected:
+  int _search(const double* q, int k, double maxDistSq, int* pos,
+              double* distSq, int nFound) const override;
+
+private:
+  double _requestedCellSize;
+  double _cellSize;
+  double _origin[DIM];
+  int _n[DIM];
+  std::vector<int> _cellStart; // first point of each bucket, and the end
+
+  inline size_t _cellIndex(int ic0, int ic1, int ic2) const
+  {
+    return (size_t(ic0) * _n[1] + ic1) * _n[2] + ic2;
+  }
+};
+
+#endif // RADX_RADX2GRID_BUCKET_INDEX_H_
@@ -1,13 +1,23 @@
+#include "tbb/blocked_range.h"
 #include "tbb/blocked_range3d.h"
 #include "tbb/compat/thread"
 #include "tbb/parallel_for.h"
+#include "tbb/parallel_sort.h"
 #include "tbb/partitioner.h"
 #include "tbb/spin_mutex.h"
+#include <algorithm>
 #include <assert.h>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
 #include <iostream>
+#include <limits>
 #include <typeinfo>
 
 #include "Cart2Grid.hh"
+#include "Polar2Cartesian.hh"
+#include "SpaceFillingCurve.hh"
+#include "TraceEvents.hh"
 
 ptr_vector3d<double> _grid_el;
 ptr_vector3d<double> _grid_gate;
@@ -20,6 +30,52 @@ tbb::spin_mutex _add_locker1, _add_locker2, _add_locker3;
 
 tbb::affinity_partitioner ap;
 
+// Acquire a spin mutex. While tracing, contended acquisitions are counted
+// so the timeline shows how often the accumulation locks collide.
+inline void
+_acquire(tbb::spin_mutex::scoped_lock& lock, tbb::spin_mutex& mutex,
+         bool tracing, std::atomic<long>& nContended)
+{
+  if (tracing) {
+    if (lock.try_acquire(mutex)) {
+      return;
+    }
+    nContended.fetch_add(1, std::memory_order_relaxed);
+  }
+  lock.acquire(mutex);
+}
+
+// Add the contribution of n gates to a cell of the accumulators, dense or
+// sparse.
+
+inline void
+Cart2Grid::_accumulate(const string& name, int i, int j, int k, double vw,
+                       double w, int n, bool tracing,
+                       std::atomic<long>& nContended)
+{
+  double& sum = _sparse ? _sparseSum[name]->at(i, j, k)
+                        : _outputGridSum[name]->at(i).at(j).at(k);
+  double& weight = _sparse ? _sparseWeight[name]->at(i, j, k)
+                           : _outputGridWeight[name]->at(i).at(j).at(k);
+  int& count = _sparse ? _sparseCount[name]->at(i, j, k)
+                       : _outputGridCount[name]->at(i).at(j).at(k);
+  {
+    tbb::spin_mutex::scoped_lock lock;
+    _acquire(lock, _add_locker1, tracing, nContended);
+    sum += vw;
+  }
+  {
+    tbb::spin_mutex::scoped_lock lock;
+    _acquire(lock, _add_locker2, tracing, nContended);
+    weight += w;
+  }
+  {
+    tbb::spin_mutex::scoped_lock lock;
+    _acquire(lock, _add_locker3, tracing, nContended);
+    count += n;
+  }
+}
+
 template<typename T>
 inline void
 Cart2Grid::_makeGrid(ptr_vector3d<T>& grid)
@@ -38,7 +94,9 @@ Cart2Grid::_makeGrid(ptr_vector3d<T>& grid, T value)
 
 Cart2Grid::Cart2Grid(std::shared_ptr<Repository> store, const Params& params, int nthreads)
   : _store(store)
+  , _sparse(params.sparse_grid_storage)
   , _params(params)
+  , _roi(params)
 {
   _xy_geom = _params.grid_xy_geom;
   _z_geom = _params.grid_z_geom;
@@ -47,6 +105,8 @@ Cart2Grid::Cart2Grid(std::shared_ptr<Repository> store, const Params& params, in
   _DSizeI = _xy_geom.nx;
   _DSizeJ = _xy_geom.ny;
   _DSizeK = _z_geom.nz;
+  _curveBits = SpaceFillingCurve::bitsFor(
+    uint32_t(std::max(_DSizeI, std::max(_DSizeJ, _DSizeK))));
 
   // Determine how many field in Repository;
   _clock = _currentTimestamp();
@@ -106,10 +166,49 @@ Cart2Grid::Cart2Grid(std::shared_ptr<Repository> store, const Params& params, in
       ap);
   }
 
-  // Initialize Feild
+  // Fields are expanded into outFields by the staged path; the fused
+  // kernel reads the input fields directly
+  if (_params.fuse_gate_stages) {
+    for (auto it = _store->inFields.cbegin(); it != _store->inFields.cend();
+         ++it) {
+      _fieldNames.push_back((*it).first);
+    }
+  } else {
+    for (auto it = _store->outFields.cbegin(); it != _store->outFields.cend();
+         ++it) {
+      _fieldNames.push_back((*it).first);
+    }
+  }
+
+  // transform_fields, matched on the names read, as the fields are
+  // gridded under those names
+  if (_params.transform_fields_for_interpolation) {
+    for (int ii = 0; ii < _params.transform_fields_n; ii++) {
+      const Params::transform_field_t& tf = _params._transform_fields[ii];
+      FieldTransform& ft = _transforms[tf.input_name];
+      ft.toLinear = tf.transform == Params::TRANSFORM_DB_TO_LINEAR ||
+                    tf.transform == Params::TRANSFORM_DB_TO_LINEAR_AND_BACK;
+      ft.toDb = !ft.toLinear;
+      ft.back = tf.transform == Params::TRANSFORM_DB_TO_LINEAR_AND_BACK ||
+                tf.transform == Params::TRANSFORM_LINEAR_TO_DB_AND_BACK;
+    }
+  }
   for (auto it = _store->outFields.cbegin(); it != _store->outFields.cend();
        ++it) {
-    string name = (*it).first;
+    _outTransforms.push_back(_transformOf((*it).first));
+  }
+
+  // Initialize Feild
+  for (const string& name : _fieldNames) {
+    if (_sparse) {
+      _sparseSum[name] =
+        std::make_shared<BrickGrid<double>>(_DSizeI, _DSizeJ, _DSizeK);
+      _sparseWeight[name] =
+        std::make_shared<BrickGrid<double>>(_DSizeI, _DSizeJ, _DSizeK);
+      _sparseCount[name] =
+        std::make_shared<BrickGrid<int>>(_DSizeI, _DSizeJ, _DSizeK);
+      continue;
+    }
     auto fieldsum = std::make_shared<vector3d<double>>();
     auto fieldweight = std::make_shared<vector3d<double>>();
     auto fieldcount = std::make_shared<vector3d<int>>();
@@ -127,12 +226,235 @@ Cart2Grid::Cart2Grid(std::shared_ptr<Repository> store, const Params& params, in
   }
 }
 
+// No transform, for fields not in transform_fields.
+
+const FieldTransform&
+Cart2Grid::_transformOf(const string& name) const
+{
+  static const FieldTransform none;
+  auto it = _transforms.find(name);
+  return it == _transforms.end() ? none : it->second;
+}
+
+// Fields scattered for a gate: REF fields with data, each value through
+// its transform, transforms[f] for the f'th of outFields. Returns the
+// number found.
+
+inline size_t
+_validFields(const Repository& store, size_t m,
+             const vector<FieldTransform>& transforms, vector<string>& names,
+             vector<double>& vals)
+{
+  names.clear();
+  vals.clear();
+  size_t f = 0;
+  for (auto it = store.outFields.cbegin(); it != store.outFields.cend();
+       ++it, ++f) {
+    const string& name = (*it).first;
+    double v = (*it).second->at(m);
+    if (name.find("REF") == 0 && v >= 0.0 && transforms[f].in(v)) {
+      names.push_back(name);
+      vals.push_back(v);
+    }
+    // TODO, for more types
+  }
+  return names.size();
+}
+
 void
 Cart2Grid::interpGrid(int nthreads)
 {
   // Convert everything to 0;
   _clock = _currentTimestamp();
 
+  const bool tracing = TraceEvents::isEnabled();
+  std::atomic<long> nContended(0);
+
+  if (_params.fuse_gate_stages) {
+    _scatterFused(tracing, nContended);
+  } else if (_params.superob_gates) {
+    vector<size_t> farGates;
+    {
+      TraceSpan span("superob", "compute");
+      _buildSuperObs(farGates);
+    }
+    if (_params.debug) {
+      std::cerr << "  " << _superObs.X.size() << " superobs and "
+                << farGates.size() << " single gates, from "
+                << _store->nPoints << " gates" << std::endl;
+    }
+    const size_t nSuper = _superObs.X.size();
+    tbb::parallel_for(
+      tbb::blocked_range<size_t>(0, nSuper + farGates.size()),
+      [&](const tbb::blocked_range<size_t>& r) {
+        TraceSpan span("scatter", "worker");
+        vector<string> names;
+        vector<double> vals, mult;
+        for (size_t n = r.begin(); n != r.end(); ++n) {
+          if (n < nSuper) {
+            const SuperObs& so = _superObs;
+            names.clear();
+            vals.clear();
+            mult.clear();
+            for (auto const& kv : so.values) {
+              if (so.counts.at(kv.first)[n] > 0) {
+                names.push_back(kv.first);
+                vals.push_back(kv.second[n]);
+                mult.push_back(so.counts.at(kv.first)[n]);
+              }
+            }
+            _scatterPoint(so.X[n], so.Y[n], so.Z[n], so.RoI[n], so.E[n],
+                          so.G[n], so.S[n], names, vals, mult, tracing,
+                          nContended);
+          } else {
+            const size_t m = farGates[n - nSuper];
+            _validFields(*_store, m, _outTransforms, names, vals);
+            mult.assign(names.size(), 1.0);
+            _scatterPoint(_store->gateX[m], _store->gateY[m],
+                          _store->gateZ[m], _store->gateRoI[m],
+                          _store->outElevation[m], _store->outGate[m],
+                          _store->gateGroundDistance[m], names, vals, mult,
+                          tracing, nContended);
+          }
+        }
+      });
+  } else {
+    // optionally visit the gates in space-filling-curve order
+    vector<size_t> order;
+    const bool sorted = _params.gate_order != Params::GATE_ORDER_FILE;
+    if (sorted) {
+      TraceSpan span("sortGates", "compute");
+      _sortGates(order);
+    }
+    tbb::parallel_for(
+      tbb::blocked_range<size_t>(0, sorted ? order.size() : _store->nPoints),
+      [&](const tbb::blocked_range<size_t>& r) {
+        TraceSpan span("scatter", "worker");
+        vector<string> names;
+        vector<double> vals, mult;
+        for (size_t n = r.begin(); n != r.end(); ++n) {
+          const size_t m = sorted ? order[n] : n;
+
+          // Check if there is any valid data on this point
+          // This is greatly useful when we do reflectivity or KDP only
+
+          if (_validFields(*_store, m, _outTransforms, names, vals) == 0)
+            continue;
+          mult.assign(names.size(), 1.0);
+          _scatterPoint(_store->gateX[m], _store->gateY[m], _store->gateZ[m],
+                        _store->gateRoI[m], _store->outElevation[m],
+                        _store->outGate[m], _store->gateGroundDistance[m],
+                        names, vals, mult, tracing, nContended);
+        } // Loop m
+      });   // Parfor r
+  }
+  if (tracing) {
+    TraceEvents::counter("spin_mutex contended", TraceEvents::nowUs(),
+                         double(nContended.load()));
+  }
+  if (_params.debug) {
+    _timeit("Computation");
+    for (auto const& kv : _sparseCount) {
+      std::cerr << "  " << kv.first << ": " << kv.second->getNAllocated()
+                << " of " << kv.second->getNBricks() << " bricks touched"
+                << std::endl;
+    }
+  }
+  _clock = _currentTimestamp();
+  {
+    TraceSpan span("computeGrid", "compute");
+    computeGrid(nthreads);
+  }
+  if (_params.debug) {
+    _timeit("Masking");
+  }
+}
+
+// Fused expand, XYZ and scatter: one task per block of rays, each gate
+// expanded, located and scattered in one go, straight from the input
+// fields. Nothing is stored per gate. The results match the staged path
+// - populateOutputValues, calculateXYZ, then the per-gate scatter - which
+// is kept for debugging. Gates are visited in file order.
+
+void
+Cart2Grid::_scatterFused(bool tracing, std::atomic<long>& nContended)
+{
+  const Repository& store = *_store;
+
+  // REF fields only, as _validFields
+  vector<string> refNames;
+  vector<const RepositoryField*> refFields;
+  vector<FieldTransform> refTransforms;
+  for (auto it = store.inFields.cbegin(); it != store.inFields.cend(); ++it) {
+    if ((*it).first.find("REF") == 0) {
+      refNames.push_back((*it).first);
+      refFields.push_back((*it).second.get());
+      refTransforms.push_back(_transformOf((*it).first));
+    }
+  }
+
+  tbb::parallel_for(
+    tbb::blocked_range<size_t>(0, store.timeDim),
+    [&](const tbb::blocked_range<size_t>& r) {
+      TraceSpan span("scatterFused", "worker");
+      vector<string> names;
+      vector<double> vals, mult;
+      for (size_t ray = r.begin(); ray != r.end(); ++ray) {
+        // range in float, as populateOutputValues
+        const float r0 = store.rayStartRange[ray];
+        const float g = store.gateSize[ray];
+        const size_t start = size_t(store.rayStartIndex[ray]);
+        const size_t end = start + size_t(store.rayNGates[ray]);
+        const double E = store.elevation[ray];
+        const double radianElev = E * M_PI / 180.0;
+        const double gateAngleRad = (90.0 - store.azimuth[ray]) * M_PI / 180.0;
+        const double sinElev = sin(radianElev);
+        const double cosElev = cos(radianElev);
+        const double cosAngle = cos(gateAngleRad);
+        const double sinAngle = sin(gateAngleRad);
+
+        for (size_t m = start; m < end; m++) {
+          names.clear();
+          vals.clear();
+          for (size_t f = 0; f < refFields.size(); f++) {
+            const RepositoryField& fin = *refFields[f];
+            if (fin.fieldValues[m] == fin.fillValue) {
+              continue;
+            }
+            double v = fin.fieldValues[m] * fin.scaleFactor + fin.addOffset;
+            if (v >= 0.0 && refTransforms[f].in(v)) {
+              names.push_back(refNames[f]);
+              vals.push_back(v);
+            }
+          }
+          if (names.empty()) {
+            continue;
+          }
+          mult.assign(names.size(), 1.0);
+
+          const double G = (m - start) * g + r0;
+          GateGeometry geom = Polar2Cartesian::gateGeometry(
+            G, sinElev, cosElev, cosAngle, sinAngle, store.altitudeAgl, _roi);
+          _scatterPoint(geom.x, geom.y, geom.z, geom.roi, E, G,
+                        geom.groundDistance, names, vals, mult, tracing,
+                        nContended);
+        }
+      }
+    });
+}
+
+// Scatter one observation at (X, Y, Z) into the cells within its radius
+// of influence. vals[f] is its value of field names[f], and mult[f] the
+// number of gates behind that value - 1 except for superobs, which count
+// as that many gates at their mean position.
+
+void
+Cart2Grid::_scatterPoint(double X, double Y, double Z, double RoI, double E,
+                         double G, double S, const vector<string>& names,
+                         const vector<double>& vals,
+                         const vector<double>& mult, bool tracing,
+                         std::atomic<long>& nContended)
+{
   const double DMinX = _xy_geom.minx * 1000.0;
   const double DMinY = _xy_geom.miny * 1000.0;
   const double DMinZ = _z_geom.minz * 1000.0;
@@ -141,155 +463,563 @@ Cart2Grid::interpGrid(int nthreads)
   const double CellZ = _z_geom.dz * 1000.0;
   const double GateSize = _store->gateSize[0];
 
-  tbb::parallel_for(size_t(0), _store->nPoints, [&](size_t m) {
+  // Put it at grid
+  int ci = int((X - DMinX) / CellX);
+  int cj = int((Y - DMinY) / CellY);
+  int ck = int((Z - DMinZ) / CellZ);
 
-    // Check if there is any valid data on this point
-    // This is greatly useful when we do reflectivity or KDP only
+  // Search range
+  int si = int(RoI / CellX);
+  int sj = int(RoI / CellY);
+  int sk = int(RoI / CellZ);
 
-    std::vector<string> validname;
+  // Maybe we don't need limits, because loops filter them.
+  int starti = std::max(0, ci - si);
+  int endi = std::min(_DSizeI - 1, ci + si);
 
-    for (auto it = _store->outFields.cbegin(); it != _store->outFields.cend();
-         ++it) {
-      string name = (*it).first;
-      if (name.find("REF") == 0 && (*it).second->at(m) >= 0.0) {
-        validname.push_back(name);
-      }
-      // TODO, for more types
-    }
+  int startj = std::max(0, cj - sj);
+  int endj = std::min(_DSizeJ - 1, cj + sj);
 
-    if (validname.size() == 0)
-      return;
+  int startk = std::max(0, ck - sk);
+  int endk = std::min(_DSizeK - 1, ck + sk);
 
-    double X = _store->gateX[m];
-    double Y = _store->gateY[m];
-    double Z = _store->gateZ[m];
-    double RoI = _store->gateRoI[m];
-    double E = _store->outElevation[m];
-    double G = _store->outGate[m];
-    double S = _store->gateGroundDistance[m];
-
-    // Put it at grid
-    int ci = int((X - DMinX) / CellX);
-    int cj = int((Y - DMinY) / CellY);
-    int ck = int((Z - DMinZ) / CellZ);
-
-    // Search range
-    int si = int(RoI / CellX);
-    int sj = int(RoI / CellY);
-    int sk = int(RoI / CellZ);
-
-    // Maybe we don't need limits, because loops filter them.
-    int starti = std::max(0, ci - si);
-    int endi = std::min(_DSizeI - 1, ci + si);
-
-    int startj = std::max(0, cj - sj);
-    int endj = std::min(_DSizeJ - 1, cj + sj);
-
-    int startk = std::max(0, ck - sk);
-    int endk = std::min(_DSizeK - 1, ck + sk);
-
-    // Grab gates
-    for (int i = starti; i <= endi; ++i) {
-      for (int j = startj; j <= endj; ++j) {
+  // Grab gates
+  for (int i = starti; i <= endi; ++i) {
+    for (int j = startj; j <= endj; ++j) {
 #ifdef __GNUC__
 #pragma GCC ivdep
 #else
 #pragma ivdep
 #endif
-        for (int k = startk; k <= endk; ++k) {
+      for (int k = startk; k <= endk; ++k) {
 
-          double s, el, rg, posx, posy;
+        double s, el, rg, posx, posy;
 
-          s = _grid_ground->at(i).at(j).at(k);
-          el = _grid_el->at(i).at(j).at(k);
-          rg = _grid_gate->at(i).at(j).at(k);
-          posx = _grid_x->at(i).at(j).at(k);
-          posy = _grid_y->at(i).at(j).at(k);
+        s = _grid_ground->at(i).at(j).at(k);
+        el = _grid_el->at(i).at(j).at(k);
+        rg = _grid_gate->at(i).at(j).at(k);
+        posx = _grid_x->at(i).at(j).at(k);
+        posy = _grid_y->at(i).at(j).at(k);
 
-          if (std::abs(rg - G) > 2.0 * GateSize) {
-            continue;
-          }
+        if (std::abs(rg - G) > 2.0 * GateSize) {
+          continue;
+        }
 
-          double max_e_diff = (E < 6.0) ? 1.0 : 3.0;
-          if (std::abs(el - E) > max_e_diff) {
-            continue;
-          }
+        double max_e_diff = (E < 6.0) ? 1.0 : 3.0;
+        if (std::abs(el - E) > max_e_diff) {
+          continue;
+        }
 
-          double dot = std::min(1.0, (posx * X + posy * Y) / S / s);
-          double adot = std::acos(dot);
-          if (adot > 1.0) {
-            continue;
-          }
-          double term1 = std::cos(std::abs(el - E));
-          double term2 = dot;
-          double e_u = std::acos(term1 * term2) * 180.0 / M_PI;
+        double dot = std::min(1.0, (posx * X + posy * Y) / S / s);
+        double adot = std::acos(dot);
+        if (adot > 1.0) {
+          continue;
+        }
+        double term1 = std::cos(std::abs(el - E));
+        double term2 = dot;
+        double e_u = std::acos(term1 * term2) * 180.0 / M_PI;
 
-          double alpha = e_u;
-          double gate_diff = abs(rg - G) / (2 * GateSize) + 1e-8;
+        double alpha = e_u;
+        double gate_diff = abs(rg - G) / (2 * GateSize) + 1e-8;
 
-          double w =
-            std::pow(0.005, std::pow(alpha, 3.0)) / std::pow(gate_diff, 2.0) +
-            1e-8;
+        double w =
+          std::pow(0.005, std::pow(alpha, 3.0)) / std::pow(gate_diff, 2.0) +
+          1e-8;
 
-          for (auto& name : validname) {
+        for (size_t f = 0; f < names.size(); f++) {
+          double vw = vals[f] * w + 1e-8;
+          _accumulate(names[f], i, j, k, mult[f] * vw, mult[f] * w,
+                      int(mult[f]), tracing, nContended);
+        }
+      } // Loop k
+    }   // Loop j
+  }     // Loop i
+}
 
-            double v = _store->outFields[name]->at(m);
-            double vw = v * w + 1e-8;
+// Key of the grid cell holding a gate's centre, clamped to the grid:
+// its Morton or Hilbert index as set by gate_order, else the linear
+// index, i-major. inside is false if the centre is outside the grid.
+// Keys have at most 54 bits.
 
-            {
-              tbb::spin_mutex::scoped_lock lock(_add_locker1);
-              (_outputGridSum[name]->at(i).at(j).at(k)) += vw;
-            }
-            {
-              tbb::spin_mutex::scoped_lock lock(_add_locker2);
-              (_outputGridWeight[name]->at(i).at(j).at(k)) += w;
-            }
-            {
-              tbb::spin_mutex::scoped_lock lock(_add_locker3);
-              (_outputGridCount[name]->at(i).at(j).at(k))++;
-            }
-          }
-        } // Loop k
-      }   // Loop j
-    }     // Loop i
-  });     // Parfor m
-  if (_params.debug) {
-    _timeit("Computation");
+uint64_t
+Cart2Grid::_gateCellKey(size_t m, bool& inside) const
+{
+  const double fi = (_store->gateX[m] - _xy_geom.minx * 1000.0) /
+                    (_xy_geom.dx * 1000.0);
+  const double fj = (_store->gateY[m] - _xy_geom.miny * 1000.0) /
+                    (_xy_geom.dy * 1000.0);
+  const double fk =
+    (_store->gateZ[m] - _z_geom.minz * 1000.0) / (_z_geom.dz * 1000.0);
+  inside = fi >= 0 && fj >= 0 && fk >= 0 && fi < _DSizeI && fj < _DSizeJ &&
+           fk < _DSizeK;
+  const uint32_t ci = uint32_t(std::min(std::max(fi, 0.0), _DSizeI - 1.0));
+  const uint32_t cj = uint32_t(std::min(std::max(fj, 0.0), _DSizeJ - 1.0));
+  const uint32_t ck = uint32_t(std::min(std::max(fk, 0.0), _DSizeK - 1.0));
+
+  // past 18 bits a coordinate, the curve keys would not fit
+  if (_curveBits <= 18) {
+    if (_params.gate_order == Params::GATE_ORDER_MORTON) {
+      return SpaceFillingCurve::morton(ci, cj, ck);
+    } else if (_params.gate_order == Params::GATE_ORDER_HILBERT) {
+      return SpaceFillingCurve::hilbert(ci, cj, ck, _curveBits);
+    }
   }
-  _clock = _currentTimestamp();
-  computeGrid(nthreads);
-  if (_params.debug) {
-    _timeit("Masking");
+  return (uint64_t(ci) * _DSizeJ + cj) * _DSizeK + ck;
+}
+
+// Gates with data, sorted in parallel by the key of their cell, so
+// consecutive scatter tasks update neighbouring parts of the grid.
+
+void
+Cart2Grid::_sortGates(vector<size_t>& order)
+{
+  const uint64_t noDataKey = std::numeric_limits<uint64_t>::max();
+  vector<std::pair<uint64_t, size_t>> keys(_store->nPoints);
+  tbb::parallel_for(
+    tbb::blocked_range<size_t>(0, _store->nPoints),
+    [&](const tbb::blocked_range<size_t>& r) {
+      vector<string> names;
+      vector<double> vals;
+      bool inside;
+      for (size_t m = r.begin(); m != r.end(); ++m) {
+        keys[m].second = m;
+        keys[m].first =
+          _validFields(*_store, m, _outTransforms, names, vals) == 0
+            ? noDataKey
+            : _gateCellKey(m, inside);
+      }
+    });
+  tbb::parallel_sort(keys.begin(), keys.end());
+
+  order.clear();
+  order.reserve(keys.size());
+  for (size_t n = 0; n < keys.size() && keys[n].first != noDataKey; n++) {
+    order.push_back(keys[n].second);
+  }
+}
+
+// Aggregate the gates within superob_max_range_km into superobs: gates
+// whose centres fall in the same grid cell, at the same elevation to
+// within 0.25 deg - so the same sweep - are replaced by one observation
+// at their mean position, with the mean value and the gate count of each
+// field. Gates are keyed and sorted in parallel, and each run of equal
+// keys reduced in parallel. Gates beyond the range, or centred outside
+// the grid, are returned in farGates to be scattered one by one.
+
+void
+Cart2Grid::_buildSuperObs(vector<size_t>& farGates)
+{
+  const double maxRange = _params.superob_max_range_km * 1000.0;
+  const uint64_t nElevBins = 512;
+  const uint64_t farBit = uint64_t(1) << 63;
+  const uint64_t noDataKey = std::numeric_limits<uint64_t>::max();
+  const Repository& store = *_store;
+
+  // key each gate: cell key and elevation bin. Far gates keep their cell
+  // key, so with gate_order set they are scattered in curve order too.
+  vector<std::pair<uint64_t, size_t>> keys(store.nPoints);
+  tbb::parallel_for(
+    tbb::blocked_range<size_t>(0, store.nPoints),
+    [&](const tbb::blocked_range<size_t>& r) {
+      vector<string> names;
+      vector<double> vals;
+      for (size_t m = r.begin(); m != r.end(); ++m) {
+        keys[m] = { noDataKey, m };
+        if (_validFields(store, m, _outTransforms, names, vals) == 0) {
+          continue;
+        }
+        bool inside;
+        const uint64_t cell = _gateCellKey(m, inside);
+        if (!inside || store.outGate[m] > maxRange) {
+          keys[m].first = farBit | cell;
+          continue;
+        }
+        int64_t eb = std::lround(store.outElevation[m] * 4.0) + 64;
+        eb = std::min(std::max(eb, int64_t(0)), int64_t(nElevBins - 1));
+        keys[m].first = cell * nElevBins + uint64_t(eb);
+      }
+    });
+  tbb::parallel_sort(keys.begin(), keys.end());
+
+  // runs of equal keys; far gates, then gates with no data, sort last
+  vector<size_t> starts;
+  size_t nKeyed = 0;
+  for (size_t n = 0; n < keys.size() && keys[n].first < farBit; n++) {
+    if (n == 0 || keys[n].first != keys[n - 1].first) {
+      starts.push_back(n);
+    }
+    nKeyed = n + 1;
   }
+  farGates.clear();
+  for (size_t n = nKeyed; n < keys.size() && keys[n].first != noDataKey;
+       n++) {
+    farGates.push_back(keys[n].second);
+  }
+  starts.push_back(nKeyed);
+
+  const size_t nSuper = starts.size() - 1;
+  SuperObs& so = _superObs;
+  for (vector<double>* v : { &so.X, &so.Y, &so.Z, &so.RoI, &so.E, &so.G,
+                             &so.S }) {
+    v->assign(nSuper, 0.0);
+  }
+  so.values.clear();
+  so.counts.clear();
+  for (auto it = store.outFields.cbegin(); it != store.outFields.cend();
+       ++it) {
+    if ((*it).first.find("REF") == 0) {
+      so.values[(*it).first].assign(nSuper, 0.0);
+      so.counts[(*it).first].assign(nSuper, 0);
+    }
+  }
+
+  tbb::parallel_for(size_t(0), nSuper, [&](size_t n) {
+    const double count = double(starts[n + 1] - starts[n]);
+    double X = 0, Y = 0, Z = 0, RoI = 0, E = 0, G = 0, S = 0;
+    for (size_t q = starts[n]; q < starts[n + 1]; q++) {
+      const size_t m = keys[q].second;
+      X += store.gateX[m];
+      Y += store.gateY[m];
+      Z += store.gateZ[m];
+      RoI += store.gateRoI[m];
+      E += store.outElevation[m];
+      G += store.outGate[m];
+      S += store.gateGroundDistance[m];
+    }
+    so.X[n] = X / count;
+    so.Y[n] = Y / count;
+    so.Z[n] = Z / count;
+    so.RoI[n] = RoI / count;
+    so.E[n] = E / count;
+    so.G[n] = G / count;
+    so.S[n] = S / count;
+    for (auto& kv : so.values) {
+      const vector<double>& field = *store.outFields.at(kv.first);
+      const FieldTransform& tr = _transformOf(kv.first);
+      double sum = 0.0;
+      int nValid = 0;
+      for (size_t q = starts[n]; q < starts[n + 1]; q++) {
+        double v = field[keys[q].second];
+        if (v >= 0.0 && tr.in(v)) {
+          sum += v;
+          nValid++;
+        }
+      }
+      kv.second[n] = nValid > 0 ? sum / nValid : 0.0;
+      so.counts.at(kv.first)[n] = nValid;
+    }
+  });
 }
 
+// Normalize the accumulated sums, transforming back fields with an
+// _AND_BACK transform. If output_packing is set, the range of each field
+// is tracked in the same pass and the field is then quantized with
+// _packField(). The derived 2D products are computed from each
+// reflectivity column as soon as it is normalized, while it is in cache.
+
 void
 Cart2Grid::computeGrid(int nthreads)
 {
-  
-  for (auto m = _store->outFields.cbegin(); m != _store->outFields.cend();
-       ++m) {
-    string name = (*m).first;
+  const bool pack = _params.output_packing != Params::PACKING_FLOAT32;
+  _initDerivedProducts();
+  for (const string& name : _fieldNames) {
     auto field = std::make_shared<vector3d<double>>();
-    resizeArray(field, _DSizeI, _DSizeJ, _DSizeK);
-    tbb::parallel_for(0, _DSizeI, [=](int i) {
-      for (int j = 0; j < _DSizeJ; j++) {
-        for (int k = 0; k < _DSizeK; k++) {
-          if (_outputGridCount[name]->at(i).at(j).at(k) < 3 ||
-              _outputGridWeight[name]->at(i).at(j).at(k) == 0) {
-            field->at(i).at(j).at(k) = INVALID_DATA;
-          } else {
-            field->at(i).at(j).at(k) =
-              _outputGridSum[name]->at(i).at(j).at(k) /
-              _outputGridWeight[name]->at(i).at(j).at(k);
+    vector<double> minVals, maxVals;
+    const bool derive =
+      !_derivedProducts.empty() && name == _params.derived_dbz_field_name;
+    const FieldTransform& tr = _transformOf(name);
+    if (_sparse) {
+      resizeArray(field, _DSizeI, _DSizeJ, _DSizeK, INVALID_DATA);
+      _normalizeBricks(name, *field, minVals, maxVals);
+      if (derive) {
+        // columns with no bricks are all missing
+        const BrickGrid<int>& count = *_sparseCount[name];
+        tbb::parallel_for(0, _DSizeI, [&](int i) {
+          for (int j = 0; j < _DSizeJ; j++) {
+            if (!count.isEmpty(i, i, j, j, 0, _DSizeK - 1)) {
+              _deriveColumn((*field)[i][j].data(), size_t(j) * _DSizeI + i);
+            }
+          }
+        });
+      }
+    } else {
+      resizeArray(field, _DSizeI, _DSizeJ, _DSizeK);
+      const vector3d<double>& sum = *_outputGridSum[name];
+      const vector3d<double>& weight = *_outputGridWeight[name];
+      const vector3d<int>& count = *_outputGridCount[name];
+      minVals.assign(_DSizeI, INVALID_DATA);
+      maxVals.assign(_DSizeI, INVALID_DATA);
+      tbb::parallel_for(0, _DSizeI, [&](int i) {
+        double minVal = std::numeric_limits<double>::max();
+        double maxVal = -std::numeric_limits<double>::max();
+        for (int j = 0; j < _DSizeJ; j++) {
+          const double* s = sum[i][j].data();
+          const double* w = weight[i][j].data();
+          const int* c = count[i][j].data();
+          double* out = (*field)[i][j].data();
+#ifdef __GNUC__
+#pragma GCC ivdep
+#else
+#pragma ivdep
+#endif
+          for (int k = 0; k < _DSizeK; k++) {
+            const double val =
+              c[k] >= 3 && w[k] != 0 ? tr.out(s[k] / w[k]) : INVALID_DATA;
+            const bool valid = val != INVALID_DATA;
+            out[k] = val;
+            minVal = valid ? std::min(minVal, val) : minVal;
+            maxVal = valid ? std::max(maxVal, val) : maxVal;
+          } // Loop k
+          if (derive) {
+            _deriveColumn(out, size_t(j) * _DSizeI + i);
           }
-        } // Loop k
-      }   // Loop j
-    });   // Parfor i
+        } // Loop j
+        if (minVal <= maxVal) {
+          minVals[i] = minVal;
+          maxVals[i] = maxVal;
+        }
+      }); // Parfor i
+    }
     _outputFinalGrid.insert(std::make_pair(name, field));
+
+    if (pack) {
+      double minVal = INVALID_DATA, maxVal = INVALID_DATA;
+      for (size_t i = 0; i < minVals.size(); i++) {
+        if (minVals[i] == INVALID_DATA) {
+          continue;
+        }
+        if (minVal == INVALID_DATA || minVals[i] < minVal) {
+          minVal = minVals[i];
+        }
+        if (maxVal == INVALID_DATA || maxVals[i] > maxVal) {
+          maxVal = maxVals[i];
+        }
+      }
+      PackedField& packed = _packedGrid[name];
+      if (_params.output_packing == Params::PACKING_INT8) {
+        _packField<int8_t>(*field, minVal, maxVal, packed);
+      } else {
+        _packField<int16_t>(*field, minVal, maxVal, packed);
+      }
+    }
   } // Loop m
 }
 
+// Normalize the touched bricks of a sparse field into the final grid,
+// which is already filled with INVALID_DATA. minVals and maxVals get the
+// range of each brick, INVALID_DATA for bricks with no valid cells.
+
+void
+Cart2Grid::_normalizeBricks(const string& name, vector3d<double>& field,
+                            vector<double>& minVals, vector<double>& maxVals)
+{
+  const BrickGrid<double>& sum = *_sparseSum[name];
+  const BrickGrid<double>& weight = *_sparseWeight[name];
+  const BrickGrid<int>& count = *_sparseCount[name];
+  const FieldTransform& tr = _transformOf(name);
+  const int B = BrickGrid<int>::BRICK_SIZE;
+  const int nby = count.getNBricksY();
+  const int nbz = count.getNBricksZ();
+  minVals.assign(count.getNBricks(), INVALID_DATA);
+  maxVals.assign(count.getNBricks(), INVALID_DATA);
+
+  tbb::parallel_for(size_t(0), count.getNBricks(), [&](size_t ib) {
+    const int* c = count.getBrick(ib);
+    if (c == nullptr) {
+      return;
+    }
+    // all three are touched together
+    const double* s = sum.getBrick(ib);
+    const double* w = weight.getBrick(ib);
+    const int i0 = int(ib / (size_t(nby) * nbz)) * B;
+    const int j0 = int(ib / nbz % nby) * B;
+    const int k0 = int(ib % nbz) * B;
+    const int ni = std::min(B, _DSizeI - i0);
+    const int nj = std::min(B, _DSizeJ - j0);
+    const int nk = std::min(B, _DSizeK - k0);
+    double minVal = std::numeric_limits<double>::max();
+    double maxVal = -std::numeric_limits<double>::max();
+    for (int ii = 0; ii < ni; ii++) {
+      for (int jj = 0; jj < nj; jj++) {
+        const int cell = (ii * B + jj) * B;
+        double* out = field[i0 + ii][j0 + jj].data() + k0;
+        for (int kk = 0; kk < nk; kk++) {
+          const double val = c[cell + kk] >= 3 && w[cell + kk] != 0
+                               ? tr.out(s[cell + kk] / w[cell + kk])
+                               : INVALID_DATA;
+          const bool valid = val != INVALID_DATA;
+          out[kk] = val;
+          minVal = valid ? std::min(minVal, val) : minVal;
+          maxVal = valid ? std::max(maxVal, val) : maxVal;
+        }
+      }
+    }
+    if (minVal <= maxVal) {
+      minVals[ib] = minVal;
+      maxVals[ib] = maxVal;
+    }
+  });
+}
+
+bool
+Cart2Grid::isEmptyRegion(const string& field, int i0, int i1, int j0, int j1,
+                         int k0, int k1) const
+{
+  auto it = _sparseCount.find(field);
+  if (it == _sparseCount.end()) {
+    return false;
+  }
+  return it->second->isEmpty(i0, i1, j0, j1, k0, k1);
+}
+
+// Set up the selected products, all missing. A missing reflectivity
+// field is warned about once per run, not per volume.
+
+void
+Cart2Grid::_initDerivedProducts()
+{
+  static std::atomic<bool> warned(false);
+  _derivedProducts.clear();
+  if (std::find(_fieldNames.begin(), _fieldNames.end(),
+                _params.derived_dbz_field_name) == _fieldNames.end()) {
+    if ((_params.compute_column_max_dbz || _params.compute_echo_top ||
+         _params.compute_vil) &&
+        !warned.exchange(true)) {
+      std::cerr << "WARNING - Cart2Grid::computeGrid" << std::endl;
+      std::cerr << "  No field " << _params.derived_dbz_field_name
+                << " for the derived products" << std::endl;
+    }
+    return;
+  }
+  const size_t nPoints = size_t(_DSizeI) * _DSizeJ;
+  if (_params.compute_column_max_dbz) {
+    _derivedProducts["COLMAX"] = { "column_maximum_reflectivity", "dBZ",
+                                   vector<float>(nPoints, INVALID_DATA_F) };
+  }
+  if (_params.compute_echo_top) {
+    _derivedProducts["ECHO_TOP"] = { "echo_top_height", "km",
+                                     vector<float>(nPoints, INVALID_DATA_F) };
+  }
+  if (_params.compute_vil) {
+    _derivedProducts["VIL"] = { "vertically_integrated_liquid", "kg m-2",
+                                vector<float>(nPoints, INVALID_DATA_F) };
+  }
+}
+
+// Derive the products for one normalized reflectivity column. Each column
+// is written by one task only, so no locking is needed.
+
+void
+Cart2Grid::_deriveColumn(const double* dbz, size_t index)
+{
+  const double minz = _z_geom.minz;
+  const double dz = _z_geom.dz;
+  const double threshold = _params.echo_top_threshold_dbz;
+  const double maxVilDbz = _params.vil_max_dbz;
+
+  double colMax = INVALID_DATA;
+  int kTop = -1;
+  double vil = 0.0;
+  double zPrev = 0.0, hPrev = 0.0;
+  bool prevValid = false, anyValid = false;
+  for (int k = 0; k < _DSizeK; k++) {
+    if (dbz[k] == INVALID_DATA) {
+      prevValid = false;
+      continue;
+    }
+    anyValid = true;
+    colMax = std::max(colMax, dbz[k]);
+    if (dbz[k] >= threshold) {
+      kTop = k;
+    }
+    // VIL, trapezoidal between adjacent valid levels, dz in m
+    const double h = (minz + k * dz) * 1000.0;
+    const double z = std::pow(10.0, std::min(dbz[k], maxVilDbz) / 10.0);
+    if (prevValid) {
+      vil += 3.44e-6 * std::pow(0.5 * (z + zPrev), 4.0 / 7.0) * (h - hPrev);
+    }
+    zPrev = z;
+    hPrev = h;
+    prevValid = true;
+  }
+  if (!anyValid) {
+    return;
+  }
+
+  auto colmaxIt = _derivedProducts.find("COLMAX");
+  if (colmaxIt != _derivedProducts.end()) {
+    colmaxIt->second.data[index] = float(colMax);
+  }
+  auto topIt = _derivedProducts.find("ECHO_TOP");
+  if (topIt != _derivedProducts.end() && kTop >= 0) {
+    double top = minz + kTop * dz;
+    const int kAbove = kTop + 1;
+    if (kAbove < _DSizeK && dbz[kAbove] != INVALID_DATA &&
+        dbz[kTop] > dbz[kAbove]) {
+      top += dz * (dbz[kTop] - threshold) / (dbz[kTop] - dbz[kAbove]);
+    }
+    topIt->second.data[index] = float(top);
+  }
+  auto vilIt = _derivedProducts.find("VIL");
+  if (vilIt != _derivedProducts.end()) {
+    vilIt->second.data[index] = float(vil);
+  }
+}
+
+// Quantize a normalized field to T. The valid range maps onto
+// [-max, max] of T, and the lowest value of T is the fill value. The
+// output is written (z, y, x), so each i column scatters with stride
+// nx * ny; the reads along k are contiguous.
+
+template<typename T>
+void
+Cart2Grid::_packField(const vector3d<double>& field, double minVal,
+                      double maxVal, PackedField& packed)
+{
+  const double qmax = std::numeric_limits<T>::max();
+  const T fill = std::numeric_limits<T>::min();
+  packed.nBytes = sizeof(T);
+  packed.fillValue = fill;
+  // rounded to float, as stored in the file attributes
+  packed.addOffset =
+    float(minVal == INVALID_DATA ? 0.0 : 0.5 * (minVal + maxVal));
+  packed.scaleFactor =
+    float(maxVal > minVal ? (maxVal - minVal) / (2.0 * qmax) : 1.0);
+  packed.data.resize(size_t(_DSizeI) * _DSizeJ * _DSizeK * sizeof(T));
+
+  T* out = reinterpret_cast<T*>(packed.data.data());
+  const double offset = packed.addOffset;
+  const double invScale = 1.0 / packed.scaleFactor;
+  const size_t planeSize = size_t(_DSizeI) * _DSizeJ;
+  tbb::parallel_for(0, _DSizeI, [&](int i) {
+    for (int j = 0; j < _DSizeJ; j++) {
+      const double* in = field[i][j].data();
+      T* col = out + size_t(j) * _DSizeI + i;
+#ifdef __GNUC__
+#pragma GCC ivdep
+#else
+#pragma ivdep
+#endif
+      for (int k = 0; k < _DSizeK; k++) {
+        double q = std::floor((in[k] - offset) * invScale + 0.5);
+        q = std::min(std::max(q, -qmax), qmax);
+        col[k * planeSize] = in[k] == INVALID_DATA ? fill : T(q);
+      }
+    }
+  });
+}
+
+void
+Cart2Grid::clearGeometry()
+{
+  _grid_el.reset();
+  _grid_gate.reset();
+  _grid_ground.reset();
+  _grid_x.reset();
+  _grid_y.reset();
+  _grid_z.reset();
+}
+
 std::shared_ptr<Repository>
 Cart2Grid::getRepository()
 {
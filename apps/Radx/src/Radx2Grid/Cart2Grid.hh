@@ -1,7 +1,11 @@
 #ifndef RADX_RADX2GRID_CART2GRID_H_
 #define RADX_RADX2GRID_CART2GRID_H_
 
+#include "BrickGrid.hh"
+#include "FastTransform.hh"
 #include "PolarDataStream.hh"
+#include "RadiusOfInfluence.hh"
+#include <atomic>
 #include <chrono>
 #include <memory>
 #include <tbb/atomic.h>
@@ -24,9 +28,10 @@ inline void resizeArray(ptr_vector3d<T> &c, size_t x, size_t y, size_t z) {
   c->resize(x, vector<vector<T>>(y, vector<T>(z, 0)));
 }
 
-inline void resizeArray(ptr_vector3d<bool> &c, size_t x, size_t y, size_t z,
-                        bool value) {
-  c->resize(x, vector<vector<bool>>(y, vector<bool>(z, value)));
+template <typename T>
+inline void resizeArray(ptr_vector3d<T> &c, size_t x, size_t y, size_t z,
+                        T value) {
+  c->resize(x, vector<vector<T>>(y, vector<T>(z, value)));
 }
 
 // inline void atomicAdd(tbb::atomic<double> &x, double addend) {
@@ -37,6 +42,76 @@ inline void resizeArray(ptr_vector3d<bool> &c, size_t x, size_t y, size_t z,
 //  } while (x.compare_and_swap(n, o) != o);
 //}
 
+// A field quantized for packed output, value = packed * scaleFactor +
+// addOffset. Values are int16 or int8 as nBytes, stored (z, y, x) with
+// x varying fastest, ready to be written plane by plane.
+
+struct PackedField
+{
+  int nBytes = 2;
+  double scaleFactor = 1.0;
+  double addOffset = 0.0;
+  int fillValue = -32768;
+  std::vector<unsigned char> data;
+};
+
+// A 2D product derived from the columns of a field, (y, x) with x
+// varying fastest. Missing values are INVALID_DATA_F.
+
+struct DerivedProduct
+{
+  std::string longName;
+  std::string units;
+  std::vector<float> data;
+};
+
+// Gates aggregated per grid cell and sweep, see Cart2Grid::_buildSuperObs.
+// Per field, the mean value and the number of gates with data.
+
+struct SuperObs
+{
+  std::vector<double> X, Y, Z, RoI, E, G, S;
+  std::map<std::string, std::vector<double>> values;
+  std::map<std::string, std::vector<int>> counts;
+};
+
+// transform_fields for a field: gate values go from dB to linear, or
+// linear to dB, as they are scattered, and back as the cells are
+// normalized for the _AND_BACK transforms.
+
+struct FieldTransform
+{
+  bool toLinear = false;
+  bool toDb = false;
+  bool back = false;
+
+  // value as accumulated, false if there is none
+  inline bool in(double& v) const
+  {
+    if (toLinear) {
+      v = FastTransform::dbToLinear(v);
+    } else if (toDb) {
+      if (v <= 0.0) {
+        return false;
+      }
+      v = FastTransform::linearToDb(v);
+    }
+    return true;
+  }
+
+  // normalized value as output, INVALID_DATA if there is none
+  inline double out(double v) const
+  {
+    if (!back) {
+      return v;
+    }
+    if (toLinear) {
+      return v > 0.0 ? FastTransform::linearToDb(v) : INVALID_DATA;
+    }
+    return FastTransform::dbToLinear(v);
+  }
+};
+
 class Cart2Grid {
 public:
 
@@ -44,8 +119,23 @@ public:
   void interpGrid(int nthreads);
   void computeGrid(int nthreads);
 
+  // Drop the cached grid geometry, so the next constructor rebuilds it.
+  static void clearGeometry();
+
   std::shared_ptr<Repository> getRepository();
   map<string, ptr_vector3d<double>> getOutputFinalGrid();
+  // empty unless output_packing is INT16 or INT8
+  const map<string, PackedField>& getPackedGrid() const { return _packedGrid; }
+  // COLMAX, ECHO_TOP and VIL, as selected in the params
+  const map<string, DerivedProduct>& getDerivedProducts() const
+  {
+    return _derivedProducts;
+  }
+  // With sparse_grid_storage, true if no gate touched the cells
+  // [i0, i1] x [j0, j1] x [k0, k1] of the field, which are then all
+  // INVALID_DATA. Always false with dense storage.
+  bool isEmptyRegion(const string &field, int i0, int i1, int j0, int j1,
+                     int k0, int k1) const;
   int getGridDimX();
   int getGridDimY();
   int getGridDimZ();
@@ -61,11 +151,19 @@ private:
   map<string, ptr_vector3d<double>> _outputGridSum;
   map<string, ptr_vector3d<double>> _outputGridWeight;
   map<string, ptr_vector3d<int>> _outputGridCount;
+  // sparse_grid_storage: the same accumulators, in bricks allocated on touch
+  bool _sparse;
+  map<string, std::shared_ptr<BrickGrid<double>>> _sparseSum;
+  map<string, std::shared_ptr<BrickGrid<double>>> _sparseWeight;
+  map<string, std::shared_ptr<BrickGrid<int>>> _sparseCount;
   map<string, ptr_vector3d<double>> _outputFinalGrid;
+  map<string, PackedField> _packedGrid;
+  map<string, DerivedProduct> _derivedProducts;
 
   const Params _params;
   Params::grid_xy_geom_t _xy_geom;
   Params::grid_z_geom_t _z_geom;
+  RadiusOfInfluence _roi; // for the fused kernel
 
   long _clock = 0;
 
@@ -82,8 +180,33 @@ private:
   }
 
   int _DSizeI, _DSizeJ, _DSizeK; // Size of the grid
+  int _curveBits;                // bits per coordinate of the gate_order keys
 
   template <typename T> inline void _makeGrid(ptr_vector3d<T> &grid);
+  vector<string> _fieldNames; // fields gridded
+  map<string, FieldTransform> _transforms; // by field name
+  vector<FieldTransform> _outTransforms;   // in the order of outFields
+  SuperObs _superObs;
+
+  inline void _accumulate(const string &name, int i, int j, int k, double vw,
+                          double w, int n, bool tracing,
+                          std::atomic<long> &nContended);
+  const FieldTransform &_transformOf(const string &name) const;
+  void _scatterFused(bool tracing, std::atomic<long> &nContended);
+  void _scatterPoint(double X, double Y, double Z, double RoI, double E,
+                     double G, double S, const vector<string> &names,
+                     const vector<double> &vals, const vector<double> &mult,
+                     bool tracing, std::atomic<long> &nContended);
+  void _buildSuperObs(vector<size_t> &farGates);
+  uint64_t _gateCellKey(size_t m, bool &inside) const;
+  void _sortGates(vector<size_t> &order);
+  void _normalizeBricks(const string &name, vector3d<double> &field,
+                        vector<double> &minVals, vector<double> &maxVals);
+  void _initDerivedProducts();
+  void _deriveColumn(const double *dbz, size_t index);
+  template <typename T>
+  void _packField(const vector3d<double> &field, double minVal, double maxVal,
+                  PackedField &packed);
 
   template <typename T> inline void _makeGrid(ptr_vector3d<T> &grid, T value);
 };
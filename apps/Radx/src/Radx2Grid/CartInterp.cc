@@ -40,6 +40,9 @@
 #include <Radx/RadxSweep.hh>
 #include <Radx/RadxTime.hh>
 #include <algorithm>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_invoke.h>
 #include <toolsa/mem.h>
 #include <toolsa/pjg.h>
 #include <toolsa/sincos.h>
@@ -69,7 +72,6 @@ CartInterp::CartInterp(const string& progName,
   _searchMatrixUpperRight = NULL;
 
   _prevRadarLat = _prevRadarLon = _prevRadarAltKm = -9999.0;
-  _gridLoc = NULL;
   _outputFields = NULL;
 
   _nContribDebug = NULL;
@@ -134,7 +136,7 @@ CartInterp::interpVol()
 
   _printRunTime("Cart interp - reading data");
 
-  if (_gridLoc == NULL) {
+  if (!_gridLocs.isAllocated()) {
     _initGrid();
   }
 
@@ -211,10 +213,6 @@ CartInterp::interpVol()
   _doInterp();
   _printRunTime("Interpolating");
 
-  // transform for output
-
-  _transformForOutput();
-
   // write out data
 
   if (_writeOutputFile()) {
@@ -252,30 +250,6 @@ void
 CartInterp::_createThreads()
 {
 
-  _threadComputeLowerLeft.setContext(this);
-  pthread_t pthLL = 0;
-  pthread_create(
-    &pthLL, NULL, _computeSearchLowerLeft, &_threadComputeLowerLeft);
-  _threadComputeLowerLeft.setThreadId(pthLL);
-
-  _threadComputeUpperLeft.setContext(this);
-  pthread_t pthUL = 0;
-  pthread_create(
-    &pthUL, NULL, _computeSearchUpperLeft, &_threadComputeUpperLeft);
-  _threadComputeUpperLeft.setThreadId(pthUL);
-
-  _threadComputeLowerRight.setContext(this);
-  pthread_t pthLR = 0;
-  pthread_create(
-    &pthLR, NULL, _computeSearchLowerRight, &_threadComputeLowerRight);
-  _threadComputeLowerRight.setThreadId(pthLR);
-
-  _threadComputeUpperRight.setContext(this);
-  pthread_t pthUR = 0;
-  pthread_create(
-    &pthUR, NULL, _computeSearchUpperRight, &_threadComputeUpperRight);
-  _threadComputeUpperRight.setThreadId(pthUR);
-
   // initialize compute object
 
   pthread_mutex_init(&_debugPrintMutex, NULL);
@@ -537,15 +511,7 @@ CartInterp::_initGrid()
 
   _freeGridLoc();
 
-  _gridLoc = (GridLoc****)umalloc3(_gridNz, _gridNy, _gridNx, sizeof(GridLoc*));
-
-  for (int iz = 0; iz < _gridNz; iz++) {
-    for (int iy = 0; iy < _gridNy; iy++) {
-      for (int ix = 0; ix < _gridNx; ix++) {
-        _gridLoc[iz][iy][ix] = new GridLoc;
-      }
-    }
-  }
+  _gridLocs.alloc(_gridNz, _gridNy, _gridNx);
 
   for (size_t ii = 0; ii < _derived3DFields.size(); ii++) {
     _derived3DFields[ii]->alloc(_nPointsVol, _gridZLevels);
@@ -573,20 +539,8 @@ CartInterp::_freeGridLoc()
 
 {
 
-  if (_gridLoc) {
-    for (int iz = 0; iz < _gridNz; iz++) {
-      for (int iy = 0; iy < _gridNy; iy++) {
-        for (int ix = 0; ix < _gridNx; ix++) {
-          delete _gridLoc[iz][iy][ix];
-        }
-      }
-    }
-    ufree3((void***)_gridLoc);
-  }
-
-  _gridLoc = NULL;
-
-  _prevRadarLat = _prevRadarLon = _prevRadarAltKm = -9999.0;
+  _gridLocs.clear();
+  _resetGridGeom();
 }
 
 ////////////////////////////////////////////////////////////
@@ -778,18 +732,12 @@ CartInterp::_computeGridRelative()
 
 {
 
-  // check if radar has moved
+  // check if radar or grid has changed
 
-  if (fabs(_prevRadarLat - _radarLat) < 0.00001 &&
-      fabs(_prevRadarLon - _radarLon) < 0.00001 &&
-      fabs(_prevRadarAltKm - _radarAltKm) < 0.00001) {
+  if (!_gridGeomHasChanged()) {
     return;
   }
 
-  _prevRadarLat = _radarLat;
-  _prevRadarLon = _radarLon;
-  _prevRadarAltKm = _radarAltKm;
-
   if (_params.center_grid_on_radar) {
     _gridOriginLat = _radarLat;
     _gridOriginLon = _radarLon;
@@ -932,15 +880,15 @@ CartInterp::_computeGridRow(int iz, int iy)
     double yyInstr = gndRange * cosAz;
     double zzInstr = zz - _radarAltKm;
 
-    GridLoc* loc = _gridLoc[iz][iy][ix];
-    loc->el = elevDeg;
-    loc->az = azimuth;
-    loc->slantRange = beamHt.getSlantRangeKm();
-    loc->gndRange = beamHt.getGndRangeKm();
+    size_t ii = _gridLocs.index(iz, iy, ix);
+    _gridLocs.el[ii] = elevDeg;
+    _gridLocs.az[ii] = azimuth;
+    _gridLocs.slantRange[ii] = beamHt.getSlantRangeKm();
+    _gridLocs.gndRange[ii] = beamHt.getGndRangeKm();
 
-    loc->xxInstr = xxInstr;
-    loc->yyInstr = yyInstr;
-    loc->zzInstr = zzInstr;
+    _gridLocs.xxInstr[ii] = xxInstr;
+    _gridLocs.yyInstr[ii] = yyInstr;
+    _gridLocs.zzInstr[ii] = zzInstr;
 
   } // ix
 }
@@ -999,14 +947,17 @@ CartInterp::_initSearchMatrix()
 
 {
 
-  for (int iel = 0; iel < _searchNEl; iel++) {
-    for (int iaz = 0; iaz < _searchNAz; iaz++) {
-      _searchMatrixLowerLeft[iel][iaz].clear();
-      _searchMatrixUpperLeft[iel][iaz].clear();
-      _searchMatrixLowerRight[iel][iaz].clear();
-      _searchMatrixUpperRight[iel][iaz].clear();
-    }
-  }
+  tbb::parallel_for(tbb::blocked_range<size_t>(0, _searchNEl),
+                    [&](const tbb::blocked_range<size_t>& r) {
+                      for (size_t iel = r.begin(); iel != r.end(); ++iel) {
+                        for (int iaz = 0; iaz < _searchNAz; iaz++) {
+                          _searchMatrixLowerLeft[iel][iaz].clear();
+                          _searchMatrixUpperLeft[iel][iaz].clear();
+                          _searchMatrixLowerRight[iel][iaz].clear();
+                          _searchMatrixUpperRight[iel][iaz].clear();
+                        }
+                      }
+                    });
 
   for (size_t iray = 0; iray < _interpRays.size(); iray++) {
 
@@ -1124,33 +1075,39 @@ CartInterp::_fillSearchMatrix()
   _allocSearchMatrix();
   _initSearchMatrix();
 
-  // we compute the matrix in each of 4 threads
+  // the fill depends only on the cells holding a ray, so it is
+  // reused for the scan strategy (VCP) if those are unchanged
 
-  if (_params.use_multiple_threads) {
+  vector<int> seeds;
+  _getSearchSeeds(seeds);
 
-    _threadComputeLowerLeft.signalWorkToStart();
-    _threadComputeUpperLeft.signalWorkToStart();
-    _threadComputeLowerRight.signalWorkToStart();
-    _threadComputeUpperRight.signalWorkToStart();
+  int scanId = _readVol.getScanId();
+  const SearchCache* cache = NULL;
+  if (_params.search_matrix_cache_size > 0) {
+    cache = _findSearchCache(scanId, seeds);
+  }
 
-    _threadComputeLowerLeft.waitForWorkToComplete();
-    _threadComputeUpperLeft.waitForWorkToComplete();
-    _threadComputeLowerRight.waitForWorkToComplete();
-    _threadComputeUpperRight.waitForWorkToComplete();
+  if (cache) {
 
-  } else {
+    if (_params.debug) {
+      cerr << "  Reusing search matrix for scan id: " << scanId << endl;
+    }
+    _applySearchCache(*cache);
 
-    _threadComputeLowerLeft.signalWorkToStart();
-    _threadComputeLowerLeft.waitForWorkToComplete();
+  } else {
 
-    _threadComputeUpperLeft.signalWorkToStart();
-    _threadComputeUpperLeft.waitForWorkToComplete();
+    // the quadrants are independent, and each level of a quadrant
+    // is filled in parallel
 
-    _threadComputeLowerRight.signalWorkToStart();
-    _threadComputeLowerRight.waitForWorkToComplete();
+    tbb::parallel_invoke(
+      [&] { _fillSearchQuadrant(_searchMatrixLowerLeft, 1, 1, seeds); },
+      [&] { _fillSearchQuadrant(_searchMatrixUpperLeft, -1, 1, seeds); },
+      [&] { _fillSearchQuadrant(_searchMatrixLowerRight, 1, -1, seeds); },
+      [&] { _fillSearchQuadrant(_searchMatrixUpperRight, -1, -1, seeds); });
 
-    _threadComputeUpperRight.signalWorkToStart();
-    _threadComputeUpperRight.waitForWorkToComplete();
+    if (_params.search_matrix_cache_size > 0) {
+      _saveSearchCache(scanId, seeds);
+    }
   }
 
   if (_params.debug >= Params::DEBUG_EXTRA) {
@@ -1265,486 +1222,379 @@ CartInterp::_printSearchMatrixPoint(FILE* out, int iel, int iaz)
 }
 
 ///////////////////////////////////////////////////////////
-// Thread function to compute search matrix lower left
+// Get the search matrix cells which hold a ray before the
+// fill, in row-major order
 
-void*
-CartInterp::_computeSearchLowerLeft(void* thread_data)
+void
+CartInterp::_getSearchSeeds(vector<int>& seeds)
 {
 
-  CartThread* interpThread = (CartThread*)thread_data;
-  CartInterp* interp = interpThread->getContext();
-  assert(interp);
-
-  // load search matrix
-
-  while (true) {
-
-    interpThread->waitForStartSignal();
-
-    vector<SearchIndex> thisSearch, nextSearch;
-    for (int level = 0; level < interp->_searchMaxCount; level++) {
-      if (interp->_fillSearchLowerLeft(level, thisSearch, nextSearch) == 0) {
-        break;
-      }
-      thisSearch = nextSearch;
-    }
-
-    interpThread->signalParentWorkIsComplete();
-  }
-
-  return NULL;
+  vector<int> rowStart(_searchNEl + 1, 0);
+  tbb::parallel_for(tbb::blocked_range<size_t>(0, _searchNEl),
+                    [&](const tbb::blocked_range<size_t>& r) {
+                      for (size_t iel = r.begin(); iel != r.end(); ++iel) {
+                        int count = 0;
+                        for (int iaz = 0; iaz < _searchNAz; iaz++) {
+                          if (_searchMatrixLowerLeft[iel][iaz].ray) {
+                            count++;
+                          }
+                        }
+                        rowStart[iel + 1] = count;
+                      }
+                    });
+  for (int iel = 0; iel < _searchNEl; iel++) {
+    rowStart[iel + 1] += rowStart[iel];
+  }
+
+  seeds.resize(rowStart[_searchNEl]);
+  tbb::parallel_for(tbb::blocked_range<size_t>(0, _searchNEl),
+                    [&](const tbb::blocked_range<size_t>& r) {
+                      for (size_t iel = r.begin(); iel != r.end(); ++iel) {
+                        int pos = rowStart[iel];
+                        for (int iaz = 0; iaz < _searchNAz; iaz++) {
+                          if (_searchMatrixLowerLeft[iel][iaz].ray) {
+                            seeds[pos++] = iel * _searchNAz + iaz;
+                          }
+                        }
+                      }
+                    });
 }
 
-///////////////////////////////////////////////////////////
-// Thread function to compute search matrix upper left
+////////////////////////////////////////////////////////////
+// Fill one quadrant of the search matrix, propagating the
+// ray information by dEl in elevation and dAz in azimuth.
+//
+//   lower left:  dEl =  1, dAz =  1
+//   upper left:  dEl = -1, dAz =  1
+//   lower right: dEl =  1, dAz = -1
+//   upper right: dEl = -1, dAz = -1
+//
+// The fill is a breadth-first search out from the seed cells,
+// one level per step. Each level is processed in parallel.
+
+void
+CartInterp::_fillSearchQuadrant(SearchPoint** matrix,
+                                int dEl,
+                                int dAz,
+                                const vector<int>& seeds)
 
-void*
-CartInterp::_computeSearchUpperLeft(void* thread_data)
 {
 
-  CartThread* interpThread = (CartThread*)thread_data;
-  CartInterp* interp = interpThread->getContext();
-  assert(interp);
+  // rank of each cell in the current level's search
 
-  while (true) {
+  vector<int> rank(_searchNEl * _searchNAz);
 
-    interpThread->waitForStartSignal();
+  // initial search - the seeds, taking the rows, and the cells
+  // within a row, from the far side of the propagation. The
+  // seeds are in row-major order.
 
-    vector<SearchIndex> thisSearch, nextSearch;
-    for (int level = 0; level < interp->_searchMaxCount; level++) {
-      if (interp->_fillSearchUpperLeft(level, thisSearch, nextSearch) == 0) {
-        break;
-      }
+  vector<size_t> rowRuns;
+  for (size_t ii = 0; ii < seeds.size(); ii++) {
+    if (ii == 0 || seeds[ii] / _searchNAz != seeds[ii - 1] / _searchNAz) {
+      rowRuns.push_back(ii);
     }
-
-    interpThread->signalParentWorkIsComplete();
   }
+  size_t nRuns = rowRuns.size();
+  rowRuns.push_back(seeds.size());
 
-  return NULL;
-}
-
-///////////////////////////////////////////////////////////
-// Thread function to compute search matrix lower right
-
-void*
-CartInterp::_computeSearchLowerRight(void* thread_data)
-{
-
-  CartThread* interpThread = (CartThread*)thread_data;
-  CartInterp* interp = interpThread->getContext();
-  assert(interp);
-
-  while (true) {
-
-    interpThread->waitForStartSignal();
-
-    vector<SearchIndex> thisSearch, nextSearch;
-    for (int level = 0; level < interp->_searchMaxCount; level++) {
-      if (interp->_fillSearchLowerRight(level, thisSearch, nextSearch) == 0) {
-        break;
+  vector<SearchIndex> thisSearch, nextSearch;
+  thisSearch.reserve(seeds.size());
+  for (size_t irun = 0; irun < nRuns; irun++) {
+    size_t run = (dEl > 0 ? irun : nRuns - 1 - irun);
+    size_t begin = rowRuns[run];
+    size_t end = rowRuns[run + 1];
+    for (size_t jj = 0; jj < end - begin; jj++) {
+      int seed = seeds[dAz > 0 ? begin + jj : end - 1 - jj];
+      int iel = seed / _searchNAz;
+      int iaz = seed % _searchNAz;
+      if (_canPropagate(matrix[iel][iaz], iel, iaz, dEl, dAz)) {
+        rank[seed] = (int)thisSearch.size();
+        thisSearch.push_back(SearchIndex(iel, iaz));
       }
     }
-
-    interpThread->signalParentWorkIsComplete();
   }
 
-  return NULL;
-}
-
-///////////////////////////////////////////////////////////
-// Thread function to compute search matrix upper right
-
-void*
-CartInterp::_computeSearchUpperRight(void* thread_data)
-{
-
-  CartThread* interpThread = (CartThread*)thread_data;
-  CartInterp* interp = interpThread->getContext();
-  assert(interp);
-
-  while (true) {
+  // propagate, level by level
 
-    interpThread->waitForStartSignal();
-
-    vector<SearchIndex> thisSearch, nextSearch;
-    for (int level = 0; level < interp->_searchMaxCount; level++) {
-      if (interp->_fillSearchUpperRight(level, thisSearch, nextSearch) == 0) {
-        break;
-      }
+  for (int level = 0; level < _searchMaxCount; level++) {
+    if (thisSearch.size() == 0) {
+      break;
     }
-
-    interpThread->signalParentWorkIsComplete();
+    _propagateSearchLevel(
+      matrix, dEl, dAz, level, thisSearch, rank, nextSearch);
+    thisSearch.swap(nextSearch);
   }
-
-  return NULL;
 }
 
 ////////////////////////////////////////////////////////////
-// Fill the matrix for ray down and left of the search point
+// Propagate one level of the search for a quadrant.
 //
-// We do this by propagating the ray information up and
-// to the right.
+// A free cell may be reached from two points in this level:
+// its neighbor back along azimuth, and back along elevation.
+// Processing the points in order, it goes to the one which
+// comes first in thisSearch. So each point claims a neighbor
+// only if the other candidate comes later, and the claims are
+// then placed in nextSearch in that same order. The result does
+// not depend on the threading.
 
-int
-CartInterp::_fillSearchLowerLeft(int level,
-                                 vector<SearchIndex>& thisSearch,
-                                 vector<SearchIndex>& nextSearch)
+void
+CartInterp::_propagateSearchLevel(SearchPoint** matrix,
+                                  int dEl,
+                                  int dAz,
+                                  int level,
+                                  const vector<SearchIndex>& thisSearch,
+                                  vector<int>& rank,
+                                  vector<SearchIndex>& nextSearch)
 
 {
 
-  // for initial level, prepare initial search vector
-
-  if (level == 0) {
-    thisSearch.clear();
-    for (int iel = 0; iel < _searchNEl - 1; iel++) {
-      for (int iaz = 0; iaz < _searchNAz - 1; iaz++) {
-        SearchPoint& sp = _searchMatrixLowerLeft[iel][iaz];
-        if (sp.ray != NULL) {
-          SearchIndex si(iel, iaz);
-          thisSearch.push_back(si);
+  // claims: bit 0 for the azimuth neighbor, bit 1 for elevation
+
+  size_t nThis = thisSearch.size();
+  vector<unsigned char> claims(nThis);
+
+  tbb::parallel_for(
+    tbb::blocked_range<size_t>(0, nThis),
+    [&](const tbb::blocked_range<size_t>& r) {
+      for (size_t ii = r.begin(); ii != r.end(); ++ii) {
+        int iel = thisSearch[ii].elIndex;
+        int iaz = thisSearch[ii].azIndex;
+        unsigned char claim = 0;
+        if (_canPropagate(matrix[iel][iaz], iel, iaz, dEl, dAz)) {
+          if (matrix[iel][iaz + dAz].ray == NULL &&
+              !_reachedEarlier(
+                matrix, rank, level, iel - dEl, iaz + dAz, dEl, dAz, ii)) {
+            claim |= 1;
+          }
+          if (matrix[iel + dEl][iaz].ray == NULL &&
+              !_reachedEarlier(
+                matrix, rank, level, iel + dEl, iaz - dAz, dEl, dAz, ii)) {
+            claim |= 2;
+          }
         }
+        claims[ii] = claim;
       }
-    }
-  } else {
-    thisSearch = nextSearch;
-  }
-
-  // clear next search
-
-  nextSearch.clear();
+    });
 
-  // loop through the search points
-
-  int count = 0;
-  for (size_t ii = 0; ii < thisSearch.size(); ii++) {
+  // position of each point's claims in the next search
 
-    int iel = thisSearch[ii].elIndex;
-    int iaz = thisSearch[ii].azIndex;
+  vector<int> start(nThis + 1);
+  start[0] = 0;
+  for (size_t ii = 0; ii < nThis; ii++) {
+    start[ii + 1] = start[ii] + (claims[ii] & 1) + (claims[ii] >> 1);
+  }
+  nextSearch.resize(start[nThis]);
 
-    if (iel >= _searchNEl - 1) {
-      continue;
-    }
-    if (iaz >= _searchNAz - 1) {
-      continue;
-    }
+  // fill the claimed cells - each is claimed by one point only
 
-    SearchPoint& sp = _searchMatrixLowerLeft[iel][iaz];
-    if (sp.elDist >= _searchMaxDistEl) {
-      continue;
-    }
-    if (sp.azDist >= _searchMaxDistAz) {
-      continue;
-    }
+  tbb::parallel_for(
+    tbb::blocked_range<size_t>(0, nThis),
+    [&](const tbb::blocked_range<size_t>& r) {
+      for (size_t ii = r.begin(); ii != r.end(); ++ii) {
+        if (claims[ii] == 0) {
+          continue;
+        }
+        int iel = thisSearch[ii].elIndex;
+        int iaz = thisSearch[ii].azIndex;
+        const SearchPoint& sp = matrix[iel][iaz];
+        int pos = start[ii];
+        if (claims[ii] & 1) {
+          SearchPoint& next = matrix[iel][iaz + dAz];
+          next.level = level + 1;
+          next.azDist = sp.azDist + 1;
+          next.elDist = sp.elDist;
+          next.ray = sp.ray;
+          next.rayEl = sp.rayEl;
+          next.rayAz = sp.rayAz;
+          nextSearch[pos] = SearchIndex(iel, iaz + dAz);
+          rank[iel * _searchNAz + iaz + dAz] = pos;
+          pos++;
+        }
+        if (claims[ii] & 2) {
+          SearchPoint& next = matrix[iel + dEl][iaz];
+          next.level = level + 1;
+          next.elDist = sp.elDist + 1;
+          next.azDist = sp.azDist;
+          next.ray = sp.ray;
+          next.rayEl = sp.rayEl;
+          next.rayAz = sp.rayAz;
+          nextSearch[pos] = SearchIndex(iel + dEl, iaz);
+          rank[(iel + dEl) * _searchNAz + iaz] = pos;
+        }
+      }
+    });
+}
 
-    // propagate to the right
-
-    SearchPoint& right = _searchMatrixLowerLeft[iel][iaz + 1];
-    if (right.ray == NULL) {
-      right.level = level + 1;
-      right.azDist = sp.azDist + 1;
-      right.elDist = sp.elDist;
-      right.ray = sp.ray;
-      right.rayEl = sp.rayEl;
-      right.rayAz = sp.rayAz;
-      count++;
-      SearchIndex si(iel, iaz + 1);
-      nextSearch.push_back(si);
-    }
+////////////////////////////////////////////////////////////
+// Can the ray information propagate from this search point?
 
-    // propagate up
-
-    SearchPoint& up = _searchMatrixLowerLeft[iel + 1][iaz];
-    if (up.ray == NULL) {
-      up.level = level + 1;
-      up.elDist = sp.elDist + 1;
-      up.azDist = sp.azDist;
-      up.ray = sp.ray;
-      up.rayEl = sp.rayEl;
-      up.rayAz = sp.rayAz;
-      count++;
-      SearchIndex si(iel + 1, iaz);
-      nextSearch.push_back(si);
-    }
+bool
+CartInterp::_canPropagate(const SearchPoint& sp,
+                          int iel,
+                          int iaz,
+                          int dEl,
+                          int dAz) const
+{
+  int jel = iel + dEl;
+  int jaz = iaz + dAz;
+  if (jel < 0 || jel >= _searchNEl || jaz < 0 || jaz >= _searchNAz) {
+    return false;
+  }
+  if (sp.elDist >= _searchMaxDistEl || sp.azDist >= _searchMaxDistAz) {
+    return false;
+  }
+  return true;
+}
 
-  } // ii
+////////////////////////////////////////////////////////////
+// Is the cell at (iel, iaz) in this level's search, able to
+// propagate, and ahead of the point at rank thisRank?
 
-  return count;
+bool
+CartInterp::_reachedEarlier(SearchPoint** matrix,
+                            const vector<int>& rank,
+                            int level,
+                            int iel,
+                            int iaz,
+                            int dEl,
+                            int dAz,
+                            size_t thisRank) const
+{
+  if (iel < 0 || iel >= _searchNEl || iaz < 0 || iaz >= _searchNAz) {
+    return false;
+  }
+  const SearchPoint& sp = matrix[iel][iaz];
+  if (sp.ray == NULL || sp.level != level) {
+    return false;
+  }
+  if (!_canPropagate(sp, iel, iaz, dEl, dAz)) {
+    return false;
+  }
+  return rank[iel * _searchNAz + iaz] < (int)thisRank;
 }
 
 ////////////////////////////////////////////////////////////
-// Fill the matrix for ray up and left of the search point
+// Find the cached fill for this scan strategy.
+// It is used only if the seed cells and the search limits
+// match exactly, in which case the fill is the same.
 //
-// We do this by propagating the ray information down and
-// to the right.
-
-int
-CartInterp::_fillSearchUpperLeft(int level,
-                                 vector<SearchIndex>& thisSearch,
-                                 vector<SearchIndex>& nextSearch)
+// Returns NULL if there is none.
 
+const CartInterp::SearchCache*
+CartInterp::_findSearchCache(int scanId, const vector<int>& seeds) const
 {
-
-  // for initial level, prepare initial search vector
-
-  if (level == 0) {
-    thisSearch.clear();
-    for (int iel = _searchNEl - 1; iel > 0; iel--) {
-      for (int iaz = 0; iaz < _searchNAz - 1; iaz++) {
-        SearchPoint& sp = _searchMatrixUpperLeft[iel][iaz];
-        if (sp.ray != NULL) {
-          SearchIndex si(iel, iaz);
-          thisSearch.push_back(si);
-        }
-      }
+  for (size_t ii = 0; ii < _searchCache.size(); ii++) {
+    const SearchCache& cache = _searchCache[ii];
+    if (cache.scanId == scanId && cache.nEl == _searchNEl &&
+        cache.nAz == _searchNAz && cache.maxDistEl == _searchMaxDistEl &&
+        cache.maxDistAz == _searchMaxDistAz &&
+        cache.maxCount == _searchMaxCount && cache.seeds == seeds) {
+      return &cache;
     }
-  } else {
-    thisSearch = nextSearch;
   }
-
-  // clear next search
-
-  nextSearch.clear();
-
-  // loop through the search points
-
-  int count = 0;
-  for (size_t ii = 0; ii < thisSearch.size(); ii++) {
-
-    int iel = thisSearch[ii].elIndex;
-    int iaz = thisSearch[ii].azIndex;
-
-    if (iel <= 0) {
-      continue;
-    }
-    if (iaz >= _searchNAz - 1) {
-      continue;
-    }
-
-    SearchPoint& sp = _searchMatrixUpperLeft[iel][iaz];
-    if (sp.elDist >= _searchMaxDistEl) {
-      continue;
-    }
-    if (sp.azDist >= _searchMaxDistAz) {
-      continue;
-    }
-
-    // propagate to the right
-
-    SearchPoint& right = _searchMatrixUpperLeft[iel][iaz + 1];
-    if (right.ray == NULL) {
-      right.level = level + 1;
-      right.azDist = sp.azDist + 1;
-      right.elDist = sp.elDist;
-      right.ray = sp.ray;
-      right.rayEl = sp.rayEl;
-      right.rayAz = sp.rayAz;
-      count++;
-      SearchIndex si(iel, iaz + 1);
-      nextSearch.push_back(si);
-    }
-
-    // propagate down
-
-    SearchPoint& down = _searchMatrixUpperLeft[iel - 1][iaz];
-    if (down.ray == NULL) {
-      down.level = level + 1;
-      down.elDist = sp.elDist + 1;
-      down.azDist = sp.azDist;
-      down.ray = sp.ray;
-      down.rayEl = sp.rayEl;
-      down.rayAz = sp.rayAz;
-      count++;
-      SearchIndex si(iel - 1, iaz);
-      nextSearch.push_back(si);
-    }
-
-  } // ii
-
-  return count;
+  return NULL;
 }
 
 ////////////////////////////////////////////////////////////
-// Fill the matrix for ray down and right of the search point
-//
-// We do this by propagating the ray information up and
-// to the left.
-
-int
-CartInterp::_fillSearchLowerRight(int level,
-                                  vector<SearchIndex>& thisSearch,
-                                  vector<SearchIndex>& nextSearch)
+// Save the fill for this scan strategy, replacing any
+// previous entry for it, and keeping the most recent
+// search_matrix_cache_size strategies
 
+void
+CartInterp::_saveSearchCache(int scanId, const vector<int>& seeds)
 {
 
-  // for initial level, prepare initial search vector
-
-  if (level == 0) {
-    thisSearch.clear();
-    for (int iel = 0; iel < _searchNEl - 1; iel++) {
-      for (int iaz = _searchNAz - 1; iaz > 0; iaz--) {
-        SearchPoint& sp = _searchMatrixLowerRight[iel][iaz];
-        if (sp.ray != NULL) {
-          SearchIndex si(iel, iaz);
-          thisSearch.push_back(si);
+  for (size_t ii = 0; ii < _searchCache.size(); ii++) {
+    if (_searchCache[ii].scanId == scanId) {
+      _searchCache.erase(_searchCache.begin() + ii);
+      break;
+    }
+  }
+  while ((int)_searchCache.size() >= _params.search_matrix_cache_size) {
+    _searchCache.pop_back();
+  }
+
+  _searchCache.push_front(SearchCache());
+  SearchCache& cache = _searchCache.front();
+  cache.scanId = scanId;
+  cache.nEl = _searchNEl;
+  cache.nAz = _searchNAz;
+  cache.maxDistEl = _searchMaxDistEl;
+  cache.maxDistAz = _searchMaxDistAz;
+  cache.maxCount = _searchMaxCount;
+  cache.seeds = seeds;
+
+  // the seed each cell was filled from lies back along the
+  // propagation by the cell's el and az distances
+
+  SearchPoint** matrices[4] = { _searchMatrixLowerLeft,
+                                _searchMatrixUpperLeft,
+                                _searchMatrixLowerRight,
+                                _searchMatrixUpperRight };
+  const int dEl[4] = { 1, -1, 1, -1 };
+  const int dAz[4] = { 1, 1, -1, -1 };
+
+  for (int iq = 0; iq < 4; iq++) {
+    cache.source[iq].resize(_searchNEl * _searchNAz);
+  }
+  tbb::parallel_for(
+    tbb::blocked_range<size_t>(0, _searchNEl),
+    [&](const tbb::blocked_range<size_t>& r) {
+      for (size_t iel = r.begin(); iel != r.end(); ++iel) {
+        for (int iq = 0; iq < 4; iq++) {
+          int* source = &cache.source[iq][iel * _searchNAz];
+          for (int iaz = 0; iaz < _searchNAz; iaz++) {
+            const SearchPoint& sp = matrices[iq][iel][iaz];
+            if (sp.ray == NULL) {
+              source[iaz] = -1;
+            } else {
+              source[iaz] = ((int)iel - dEl[iq] * sp.elDist) * _searchNAz +
+                            iaz - dAz[iq] * sp.azDist;
+            }
+          }
         }
       }
-    }
-  } else {
-    thisSearch = nextSearch;
-  }
-
-  // clear next search
-
-  nextSearch.clear();
-
-  // loop through the search points
-
-  int count = 0;
-  for (size_t ii = 0; ii < thisSearch.size(); ii++) {
-
-    int iel = thisSearch[ii].elIndex;
-    int iaz = thisSearch[ii].azIndex;
-
-    if (iel >= _searchNEl - 1) {
-      continue;
-    }
-    if (iaz <= 0) {
-      continue;
-    }
-
-    SearchPoint& sp = _searchMatrixLowerRight[iel][iaz];
-    if (sp.elDist >= _searchMaxDistEl) {
-      continue;
-    }
-    if (sp.azDist >= _searchMaxDistAz) {
-      continue;
-    }
-
-    // propagate to the left
-
-    SearchPoint& left = _searchMatrixLowerRight[iel][iaz - 1];
-    if (left.ray == NULL) {
-      left.level = level + 1;
-      left.azDist = sp.azDist + 1;
-      left.elDist = sp.elDist;
-      left.ray = sp.ray;
-      left.rayEl = sp.rayEl;
-      left.rayAz = sp.rayAz;
-      count++;
-      SearchIndex si(iel, iaz - 1);
-      nextSearch.push_back(si);
-    }
-
-    // propagate up
-
-    SearchPoint& up = _searchMatrixLowerRight[iel + 1][iaz];
-    if (up.ray == NULL) {
-      up.level = level + 1;
-      up.elDist = sp.elDist + 1;
-      up.azDist = sp.azDist;
-      up.ray = sp.ray;
-      up.rayEl = sp.rayEl;
-      up.rayAz = sp.rayAz;
-      count++;
-      SearchIndex si(iel + 1, iaz);
-      nextSearch.push_back(si);
-    }
-
-  } // ii
-
-  return count;
+    });
 }
 
 ////////////////////////////////////////////////////////////
-// Fill the matrix for ray up and right of the search point
-//
-// We do this by propagating the ray information below and
-// to the left.
-
-int
-CartInterp::_fillSearchUpperRight(int level,
-                                  vector<SearchIndex>& thisSearch,
-                                  vector<SearchIndex>& nextSearch)
+// Fill the search matrix from the cache.
+// The seeds are already set, by _initSearchMatrix().
 
+void
+CartInterp::_applySearchCache(const SearchCache& cache)
 {
 
-  // for initial level, prepare initial search vector
-
-  if (level == 0) {
-    thisSearch.clear();
-    for (int iel = _searchNEl - 1; iel > 0; iel--) {
-      for (int iaz = _searchNAz - 1; iaz > 0; iaz--) {
-        SearchPoint& sp = _searchMatrixUpperRight[iel][iaz];
-        if (sp.ray != NULL) {
-          SearchIndex si(iel, iaz);
-          thisSearch.push_back(si);
+  SearchPoint** matrices[4] = { _searchMatrixLowerLeft,
+                                _searchMatrixUpperLeft,
+                                _searchMatrixLowerRight,
+                                _searchMatrixUpperRight };
+
+  tbb::parallel_for(
+    tbb::blocked_range<size_t>(0, _searchNEl),
+    [&](const tbb::blocked_range<size_t>& r) {
+      for (size_t iel = r.begin(); iel != r.end(); ++iel) {
+        for (int iq = 0; iq < 4; iq++) {
+          const int* source = &cache.source[iq][iel * _searchNAz];
+          for (int iaz = 0; iaz < _searchNAz; iaz++) {
+            int seed = source[iaz];
+            if (seed < 0 || seed == (int)iel * _searchNAz + iaz) {
+              continue;
+            }
+            int seedEl = seed / _searchNAz;
+            int seedAz = seed % _searchNAz;
+            const SearchPoint& from = matrices[iq][seedEl][seedAz];
+            SearchPoint& sp = matrices[iq][iel][iaz];
+            sp.elDist = abs((int)iel - seedEl);
+            sp.azDist = abs(iaz - seedAz);
+            sp.level = sp.elDist + sp.azDist;
+            sp.ray = from.ray;
+            sp.rayEl = from.rayEl;
+            sp.rayAz = from.rayAz;
+          }
         }
       }
-    }
-  } else {
-    thisSearch = nextSearch;
-  }
-
-  // clear next search
-
-  nextSearch.clear();
-
-  // loop through the search points
-
-  int count = 0;
-  for (size_t ii = 0; ii < thisSearch.size(); ii++) {
-
-    int iel = thisSearch[ii].elIndex;
-    int iaz = thisSearch[ii].azIndex;
-
-    if (iel <= 0) {
-      continue;
-    }
-    if (iaz <= 0) {
-      continue;
-    }
-
-    SearchPoint& sp = _searchMatrixUpperRight[iel][iaz];
-    if (sp.elDist >= _searchMaxDistEl) {
-      continue;
-    }
-    if (sp.azDist >= _searchMaxDistAz) {
-      continue;
-    }
-
-    // propagate to the left
-
-    SearchPoint& left = _searchMatrixUpperRight[iel][iaz - 1];
-    if (left.ray == NULL) {
-      left.level = level + 1;
-      left.azDist = sp.azDist + 1;
-      left.elDist = sp.elDist;
-      left.ray = sp.ray;
-      left.rayEl = sp.rayEl;
-      left.rayAz = sp.rayAz;
-      count++;
-      SearchIndex si(iel, iaz - 1);
-      nextSearch.push_back(si);
-    }
-
-    // propagate down
-
-    SearchPoint& down = _searchMatrixUpperRight[iel - 1][iaz];
-    if (down.ray == NULL) {
-      down.level = level + 1;
-      down.elDist = sp.elDist + 1;
-      down.azDist = sp.azDist;
-      down.ray = sp.ray;
-      down.rayEl = sp.rayEl;
-      down.rayAz = sp.rayAz;
-      count++;
-      SearchIndex si(iel - 1, iaz);
-      nextSearch.push_back(si);
-    }
-
-  } // ii
-
-  return count;
+    });
 }
 
 /////////////////////////////////////////////////////////
@@ -1903,24 +1753,24 @@ CartInterp::_interpRow(int iz, int iy)
 
     // get the grid location
 
-    const GridLoc* loc = _gridLoc[iz][iy][ix];
+    const GridLoc loc = _gridLocs.get(iz, iy, ix);
 
     if (_gridAzDebug) {
-      _gridAzDebug->data[ptIndex] = fmod(loc->az, _params.modulus_for_azimuth);
+      _gridAzDebug->data[ptIndex] = fmod(loc.az, _params.modulus_for_azimuth);
     }
     if (_gridElDebug) {
       _gridElDebug->data[ptIndex] =
-        fmod(loc->el, _params.modulus_for_elevation);
+        fmod(loc.el, _params.modulus_for_elevation);
     }
     if (_gridRangeDebug) {
       _gridRangeDebug->data[ptIndex] =
-        fmod(loc->slantRange, _params.modulus_for_range);
+        fmod(loc.slantRange, _params.modulus_for_range);
     }
 
     // find starting location in search matrix
 
-    int iel = _getSearchElIndex(loc->el);
-    double az = _conditionAz(loc->az);
+    int iel = _getSearchElIndex(loc.el);
+    double az = _conditionAz(loc.az);
     int iaz = _getSearchAzIndex(az);
 
     if (iel < 0 || iaz < 0) {
@@ -1951,7 +1801,7 @@ CartInterp::_interpRow(int iz, int iy)
       int jel = iel;
       int jaz = iaz;
       for (int ii = 0; ii < 2; ii++) {
-        if ((ll.rayEl > loc->el) && (jel > 0)) {
+        if ((ll.rayEl > loc.el) && (jel > 0)) {
           jel--;
           ll = _searchMatrixLowerLeft[jel][jaz];
           if (!ll.ray)
@@ -1973,7 +1823,7 @@ CartInterp::_interpRow(int iz, int iy)
       int jel = iel;
       int jaz = iaz;
       for (int ii = 0; ii < 2; ii++) {
-        if ((ul.rayEl < loc->el) && (jel < _searchNEl - 1)) {
+        if ((ul.rayEl < loc.el) && (jel < _searchNEl - 1)) {
           jel++;
           ul = _searchMatrixUpperLeft[jel][jaz];
           if (!ul.ray)
@@ -1995,7 +1845,7 @@ CartInterp::_interpRow(int iz, int iy)
       int jel = iel;
       int jaz = iaz;
       for (int ii = 0; ii < 2; ii++) {
-        if ((lr.rayEl > loc->el) && (jel > 0)) {
+        if ((lr.rayEl > loc.el) && (jel > 0)) {
           jel--;
           lr = _searchMatrixLowerRight[jel][jaz];
           if (!lr.ray)
@@ -2017,7 +1867,7 @@ CartInterp::_interpRow(int iz, int iy)
       int jel = iel;
       int jaz = iaz;
       for (int ii = 0; ii < 2; ii++) {
-        if ((ur.rayEl < loc->el) && (jel < _searchNEl - 1)) {
+        if ((ur.rayEl < loc.el) && (jel < _searchNEl - 1)) {
           jel++;
           ur = _searchMatrixUpperRight[jel][jaz];
           if (!ur.ray)
@@ -2042,7 +1892,7 @@ CartInterp::_interpRow(int iz, int iy)
       ll.interpEl = ll.rayEl;
       ll.interpAz = ll.rayAz;
     } else {
-      ll.interpEl = loc->el;
+      ll.interpEl = loc.el;
       ll.interpAz = az;
     }
 
@@ -2051,7 +1901,7 @@ CartInterp::_interpRow(int iz, int iy)
       ul.interpEl = ul.rayEl;
       ul.interpAz = ul.rayAz;
     } else {
-      ul.interpEl = loc->el;
+      ul.interpEl = loc.el;
       ul.interpAz = az;
     }
 
@@ -2060,7 +1910,7 @@ CartInterp::_interpRow(int iz, int iy)
       lr.interpEl = lr.rayEl;
       lr.interpAz = lr.rayAz;
     } else {
-      lr.interpEl = loc->el;
+      lr.interpEl = loc.el;
       lr.interpAz = az;
     }
 
@@ -2069,7 +1919,7 @@ CartInterp::_interpRow(int iz, int iy)
       ur.interpEl = ur.rayEl;
       ur.interpAz = ur.rayAz;
     } else {
-      ur.interpEl = loc->el;
+      ur.interpEl = loc.el;
       ur.interpAz = az;
     }
 
@@ -2141,13 +1991,13 @@ CartInterp::_interpRow(int iz, int iy)
         beamWidth = _beamWidthDegH;
       } else if (ll.ray && lr.ray) {
         // data is below
-        angleError = MAX(fabs(loc->el - ll.ray->elForLimits),
-                         fabs(loc->el - lr.ray->elForLimits));
+        angleError = MAX(fabs(loc.el - ll.ray->elForLimits),
+                         fabs(loc.el - lr.ray->elForLimits));
         beamWidth = _beamWidthDegV;
       } else if (ul.ray && ur.ray) {
         // data is above
-        angleError = MAX(fabs(loc->el - ul.ray->elForLimits),
-                         fabs(loc->el - ur.ray->elForLimits));
+        angleError = MAX(fabs(loc.el - ul.ray->elForLimits),
+                         fabs(loc.el - ur.ray->elForLimits));
         beamWidth = _beamWidthDegV;
       }
       // if angle error exceeds the beam width, cannot process
@@ -2161,7 +2011,7 @@ CartInterp::_interpRow(int iz, int iy)
 
     // get gate indices, compute weights based on range
 
-    double rangeKm = loc->slantRange;
+    double rangeKm = loc.slantRange;
     double dgate = (rangeKm - _startRangeKm) / _gateSpacingKm;
     int igateInner = (int)floor(dgate);
     int igateOuter = igateInner + 1;
@@ -2256,7 +2106,7 @@ CartInterp::_interpRow(int iz, int iy)
 // have 2 valid rays
 
 void
-CartInterp::_loadWtsFor2ValidRays(const GridLoc* loc,
+CartInterp::_loadWtsFor2ValidRays(const GridLoc& loc,
                                   const SearchPoint& ll,
                                   const SearchPoint& ul,
                                   const SearchPoint& lr,
@@ -2267,7 +2117,7 @@ CartInterp::_loadWtsFor2ValidRays(const GridLoc* loc,
 
 {
 
-  double az = _conditionAz(loc->az);
+  double az = _conditionAz(loc.az);
 
   // compute 'distance' in el/az space from ray to grid location
   // compute weights based on inverse of
@@ -2275,7 +2125,7 @@ CartInterp::_loadWtsFor2ValidRays(const GridLoc* loc,
   // by weight for range
 
   if (ll.ray) {
-    double dist_ll = _angDist(loc->el - ll.rayEl, az - ll.rayAz);
+    double dist_ll = _angDist(loc.el - ll.rayEl, az - ll.rayAz);
     double wtDist = 1.0 / dist_ll;
     wts.ll_inner = wtDist * wtInner;
     wts.ll_outer = wtDist * wtOuter;
@@ -2285,7 +2135,7 @@ CartInterp::_loadWtsFor2ValidRays(const GridLoc* loc,
   }
 
   if (ul.ray) {
-    double dist_ul = _angDist(loc->el - ul.rayEl, az - ul.rayAz);
+    double dist_ul = _angDist(loc.el - ul.rayEl, az - ul.rayAz);
     double wtDist = 1.0 / dist_ul;
     wts.ul_inner = wtDist * wtInner;
     wts.ul_outer = wtDist * wtOuter;
@@ -2295,7 +2145,7 @@ CartInterp::_loadWtsFor2ValidRays(const GridLoc* loc,
   }
 
   if (lr.ray) {
-    double dist_lr = _angDist(loc->el - lr.rayEl, az - lr.rayAz);
+    double dist_lr = _angDist(loc.el - lr.rayEl, az - lr.rayAz);
     double wtDist = 1.0 / dist_lr;
     wts.lr_inner = wtDist * wtInner;
     wts.lr_outer = wtDist * wtOuter;
@@ -2305,7 +2155,7 @@ CartInterp::_loadWtsFor2ValidRays(const GridLoc* loc,
   }
 
   if (ur.ray) {
-    double dist_ur = _angDist(loc->el - ur.rayEl, az - ur.rayAz);
+    double dist_ur = _angDist(loc.el - ur.rayEl, az - ur.rayAz);
     double wtDist = 1.0 / dist_ur;
     wts.ur_inner = wtDist * wtInner;
     wts.ur_outer = wtDist * wtOuter;
@@ -2319,7 +2169,7 @@ CartInterp::_loadWtsFor2ValidRays(const GridLoc* loc,
 // load up weights for 3 or 4 valid rays
 
 void
-CartInterp::_loadWtsFor3Or4ValidRays(const GridLoc* loc,
+CartInterp::_loadWtsFor3Or4ValidRays(const GridLoc& loc,
                                      const SearchPoint& ll,
                                      const SearchPoint& ul,
                                      const SearchPoint& lr,
@@ -2330,7 +2180,7 @@ CartInterp::_loadWtsFor3Or4ValidRays(const GridLoc* loc,
 
 {
 
-  double az = _conditionAz(loc->az);
+  double az = _conditionAz(loc.az);
 
   // compute wts for interpolating based on azimuth lower
 
@@ -2357,7 +2207,7 @@ CartInterp::_loadWtsFor3Or4ValidRays(const GridLoc* loc,
   double dEl = elUpperInterp - elLowerInterp;
   double wtElUpper = 0.5;
   if (dEl != 0) {
-    wtElUpper = (loc->el - elLowerInterp) / dEl;
+    wtElUpper = (loc.el - elLowerInterp) / dEl;
   }
   double wtElLower = 1.0 - wtElUpper;
 
@@ -2474,7 +2324,8 @@ CartInterp::_loadNearestGridPt(int ifield,
   // compute weighted mean
 
   if (nContrib >= _params.min_nvalid_for_interp) {
-    _outputFields[ifield][ptIndex] = closestVal;
+    _outputFields[ifield][ptIndex] =
+      _outputVal(_interpFields[ifield], closestVal);
   } else {
     _outputFields[ifield][ptIndex] = missingFl32;
   }
@@ -2560,7 +2411,8 @@ CartInterp::_loadInterpGridPt(int ifield,
     if (sumWts > 0) {
       interpVal = sumVals / sumWts;
     }
-    _outputFields[ifield][ptIndex] = interpVal;
+    _outputFields[ifield][ptIndex] =
+      _outputVal(_interpFields[ifield], interpVal);
   } else {
     _outputFields[ifield][ptIndex] = missingFl32;
   }
@@ -2652,7 +2504,8 @@ CartInterp::_loadFoldedGridPt(int ifield,
     double angleInterp = atan2(sumY, sumX);
     double valInterp =
       _getFoldValue(angleInterp, intFld.foldLimitLower, intFld.foldRange);
-    _outputFields[ifield][ptIndex] = valInterp;
+    _outputFields[ifield][ptIndex] =
+      _outputVal(_interpFields[ifield], valInterp);
   } else {
     _outputFields[ifield][ptIndex] = missingFl32;
   }
@@ -3144,46 +2997,32 @@ CartInterp::_convStratCompute()
     filledSqTexture[ii] = missingFl32;
   }
 
-  // set up threads for computing texture at each level
-
-  vector<ComputeTexture*> threads;
-  for (int iz = 0; iz <= _gridNz; iz++) {
-    size_t zoffset = iz * _nPointsPlane;
-    ComputeTexture* thread = new ComputeTexture(iz);
-    thread->setGridSize(_gridNx, _gridNy);
-    thread->setKernelSize(_nxTexture, _nyTexture);
-    thread->setKernel(_textureKernel);
-    thread->setMinValidFraction(
-      _params.conv_strat_min_valid_fraction_for_texture);
-    thread->setFields(dbzCount + zoffset,
-                      dbzSum + zoffset,
-                      dbzSqSum + zoffset,
-                      dbzSqSqSum + zoffset,
-                      texture + zoffset,
-                      sqTexture + zoffset,
-                      filledTexture + zoffset,
-                      filledSqTexture + zoffset);
-    threads.push_back(thread);
-  } // iz
-
-  // set threads going
-
-  for (size_t ii = 0; ii < threads.size(); ii++) {
-    threads[ii]->signalRunToStart();
-  }
-
-  // wait until they are done
-
-  for (size_t ii = 0; ii < threads.size(); ii++) {
-    threads[ii]->waitForRunToComplete();
-  }
-
-  // delete threads
-
-  for (size_t ii = 0; ii < threads.size(); ii++) {
-    delete threads[ii];
-  }
-  threads.clear();
+  // compute texture at each level - the levels, and the rows
+  // within each level, in parallel
+
+  tbb::parallel_for(
+    tbb::blocked_range<size_t>(0, _gridNz),
+    [&](const tbb::blocked_range<size_t>& r) {
+      for (size_t iz = r.begin(); iz != r.end(); ++iz) {
+        size_t zoffset = iz * _nPointsPlane;
+        ComputeTexture compute(iz);
+        compute.setGridSize(_gridNx, _gridNy);
+        compute.setKernelSize(_nxTexture, _nyTexture);
+        compute.setKernelHalfWidths(_textureKernelHalfWidths);
+        compute.setKernelRadius(_textureRadiusKm, _gridDx, _gridDy);
+        compute.setMinValidFraction(
+          _params.conv_strat_min_valid_fraction_for_texture);
+        compute.setFields(dbzCount + zoffset,
+                          dbzSum + zoffset,
+                          dbzSqSum + zoffset,
+                          dbzSqSqSum + zoffset,
+                          texture + zoffset,
+                          sqTexture + zoffset,
+                          filledTexture + zoffset,
+                          filledSqTexture + zoffset);
+        compute.run();
+      } // iz
+    });
 
   // compute min and max vert indices
 
@@ -3336,6 +3175,11 @@ CartInterp::_convStratComputeKernels()
     cerr << "  nx: " << _nxTexture << endl;
   }
 
+  // the distance grows with |jdx|, so each row of the kernel
+  // is one span, from -halfWidth to halfWidth
+
+  _textureKernelHalfWidths.assign(2 * _nyTexture + 1, -1);
+
   kernel_t entry;
   for (int jdy = -_nyTexture; jdy <= _nyTexture; jdy++) {
     double yy = jdy * _gridDy;
@@ -3345,6 +3189,9 @@ CartInterp::_convStratComputeKernels()
       if (entry.distance <= _textureRadiusKm) {
         entry.offset = jdx + jdy * _gridNx;
         _textureKernel.push_back(entry);
+        if (jdx > _textureKernelHalfWidths[jdy + _nyTexture]) {
+          _textureKernelHalfWidths[jdy + _nyTexture] = jdx;
+        }
       }
     }
   }
@@ -3423,34 +3270,33 @@ CartInterp::_convStratComputeVertLookups()
 ///////////////////////////////////////////////////////////////
 // ComputeTexture inner class
 //
-// Compute texture for 1 level in a thread
+// Compute texture for 1 level
 //
 ///////////////////////////////////////////////////////////////
 
 // Constructor
 
 CartInterp::ComputeTexture::ComputeTexture(int iz)
-  : TaThread()
-  , _iz(iz)
+  : _iz(iz)
 {
-  char name[128];
-  sprintf(name, "ComputeTexture-level-%d", _iz);
-  setThreadName(name);
   _dbzCount = NULL;
   _dbzSum = NULL;
   _dbzSqSum = NULL;
   _dbzSqSqSum = NULL;
   _dbzTexture = NULL;
   _dbzSqTexture = NULL;
+  _filledTexture = NULL;
+  _filledSqTexture = NULL;
   _nx = _ny = 0;
   _nxTexture = _nyTexture = 0;
+  _radiusKm = _dxKm = _dyKm = 0.0;
+  _minValidFraction = 0.0;
 }
 
 CartInterp::ComputeTexture::~ComputeTexture()
 {
 }
 
-// override run method
 // compute texture at each point in plane
 
 void
@@ -3459,76 +3305,255 @@ CartInterp::ComputeTexture::run()
 
   // check for validity
 
-  if (_dbzCount == NULL) {
+  if (_dbzCount == NULL ||
+      (int)_halfWidths.size() != 2 * _nyTexture + 1) {
     cerr << "ERROR - ComputeTexture::run" << endl;
     cerr << "  Initialization not complete" << endl;
     return;
   }
 
-  // compute texture at each point in the plane
+  // compute texture at each point in the plane, by row
 
-  int minPtsForTexture = (int)(_minValidFraction * _kernel.size() + 0.5);
+  int kernelSize = 0;
+  for (size_t ii = 0; ii < _halfWidths.size(); ii++) {
+    if (_halfWidths[ii] >= 0) {
+      kernelSize += 2 * _halfWidths[ii] + 1;
+    }
+  }
+  int minPtsForTexture = (int)(_minValidFraction * kernelSize + 0.5);
 
-  for (int iy = _nyTexture; iy < _ny - _nyTexture; iy++) {
+  int nCenters = _nx - 2 * _nxTexture;
+  int iyEnd = _ny - _nyTexture;
+  if (nCenters > 0 && iyEnd > _nyTexture) {
+    tbb::parallel_for(tbb::blocked_range<int>(_nyTexture, iyEnd),
+                      [&](const tbb::blocked_range<int>& r) {
+                        vector<double> sums(4 * nCenters);
+                        for (int iy = r.begin(); iy != r.end(); ++iy) {
+                          _computeRow(iy, minPtsForTexture, sums.data());
+                        }
+                      });
+  }
 
-    int icenter = _nxTexture + iy * _nx;
+  // fill in gaps in texture using closest non-missing point
 
-    for (int ix = _nxTexture; ix < _nx - _nxTexture; ix++, icenter++) {
+  _fillGaps();
+}
 
-      // compute texture in circular kernel around point
-      // first we compute the standard deviation of the square of dbz
-      // then we take the square root of the sdev
+// compute texture along one row.
+//
+// Each row of the circular kernel is a span, so its sums are
+// slid along the row, adding the point entering the span and
+// subtracting the one leaving. This is O(radius) per point,
+// rather than O(radius squared) for the whole kernel.
+//
+// sums: work space, 4 times the number of points in the row.
 
-      double nn = 0.0;
-      double sum = 0.0;
-      double sumSq = 0.0;
-      double sumSqSq = 0.0;
-
-      for (size_t ii = 0; ii < _kernel.size(); ii++) {
-        int kk = icenter + _kernel[ii].offset;
-        if (_dbzCount[kk] > 0) {
-          nn += _dbzCount[kk];
-          sum += _dbzSum[kk];
-          sumSq += _dbzSqSum[kk];
-          sumSqSq += _dbzSqSqSum[kk];
-        }
-      } // ii
-      if (nn >= minPtsForTexture) {
+void
+CartInterp::ComputeTexture::_computeRow(int iy,
+                                        int minPtsForTexture,
+                                        double* sums)
+{
 
-        double mean = sum / nn;
-        double var = sumSq / nn - (mean * mean);
-        if (var < 0.0) {
-          var = 0.0;
-        }
-        double sdev = sqrt(var);
-        _dbzTexture[icenter] = sdev;
+  int nCenters = _nx - 2 * _nxTexture;
+  double* nn = sums;
+  double* sum = nn + nCenters;
+  double* sumSq = sum + nCenters;
+  double* sumSqSq = sumSq + nCenters;
+  memset(sums, 0, 4 * nCenters * sizeof(double));
 
-        double meanSq = sumSq / nn;
-        double varSq = sumSqSq / nn - (meanSq * meanSq);
-        if (varSq < 0.0) {
-          varSq = 0.0;
-        }
-        double sdevSq = sqrt(varSq);
-        _dbzSqTexture[icenter] = sqrt(sdevSq);
+  for (int jdy = -_nyTexture; jdy <= _nyTexture; jdy++) {
+
+    int halfWidth = _halfWidths[jdy + _nyTexture];
+    if (halfWidth < 0) {
+      continue;
+    }
+
+    size_t rowStart = (size_t)(iy + jdy) * _nx;
+    const fl32* count = _dbzCount + rowStart;
+    const fl32* dbz = _dbzSum + rowStart;
+    const fl32* dbzSq = _dbzSqSum + rowStart;
+    const fl32* dbzSqSq = _dbzSqSqSum + rowStart;
+
+    // span for the first point
+
+    double spanNn = 0.0;
+    double spanSum = 0.0;
+    double spanSumSq = 0.0;
+    double spanSumSqSq = 0.0;
+    for (int ix = _nxTexture - halfWidth; ix <= _nxTexture + halfWidth;
+         ix++) {
+      spanNn += count[ix];
+      spanSum += dbz[ix];
+      spanSumSq += dbzSq[ix];
+      spanSumSqSq += dbzSqSq[ix];
+    }
+
+    // slide along the row
+
+    for (int ic = 0; ic < nCenters; ic++) {
+      nn[ic] += spanNn;
+      sum[ic] += spanSum;
+      sumSq[ic] += spanSumSq;
+      sumSqSq[ic] += spanSumSqSq;
+      if (ic < nCenters - 1) {
+        int in = _nxTexture + ic + 1 + halfWidth;
+        int out = _nxTexture + ic - halfWidth;
+        spanNn += count[in] - count[out];
+        spanSum += (double)dbz[in] - dbz[out];
+        spanSumSq += (double)dbzSq[in] - dbzSq[out];
+        spanSumSqSq += (double)dbzSqSq[in] - dbzSqSq[out];
       }
+    }
 
-    } // ix
+  } // jdy
 
-  } // iy
+  // first we compute the standard deviation of the square of dbz
+  // then we take the square root of the sdev
 
-  // fill in gaps in texture using closest non-missing point
+  int icenter = _nxTexture + iy * _nx;
+  for (int ic = 0; ic < nCenters; ic++, icenter++) {
 
-  for (int iy = _nyTexture; iy < _ny - _nyTexture; iy++) {
-    int icenter = _nxTexture + iy * _nx;
-    for (int ix = _nxTexture; ix < _nx - _nxTexture; ix++, icenter++) {
-      for (size_t ii = 0; ii < _kernel.size(); ii++) {
-        int kk = icenter + _kernel[ii].offset;
-        if (_dbzTexture[kk] != missingFl32) {
-          _filledTexture[icenter] = _dbzTexture[kk];
-          _filledSqTexture[icenter] = _dbzSqTexture[kk];
-          break;
+    if (nn[ic] >= minPtsForTexture) {
+
+      double mean = sum[ic] / nn[ic];
+      double var = sumSq[ic] / nn[ic] - (mean * mean);
+      if (var < 0.0) {
+        var = 0.0;
+      }
+      double sdev = sqrt(var);
+      _dbzTexture[icenter] = sdev;
+
+      double meanSq = sumSq[ic] / nn[ic];
+      double varSq = sumSqSq[ic] / nn[ic] - (meanSq * meanSq);
+      if (varSq < 0.0) {
+        varSq = 0.0;
+      }
+      double sdevSq = sqrt(varSq);
+      _dbzSqTexture[icenter] = sqrt(sdevSq);
+    }
+
+  } // ic
+}
+
+// fill in gaps in texture using the closest non-missing point
+// within the kernel radius.
+//
+// The closest point is found for the whole plane at once by an
+// exact euclidean distance transform (Felzenszwalb and
+// Huttenlocher), taken separably: first the closest point in
+// each row, then the lower envelope of the parabolas down each
+// column. This is O(1) per point, independent of the radius.
+
+void
+CartInterp::ComputeTexture::_fillGaps()
+{
+
+  if (_nx - 2 * _nxTexture <= 0 || _ny - 2 * _nyTexture <= 0) {
+    return;
+  }
+
+  // closest point with texture in each row, -1 if none
+
+  vector<int> closestX(_nx * _ny);
+  tbb::parallel_for(
+    tbb::blocked_range<int>(0, _ny),
+    [&](const tbb::blocked_range<int>& r) {
+      for (int iy = r.begin(); iy != r.end(); ++iy) {
+        const fl32* text = _dbzTexture + iy * _nx;
+        int* closest = &closestX[iy * _nx];
+        int last = -1;
+        for (int ix = 0; ix < _nx; ix++) {
+          if (text[ix] != missingFl32) {
+            last = ix;
+          }
+          closest[ix] = last;
+        }
+        last = -1;
+        for (int ix = _nx - 1; ix >= 0; ix--) {
+          if (text[ix] != missingFl32) {
+            last = ix;
+          }
+          if (last >= 0 &&
+              (closest[ix] < 0 || last - ix < ix - closest[ix])) {
+            closest[ix] = last;
+          }
         }
       }
-    } // ix
-  }   // iy
+    });
+
+  // down each column, the row whose closest point is closest overall
+
+  double dySq = _dyKm * _dyKm;
+  double dxSq = _dxKm * _dxKm;
+
+  tbb::parallel_for(
+    tbb::blocked_range<int>(_nxTexture, _nx - _nxTexture),
+    [&](const tbb::blocked_range<int>& r) {
+      vector<double> ff(_ny);
+      vector<int> vv(_ny);
+      vector<double> zz(_ny + 1);
+      for (int ix = r.begin(); ix != r.end(); ++ix) {
+
+        // lower envelope of the parabolas
+        //   ff[jy] + dySq * (iy - jy)^2
+        // for the rows with a closest point
+
+        int nEnv = 0;
+        for (int jy = 0; jy < _ny; jy++) {
+          int cx = closestX[jy * _nx + ix];
+          if (cx < 0) {
+            continue;
+          }
+          ff[jy] = dxSq * (cx - ix) * (cx - ix);
+          if (nEnv == 0) {
+            vv[0] = jy;
+            nEnv = 1;
+            continue;
+          }
+          double ss = _intersect(ff, vv[nEnv - 1], jy, dySq);
+          while (nEnv > 1 && ss <= zz[nEnv - 1]) {
+            nEnv--;
+            ss = _intersect(ff, vv[nEnv - 1], jy, dySq);
+          }
+          zz[nEnv] = ss;
+          vv[nEnv] = jy;
+          nEnv++;
+        }
+        if (nEnv == 0) {
+          continue;
+        }
+
+        // fill the gaps in this column
+
+        int kk = 0;
+        for (int iy = _nyTexture; iy < _ny - _nyTexture; iy++) {
+          while (kk < nEnv - 1 && zz[kk + 1] < iy) {
+            kk++;
+          }
+          int jy = vv[kk];
+          int jx = closestX[jy * _nx + ix];
+          double yy = (jy - iy) * _dyKm;
+          double xx = (jx - ix) * _dxKm;
+          if (sqrt(yy * yy + xx * xx) <= _radiusKm) {
+            int icenter = ix + iy * _nx;
+            int kcenter = jx + jy * _nx;
+            _filledTexture[icenter] = _dbzTexture[kcenter];
+            _filledSqTexture[icenter] = _dbzSqTexture[kcenter];
+          }
+        }
+
+      } // ix
+    });
+}
+
+// row at which the parabolas from rows ky and jy intersect
+
+double
+CartInterp::ComputeTexture::_intersect(const vector<double>& ff,
+                                       int ky,
+                                       int jy,
+                                       double dySq)
+{
+  return ((ff[jy] + dySq * jy * jy) - (ff[ky] + dySq * ky * ky)) /
+         (2.0 * dySq * (jy - ky));
 }
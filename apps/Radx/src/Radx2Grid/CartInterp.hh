@@ -37,7 +37,6 @@
 #define CartInterp_HH
 
 #include "Interp.hh"
-#include <toolsa/TaThread.hh>
 class DsMdvx;
 
 class CartInterp : public Interp {
@@ -112,6 +111,10 @@ private:
   public:
     int elIndex;
     int azIndex;
+    SearchIndex() {
+      elIndex = 0;
+      azIndex = 0;
+    }
     SearchIndex(int iel, int iaz) {
       elIndex = iel;
       azIndex = iaz;
@@ -141,10 +144,19 @@ private:
   double _searchRadiusAz;
   int _searchMaxDistAz;
 
-  CartThread _threadComputeLowerLeft;
-  CartThread _threadComputeUpperLeft;
-  CartThread _threadComputeLowerRight;
-  CartThread _threadComputeUpperRight;
+  // filled search matrix, cached for a scan strategy (VCP)
+
+  class SearchCache {
+  public:
+    int scanId;
+    int nEl, nAz;
+    int maxDistEl, maxDistAz, maxCount;
+    vector<int> seeds; // cells holding a ray before the fill
+    vector<int> source[4]; // for each quadrant, the seed each cell
+                           // was filled from, -1 if none
+  };
+
+  deque<SearchCache> _searchCache; // most recent first
 
   // class for neighboring points
 
@@ -212,6 +224,7 @@ private:
   } kernel_t;
 
   vector<kernel_t> _textureKernel;
+  vector<int> _textureKernelHalfWidths; // for each row, -ny to ny
   vector<kernel_t> _convKernel;
 
   // compute the lower and upper bounds of the vert levels for the texture computation,
@@ -254,23 +267,24 @@ private:
   void _printSearchMatrix(FILE *out, int res);
   void _printSearchMatrixPoint(FILE *out, int iel, int iaz);
 
-  static void *_computeSearchLowerLeft(void *thread_data);
-  static void *_computeSearchUpperLeft(void *thread_data);
-  static void *_computeSearchLowerRight(void *thread_data);
-  static void *_computeSearchUpperRight(void *thread_data);
-
-  int _fillSearchLowerLeft(int level,
-                           vector<SearchIndex> &thisSearch,
-                           vector<SearchIndex> &nextSearch);
-  int _fillSearchUpperLeft(int level,
-                           vector<SearchIndex> &thisSearch,
-                           vector<SearchIndex> &nextSearch);
-  int _fillSearchLowerRight(int level,
-                            vector<SearchIndex> &thisSearch,
-                            vector<SearchIndex> &nextSearch);
-  int _fillSearchUpperRight(int level,
-                            vector<SearchIndex> &thisSearch,
-                            vector<SearchIndex> &nextSearch);
+  void _getSearchSeeds(vector<int> &seeds);
+  void _fillSearchQuadrant(SearchPoint **matrix, int dEl, int dAz,
+                           const vector<int> &seeds);
+  void _propagateSearchLevel(SearchPoint **matrix, int dEl, int dAz,
+                             int level,
+                             const vector<SearchIndex> &thisSearch,
+                             vector<int> &rank,
+                             vector<SearchIndex> &nextSearch);
+  bool _canPropagate(const SearchPoint &sp, int iel, int iaz,
+                     int dEl, int dAz) const;
+  bool _reachedEarlier(SearchPoint **matrix, const vector<int> &rank,
+                       int level, int iel, int iaz, int dEl, int dAz,
+                       size_t thisRank) const;
+
+  const SearchCache *_findSearchCache(int scanId,
+                                      const vector<int> &seeds) const;
+  void _saveSearchCache(int scanId, const vector<int> &seeds);
+  void _applySearchCache(const SearchCache &cache);
   
   int _getSearchElIndex(double el);
   int _getSearchAzIndex(double az);
@@ -290,7 +304,7 @@ private:
   void _interpMultiThreaded();
   void _interpRow(int iz, int iy);
 
-  void _loadWtsFor2ValidRays(const GridLoc *loc,
+  void _loadWtsFor2ValidRays(const GridLoc &loc,
                              const SearchPoint &ll,
                              const SearchPoint &ul,
                              const SearchPoint &lr,
@@ -299,7 +313,7 @@ private:
                              double wtOuter, 
                              Neighbors &wts);
   
-  void _loadWtsFor3Or4ValidRays(const GridLoc *loc,
+  void _loadWtsFor3Or4ValidRays(const GridLoc &loc,
                                 const SearchPoint &ll,
                                 const SearchPoint &ul,
                                 const SearchPoint &lr,
@@ -357,20 +371,21 @@ private:
   void _convStratComputeKernels();
   void _convStratComputeVertLookups();
 
-  // inner class for starting timers in a separate thread
+  // inner class for computing texture at one level.
+  // The rows of the level are computed in parallel.
 
-  class ComputeTexture : public TaThread
+  class ComputeTexture
   {  
     
   public:   
     
-    // constructor saves _sd3c pointer
+    // constructor
     
     ComputeTexture(int iz);
     
     // destructor
     
-    virtual ~ComputeTexture();
+    ~ComputeTexture();
     
     // set parameters
     
@@ -386,9 +401,19 @@ private:
       _nyTexture = ny;
     }
     
-    void setKernel(const vector<kernel_t> &kernel)
+    // half width of the circular kernel in each row, from -ny to ny,
+    // -1 if the row is empty
+
+    void setKernelHalfWidths(const vector<int> &halfWidths)
     {
-      _kernel = kernel;
+      _halfWidths = halfWidths;
+    }
+    
+    void setKernelRadius(double radiusKm, double dxKm, double dyKm)
+    {
+      _radiusKm = radiusKm;
+      _dxKm = dxKm;
+      _dyKm = dyKm;
     }
     
     void setMinValidFraction(double val)
@@ -415,18 +440,19 @@ private:
       _filledSqTexture = filledSqTexture;
     }
     
-    // override run method
+    // compute the texture, and fill the gaps
     
-    virtual void run();
+    void run();
     
   private:
     
     int _iz;
     int _nx, _ny;
     int _nxTexture, _nyTexture;
+    double _radiusKm, _dxKm, _dyKm;
     double _minValidFraction;
 
-    vector<kernel_t> _kernel;
+    vector<int> _halfWidths;
     
     const fl32 *_dbzCount;
     const fl32 *_dbzSum;
@@ -439,6 +465,11 @@ private:
     fl32 *_filledTexture;
     fl32 *_filledSqTexture;
 
+    void _computeRow(int iy, int minPtsForTexture, double *sums);
+    void _fillGaps();
+    static double _intersect(const vector<double> &ff,
+                             int ky, int jy, double dySq);
+
   };
 
 };
@@ -0,0 +1,165 @@
+#ifndef RADX_RADX2GRID_FAST_TRANSFORM_H_
+#define RADX_RADX2GRID_FAST_TRANSFORM_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// dB <-> linear transforms for transform_fields, without calls to the
+// math library, so loops over them vectorize.
+//
+// log10 splits x into 2^e m, m in [sqrt(1/2), sqrt(2)), and sums the
+// atanh series for ln(m) to t^11. pow10 splits y log2(10) into an
+// integer n and f in [-1/2, 1/2], and takes 2^f by its Taylor series to
+// degree 10. Both are within MAX_DB_ERROR dB, and MAX_REL_ERROR
+// relative, of the library functions - far below the resolution of the
+// fl32 fields.
+//
+// log10 requires a positive, normal x. pow10 clamps y to the range of
+// normal doubles.
+
+class FastTransform
+{
+public:
+  static constexpr double MAX_DB_ERROR = 1.0e-9;
+  static constexpr double MAX_REL_ERROR = 1.0e-12;
+
+  static inline double log10(double x)
+  {
+    uint64_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+
+    // m in [1, 2), halved above sqrt(2) with e raised to match
+
+    uint64_t mBits = (bits & MANTISSA_MASK) | ONE_BITS;
+    const uint64_t high = int64_t(mBits) > int64_t(SQRT2_BITS) ? 1 : 0;
+    mBits -= high << 52;
+    double mm;
+    std::memcpy(&mm, &mBits, sizeof(mm));
+
+    // e, from the biased exponent placed in the mantissa of 2^52
+
+    const uint64_t eBits = ((bits >> 52) + high) | TWO_52_BITS;
+    double ee;
+    std::memcpy(&ee, &eBits, sizeof(ee));
+    ee -= TWO_52 + 1023.0;
+
+    // ln(m) = 2 atanh(t), |t| <= 0.172
+
+    const double tt = (mm - 1.0) / (mm + 1.0);
+    const double t2 = tt * tt;
+    const double series =
+      1.0 +
+      t2 * (1.0 / 3.0 +
+            t2 * (1.0 / 5.0 +
+                  t2 * (1.0 / 7.0 + t2 * (1.0 / 9.0 + t2 * (1.0 / 11.0)))));
+    return (ee * LN2 + 2.0 * tt * series) * LOG10_E;
+  }
+
+  static inline double pow10(double y)
+  {
+    // n = round(z), held in the low bits of z + 1.5 * 2^52
+
+    const double zz = y * LOG2_10;
+    const double shifted = zz + 1.5 * TWO_52;
+    const double nn = shifted - 1.5 * TWO_52;
+    uint64_t bits;
+    std::memcpy(&bits, &shifted, sizeof(bits));
+    int64_t expn = int64_t(bits & MANTISSA_MASK) - (int64_t(1) << 51);
+    expn = expn < -1022 ? -1022 : expn;
+    expn = expn > 1023 ? 1023 : expn;
+    const uint64_t scaleBits = uint64_t(expn + 1023) << 52;
+    double scale;
+    std::memcpy(&scale, &scaleBits, sizeof(scale));
+
+    // 2^f = e^g, |g| <= ln(2) / 2
+
+    const double gg = (zz - nn) * LN2;
+    double ex = 1.0 / 3628800.0;
+    ex = ex * gg + 1.0 / 362880.0;
+    ex = ex * gg + 1.0 / 40320.0;
+    ex = ex * gg + 1.0 / 5040.0;
+    ex = ex * gg + 1.0 / 720.0;
+    ex = ex * gg + 1.0 / 120.0;
+    ex = ex * gg + 1.0 / 24.0;
+    ex = ex * gg + 1.0 / 6.0;
+    ex = ex * gg + 0.5;
+    ex = ex * gg + 1.0;
+    ex = ex * gg + 1.0;
+    return ex * scale;
+  }
+
+  static inline double dbToLinear(double db) { return pow10(0.1 * db); }
+
+  // lin must be positive
+  static inline double linearToDb(double lin) { return 10.0 * log10(lin); }
+
+  // In place over an array, leaving missing values as they are.
+  // linearToDb sets values <= 0 to missing. The tests are made on
+  // the bits and the results merged by masks, as the compiler will
+  // not vectorize a floating point select or compare.
+
+  static void dbToLinear(float* data, size_t n, float missing)
+  {
+    const uint32_t missingBits = _floatBits(missing);
+#ifdef __GNUC__
+#pragma GCC ivdep
+#else
+#pragma ivdep
+#endif
+    for (size_t ii = 0; ii < n; ii++) {
+      const float val = data[ii];
+      const uint32_t keep = _mask(_floatBits(val) == missingBits);
+      const uint32_t linBits = _floatBits(float(dbToLinear(val)));
+      data[ii] = _bitsFloat((linBits & ~keep) | (missingBits & keep));
+    }
+  }
+
+  static void linearToDb(float* data, size_t n, float missing)
+  {
+    const uint32_t missingBits = _floatBits(missing);
+#ifdef __GNUC__
+#pragma GCC ivdep
+#else
+#pragma ivdep
+#endif
+    for (size_t ii = 0; ii < n; ii++) {
+      const uint32_t valBits = _floatBits(data[ii]);
+      const uint32_t valid =
+        _mask(int32_t(valBits) > 0) & ~_mask(valBits == missingBits);
+      const float arg = _bitsFloat((valBits & valid) | (ONE_F_BITS & ~valid));
+      const uint32_t dbBits = _floatBits(float(linearToDb(arg)));
+      data[ii] = _bitsFloat((dbBits & valid) | (missingBits & ~valid));
+    }
+  }
+
+private:
+  static constexpr double LN2 = 0.69314718055994530942;
+  static constexpr double LOG10_E = 0.43429448190325182765;
+  static constexpr double LOG2_10 = 3.32192809488736234787;
+  static constexpr double TWO_52 = 4503599627370496.0;
+  static constexpr uint64_t MANTISSA_MASK = 0x000fffffffffffffULL;
+  static constexpr uint64_t ONE_BITS = 0x3ff0000000000000ULL;
+  static constexpr uint64_t SQRT2_BITS = 0x3ff6a09e667f3bcdULL;
+  static constexpr uint64_t TWO_52_BITS = 0x4330000000000000ULL;
+  static constexpr uint32_t ONE_F_BITS = 0x3f800000U;
+
+  static inline uint32_t _floatBits(float val)
+  {
+    uint32_t bits;
+    std::memcpy(&bits, &val, sizeof(bits));
+    return bits;
+  }
+
+  static inline float _bitsFloat(uint32_t bits)
+  {
+    float val;
+    std::memcpy(&val, &bits, sizeof(val));
+    return val;
+  }
+
+  // all ones if cond
+  static inline uint32_t _mask(bool cond) { return 0U - uint32_t(cond); }
+};
+
+#endif // RADX_RADX2GRID_FAST_TRANSFORM_H_
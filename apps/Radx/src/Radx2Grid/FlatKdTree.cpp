@@ -0,0 +1,147 @@
+#include "FlatKdTree.hh"
+#include <algorithm>
+#include <limits>
+#include <tbb/parallel_invoke.h>
+
+FlatKdTree::FlatKdTree()
+  : _depth(0)
+{
+}
+
+void
+FlatKdTree::clear()
+{
+  SpatialIndex::clear();
+  _depth = 0;
+  _nodes.clear();
+}
+
+void
+FlatKdTree::build(const double* coords, size_t nPoints)
+{
+  clear();
+  if (nPoints == 0) {
+    return;
+  }
+
+  // deep enough for every leaf to hold at most LEAF_SIZE points
+
+  while (((nPoints + (size_t(1) << _depth) - 1) >> _depth) >
+         size_t(LEAF_SIZE)) {
+    _depth++;
+  }
+  _nodes.resize((size_t(1) << (_depth + 1)) - 1);
+
+  std::vector<int> perm(nPoints);
+  for (size_t ii = 0; ii < nPoints; ii++) {
+    perm[ii] = int(ii);
+  }
+  _buildNode(0, 0, 0, int(nPoints), coords, perm);
+
+  _copyPoints(coords, perm);
+}
+
+void
+FlatKdTree::_buildNode(int node, int depth, int begin, int end,
+                       const double* coords, std::vector<int>& perm)
+{
+  Node& nd = _nodes[node];
+  nd.begin = begin;
+  nd.end = end;
+  if (depth == _depth) {
+    nd.dim = -1;
+    nd.split = 0.0;
+    return;
+  }
+
+  // split the widest dimension at the median
+
+  double lo[DIM], hi[DIM];
+  for (int dd = 0; dd < DIM; dd++) {
+    lo[dd] = std::numeric_limits<double>::max();
+    hi[dd] = -std::numeric_limits<double>::max();
+  }
+  for (int ii = begin; ii < end; ii++) {
+    const double* pt = coords + size_t(perm[ii]) * DIM;
+    for (int dd = 0; dd < DIM; dd++) {
+      lo[dd] = std::min(lo[dd], pt[dd]);
+      hi[dd] = std::max(hi[dd], pt[dd]);
+    }
+  }
+  int dim = 0;
+  for (int dd = 1; dd < DIM; dd++) {
+    if (hi[dd] - lo[dd] > hi[dim] - lo[dim]) {
+      dim = dd;
+    }
+  }
+
+  const int mid = begin + (end - begin) / 2;
+  std::nth_element(perm.begin() + begin, perm.begin() + mid,
+                   perm.begin() + end, [coords, dim](int a, int b) {
+                     return coords[size_t(a) * DIM + dim] <
+                            coords[size_t(b) * DIM + dim];
+                   });
+  nd.dim = dim;
+  nd.split = coords[size_t(perm[mid]) * DIM + dim];
+
+  // points in [begin, mid) are <= split, in [mid, end) >= split.
+  // The children partition disjoint ranges of perm into disjoint heap
+  // slots, so large ones are built in parallel.
+
+  if (end - begin >= PARALLEL_BUILD_SIZE) {
+    tbb::parallel_invoke(
+      [&] { _buildNode(2 * node + 1, depth + 1, begin, mid, coords, perm); },
+      [&] { _buildNode(2 * node + 2, depth + 1, mid, end, coords, perm); });
+  } else {
+    _buildNode(2 * node + 1, depth + 1, begin, mid, coords, perm);
+    _buildNode(2 * node + 2, depth + 1, mid, end, coords, perm);
+  }
+}
+
+int
+FlatKdTree::_search(const double* q, int k, double maxDistSq, int* pos,
+                    double* distSq, int nFound) const
+{
+  struct Entry
+  {
+    int node;
+    double minDistSq;
+  };
+  Entry stack[64];
+  int top = 0;
+  stack[top++] = { 0, 0.0 };
+
+  while (top > 0) {
+    const Entry entry = stack[--top];
+    double bound = nFound == k ? distSq[k - 1] : maxDistSq;
+    if (entry.minDistSq > bound) {
+      continue;
+    }
+    const Node& nd = _nodes[entry.node];
+
+    if (nd.dim < 0) {
+      for (int ii = nd.begin; ii < nd.end; ii++) {
+        const double d = _distSq(q, &_coords[size_t(ii) * DIM]);
+        if (d <= bound && (nFound < k || d < distSq[k - 1])) {
+          nFound = _insert(k, ii, d, pos, distSq, nFound);
+          bound = nFound == k ? distSq[k - 1] : maxDistSq;
+        }
+      }
+      continue;
+    }
+
+    // nearer child last, so it is searched first
+
+    const double diff = q[nd.dim] - nd.split;
+    const int left = 2 * entry.node + 1;
+    const double farDistSq = std::max(entry.minDistSq, diff * diff);
+    if (diff < 0) {
+      stack[top++] = { left + 1, farDistSq };
+      stack[top++] = { left, entry.minDistSq };
+    } else {
+      stack[top++] = { left, farDistSq };
+      stack[top++] = { left + 1, entry.minDistSq };
+    }
+  }
+  return nFound;
+}
@@ -0,0 +1,44 @@
+#ifndef RADX_RADX2GRID_FLAT_KD_TREE_H_
+#define RADX_RADX2GRID_FLAT_KD_TREE_H_
+
+#include "SpatialIndex.hh"
+
+// Read-only 3D KD-tree in flat arrays.
+//
+// The tree is split at the median of the widest dimension down to leaves
+// of at most LEAF_SIZE points, so its shape depends only on the number of
+// points and the nodes are stored as an implicit binary heap. Points are
+// copied in tree order, each leaf contiguous. Subtrees are built in
+// parallel down to PARALLEL_BUILD_SIZE points.
+
+class FlatKdTree : public SpatialIndex
+{
+public:
+  static const int LEAF_SIZE = 8;
+  static const int PARALLEL_BUILD_SIZE = 16384;
+
+  FlatKdTree();
+
+  void build(const double* coords, size_t nPoints) override;
+  void clear() override;
+
+protected:
+  int _search(const double* q, int k, double maxDistSq, int* pos,
+              double* distSq, int nFound) const override;
+
+private:
+  struct Node
+  {
+    double split;
+    int dim; // -1 for a leaf
+    int begin, end;
+  };
+
+  int _depth;
+  std::vector<Node> _nodes;
+
+  void _buildNode(int node, int depth, int begin, int end,
+                  const double* coords, std::vector<int>& perm);
+};
+
+#endif // RADX_RADX2GRID_FLAT_KD_TREE_H_
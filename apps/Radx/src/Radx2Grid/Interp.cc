@@ -75,6 +75,7 @@ Interp::Interp(const string &progName,
   _rhiMode = false;
 
   gettimeofday(&_timeA, NULL);
+  _perfA = PerfCounters::read();
   
   _radarLat = 0.0;
   _radarLon = 0.0;
@@ -103,6 +104,10 @@ Interp::Interp(const string &progName,
 
   _outputFields= NULL;
 
+  _prevGridGeomValid = false;
+  _nGridGeomChecks = 0;
+  _nGridGeomReused = 0;
+
 }
 
 //////////////////////////////////////
@@ -194,6 +199,52 @@ void Interp::_initProjection()
         
 }
 
+////////////////////////////////////////////////////////////
+// Check if the radar location or grid has changed since the
+// grid-relative locations were last computed
+
+bool Interp::_gridGeomHasChanged(bool radarRelative /* = true */)
+
+{
+
+  _nGridGeomChecks++;
+
+  GridGeom &prev = _prevGridGeom;
+  bool radarMoved = radarRelative &&
+    (fabs(prev.radarLat - _radarLat) >= 0.00001 ||
+     fabs(prev.radarLon - _radarLon) >= 0.00001 ||
+     fabs(prev.radarAltKm - _radarAltKm) >= 0.00001);
+  if (_prevGridGeomValid && !radarMoved &&
+      prev.nx == _gridNx && prev.ny == _gridNy && prev.nz == _gridNz &&
+      prev.minx == _gridMinx && prev.miny == _gridMiny &&
+      prev.dx == _gridDx && prev.dy == _gridDy &&
+      prev.zLevels == _gridZLevels) {
+    _nGridGeomReused++;
+    if (_params.debug) {
+      cerr << "  Radar and grid unchanged, reusing grid locations, "
+           << _nGridGeomReused << " of " << _nGridGeomChecks
+           << " volumes" << endl;
+    }
+    return false;
+  }
+
+  prev.radarLat = _radarLat;
+  prev.radarLon = _radarLon;
+  prev.radarAltKm = _radarAltKm;
+  prev.nx = _gridNx;
+  prev.ny = _gridNy;
+  prev.nz = _gridNz;
+  prev.minx = _gridMinx;
+  prev.miny = _gridMiny;
+  prev.dx = _gridDx;
+  prev.dy = _gridDy;
+  prev.zLevels = _gridZLevels;
+  _prevGridGeomValid = true;
+
+  return true;
+
+}
+
 //////////////////////////////////////////////////
 // accumulate data for a pt using nearest neighbor
 // this is for cart and ppi interpolation
@@ -884,6 +935,8 @@ void Interp::_computeElevationDelta()
 }
 
 // Print the elapsed run time since the previous call, in seconds.
+// If collect_perf_counters is set, also print the hardware counts
+// over the same interval.
 
 void Interp::_printRunTime(const string& str, bool verbose /* = false */)
 {
@@ -891,16 +944,24 @@ void Interp::_printRunTime(const string& str, bool verbose /* = false */)
     if (_params.debug < Params::DEBUG_VERBOSE) {
       return;
     }
-  } else if (!_params.debug) {
+  } else if (!_params.debug && !PerfCounters::isEnabled()) {
     return;
   }
-  struct timeval tvb;
-  gettimeofday(&tvb, NULL);
-  double deltaSec = tvb.tv_sec - _timeA.tv_sec
-    + 1.e-6 * (tvb.tv_usec - _timeA.tv_usec);
-  cerr << "TIMING, task: " << str << ", secs used: " << deltaSec << endl;
-  _timeA.tv_sec = tvb.tv_sec;
-  _timeA.tv_usec = tvb.tv_usec;
+  if (_params.debug) {
+    struct timeval tvb;
+    gettimeofday(&tvb, NULL);
+    double deltaSec = tvb.tv_sec - _timeA.tv_sec
+      + 1.e-6 * (tvb.tv_usec - _timeA.tv_usec);
+    cerr << "TIMING, task: " << str << ", secs used: " << deltaSec << endl;
+    _timeA.tv_sec = tvb.tv_sec;
+    _timeA.tv_usec = tvb.tv_usec;
+  }
+  if (PerfCounters::isEnabled()) {
+    PerfCounters::Sample perfB = PerfCounters::read();
+    cerr << "PERF, task: " << str << ", "
+         << PerfCounters::format(perfB - _perfA) << endl;
+    _perfA = perfB;
+  }
 }
 
 /////////////////////////////////////////////////////
@@ -1049,66 +1110,6 @@ int Interp::_writeCedricFile(bool isPpi)
 
 }
 
-//////////////////////////////////////////////////////////////////
-// transform fields back as required for output
-
-void Interp::_transformForOutput()
-
-{
-
-  if (!_params.transform_fields_for_interpolation) {
-    return;
-  }
-
-  // loop through interp fields
-  
-  for (size_t ifield = 0; ifield < _interpFields.size(); ifield++) {
-    
-    Field &ifld = _interpFields[ifield];
-    string &radxName = ifld.radxName;
-    
-    // loop through transform fields
-    
-    for (int jfield = 0; jfield < _params.transform_fields_n; jfield++) {
-
-      const Params::transform_field_t &transform = _params._transform_fields[jfield];
-      string transName = transform.output_name;
-      if (radxName == transName) {
-        
-        if (transform.transform == Params::TRANSFORM_DB_TO_LINEAR_AND_BACK) {
-          
-          fl32 *data = _outputFields[ifield];
-          for (int ipt = 0; ipt < _nPointsVol; ipt++) {
-            fl32 val = data[ipt];
-            if (val != Interp::missingFl32) {
-              if (val <= 0.0) {
-                data[ipt] = Interp::missingFl32;
-              } else {
-                data[ipt] = 10.0 * log10(val);
-              }
-            }
-          } // ipt
-          
-        } else if (transform.transform == Params::TRANSFORM_LINEAR_TO_DB_AND_BACK) {
-          
-          fl32 *data = _outputFields[ifield];
-          for (int ipt = 0; ipt < _nPointsVol; ipt++) {
-            fl32 val = data[ipt];
-            if (val != Interp::missingFl32) {
-              data[ipt] = pow(10.0, val / 10.0);
-            }
-          } // ipt
-        
-        } // if (transform.transform == Params::TRANSFORM_DB_TO_LINEAR_AND_BACK)
-
-      } // if (outputName == transName)
-
-    } // jfield
-
-  } // ifield
-
-}
-
 /////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////
 ///////////////////////////
@@ -1187,3 +1188,37 @@ Interp::Ray::~Ray()
   delete[] missingVal;
 }
 
+Interp::GridLocArray::GridLocArray() :
+        el(NULL), az(NULL), slantRange(NULL), gndRange(NULL),
+        xxInstr(NULL), yyInstr(NULL), zzInstr(NULL), zz(NULL),
+        _nz(0), _ny(0), _nx(0)
+{
+}
+
+void Interp::GridLocArray::alloc(int nz, int ny, int nx)
+{
+  _nz = nz;
+  _ny = ny;
+  _nx = nx;
+  size_t nPts = (size_t) nz * ny * nx;
+  _data.assign(nPts * 8, 0.0);
+  double *next = _data.data();
+  el = next; next += nPts;
+  az = next; next += nPts;
+  slantRange = next; next += nPts;
+  gndRange = next; next += nPts;
+  xxInstr = next; next += nPts;
+  yyInstr = next; next += nPts;
+  zzInstr = next; next += nPts;
+  zz = next;
+}
+
+void Interp::GridLocArray::clear()
+{
+  _data.clear();
+  _data.shrink_to_fit();
+  el = az = slantRange = gndRange = NULL;
+  xxInstr = yyInstr = zzInstr = zz = NULL;
+  _nz = _ny = _nx = 0;
+}
+
@@ -35,11 +35,14 @@
 #ifndef Interp_HH
 #define Interp_HH
 
+#include "FastTransform.hh"
 #include "Params.hh"
+#include "PerfCounters.hh"
 #include "Thread.hh"
 #include <string>
 #include <cmath>
 #include <deque>
+#include <vector>
 #include <Mdv/MdvxProj.hh>
 #include <Radx/Radx.hh>
 #include <radar/BeamHeight.hh>
@@ -71,6 +74,8 @@ public:
     Radx::DataType_t inputDataType;
     double inputScale;
     double inputOffset;
+    bool toDbForOutput;     // transformed back from linear after interp
+    bool toLinearForOutput; // transformed back from dB after interp
     Field() {
       fieldFolds = false;
       isDiscrete = false;
@@ -80,6 +85,8 @@ public:
       inputDataType = Radx::FL32;
       inputScale = 1.0;
       inputOffset = 0.0;
+      toDbForOutput = false;
+      toLinearForOutput = false;
     }
   };
 
@@ -120,7 +127,47 @@ public:
     double gndRange;
     double xxInstr, yyInstr, zzInstr, zz;
   };
-  GridLoc ****_gridLoc;
+
+  // grid locations for the whole grid, as a structure of arrays
+  // in a single allocation - kept from volume to volume while the
+  // radar and grid do not change
+
+  class GridLocArray {
+  public:
+    GridLocArray();
+    void alloc(int nz, int ny, int nx);
+    void clear();
+    bool isAllocated() const { return !_data.empty(); }
+    inline size_t index(int iz, int iy, int ix) const {
+      return ((size_t) iz * _ny + iy) * _nx + ix;
+    }
+    inline GridLoc get(size_t ii) const {
+      GridLoc loc;
+      loc.el = el[ii];
+      loc.az = az[ii];
+      loc.slantRange = slantRange[ii];
+      loc.gndRange = gndRange[ii];
+      loc.xxInstr = xxInstr[ii];
+      loc.yyInstr = yyInstr[ii];
+      loc.zzInstr = zzInstr[ii];
+      loc.zz = zz[ii];
+      return loc;
+    }
+    inline GridLoc get(int iz, int iy, int ix) const {
+      return get(index(iz, iy, ix));
+    }
+    double *el;
+    double *az;
+    double *slantRange;
+    double *gndRange;
+    double *xxInstr, *yyInstr, *zzInstr, *zz;
+  private:
+    GridLocArray(const GridLocArray &);
+    GridLocArray &operator=(const GridLocArray &);
+    vector<double> _data;
+    int _nz, _ny, _nx;
+  };
+  GridLocArray _gridLocs;
 
   // constructor
   
@@ -159,6 +206,7 @@ protected:
   // checking timing performance
 
   struct timeval _timeA;
+  PerfCounters::Sample _perfA;
 
   // radar location
   
@@ -271,10 +319,40 @@ protected:
   double _radarX, _radarY;
   fl32 **_outputFields;
 
+  // radar location and grid for which the grid-relative locations
+  // were last computed, and counts of the checks and of the volumes
+  // for which they were reused
+
+  class GridGeom {
+  public:
+    GridGeom() {
+      radarLat = radarLon = radarAltKm = 0.0;
+      nx = ny = nz = 0;
+      minx = miny = dx = dy = 0.0;
+    }
+    double radarLat, radarLon, radarAltKm;
+    int nx, ny, nz;
+    double minx, miny, dx, dy;
+    vector<double> zLevels;
+  };
+  GridGeom _prevGridGeom;
+  bool _prevGridGeomValid;
+  int _nGridGeomChecks;
+  int _nGridGeomReused;
+
   // protected methods
 
   virtual void _initProjection();
 
+  // returns true if the radar location or grid has changed since the
+  // previous call, or since _resetGridGeom(), and saves the current
+  // ones - false means the grid-relative locations may be reused.
+  // The radar location is ignored if the locations are not relative
+  // to the radar.
+
+  bool _gridGeomHasChanged(bool radarRelative = true);
+  void _resetGridGeom() { _prevGridGeomValid = false; }
+
   void _accumNearest(const Ray *ray,
                      int ifield,
                      int igateInner,
@@ -350,7 +428,24 @@ protected:
 
   int _writeCedricFile(bool isPpi);
 
-  void _transformForOutput();
+  // value stored in an output field, transformed back as required
+  // for output
+
+  inline fl32 _outputVal(const Field &fld, double val) const {
+    if ((fl32) val == missingFl32) {
+      return missingFl32;
+    }
+    if (fld.toDbForOutput) {
+      if (val <= 0.0) {
+        return missingFl32;
+      }
+      return FastTransform::linearToDb(val);
+    }
+    if (fld.toLinearForOutput) {
+      return FastTransform::dbToLinear(val);
+    }
+    return val;
+  }
 
 private:
 
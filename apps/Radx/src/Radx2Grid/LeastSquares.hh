@@ -0,0 +1,222 @@
+#ifndef RADX_RADX2GRID_LEAST_SQUARES_H_
+#define RADX_RADX2GRID_LEAST_SQUARES_H_
+
+#include <algorithm>
+#include <cmath>
+
+// Linear least squares for N unknowns, in fixed-size arrays, with no heap
+// allocation.
+//
+// Rows of the design matrix A are added one at a time to the normal
+// matrix AtA, which factor() decomposes once. solve() then gives the
+// fit for any number of right-hand sides, each passed as Atb. AtA is
+// factored by Cholesky while well conditioned - smallest pivot at least
+// COND_TOL of the largest diagonal, about a condition number of 1e6 for
+// A. Otherwise, for points that are coplanar or nearly so, the solution
+// is the minimum-norm one from the eigen-decomposition of AtA, which
+// drops the directions A does not resolve, as an SVD of A would.
+// getFactor() gives the factored form alone, without AtA, for keeping.
+
+template <int N>
+class LeastSquares
+{
+public:
+  static constexpr double COND_TOL = 1.0e-12;
+
+  // Cholesky factor L, lower triangle, and 1 / diagonal of L, or the
+  // pseudo-inverse of AtA
+  struct Factor
+  {
+    bool cholesky;
+    double factor[N][N];
+    double invDiag[N];
+
+    // x = the least-squares solution for Atb
+    void solve(const double* atb, double* x) const
+    {
+      if (cholesky) {
+        double yy[N];
+        for (int ii = 0; ii < N; ii++) {
+          double sum = atb[ii];
+          for (int kk = 0; kk < ii; kk++) {
+            sum -= factor[ii][kk] * yy[kk];
+          }
+          yy[ii] = sum * invDiag[ii];
+        }
+        for (int ii = N - 1; ii >= 0; ii--) {
+          double sum = yy[ii];
+          for (int kk = ii + 1; kk < N; kk++) {
+            sum -= factor[kk][ii] * x[kk];
+          }
+          x[ii] = sum * invDiag[ii];
+        }
+      } else {
+        for (int ii = 0; ii < N; ii++) {
+          double sum = 0.0;
+          for (int jj = 0; jj < N; jj++) {
+            sum += factor[ii][jj] * atb[jj];
+          }
+          x[ii] = sum;
+        }
+      }
+    }
+  };
+
+  LeastSquares() { reset(); }
+
+  void reset()
+  {
+    for (int ii = 0; ii < N; ii++) {
+      for (int jj = 0; jj < N; jj++) {
+        _ata[ii][jj] = 0.0;
+      }
+    }
+    _nRows = 0;
+    _f.cholesky = false;
+  }
+
+  // AtA += a a', lower triangle
+  inline void addRow(const double* a)
+  {
+    for (int ii = 0; ii < N; ii++) {
+      for (int jj = 0; jj <= ii; jj++) {
+        _ata[ii][jj] += a[ii] * a[jj];
+      }
+    }
+    _nRows++;
+  }
+
+  // Atb += a b
+  static inline void addRhs(const double* a, double b, double* atb)
+  {
+    for (int ii = 0; ii < N; ii++) {
+      atb[ii] += a[ii] * b;
+    }
+  }
+
+  // Factor AtA. Returns false if there are no rows, or A is all zero.
+  bool factor()
+  {
+    double maxDiag = 0.0;
+    for (int ii = 0; ii < N; ii++) {
+      maxDiag = std::max(maxDiag, _ata[ii][ii]);
+    }
+    if (_nRows == 0 || maxDiag <= 0.0) {
+      return false;
+    }
+    _f.cholesky = _factorCholesky(COND_TOL * maxDiag);
+    if (!_f.cholesky) {
+      _factorEigen(COND_TOL * maxDiag);
+    }
+    return true;
+  }
+
+  // true if factored by Cholesky, false if by the pseudo-inverse
+  inline bool isWellConditioned() const { return _f.cholesky; }
+
+  // valid after factor()
+  inline const Factor& getFactor() const { return _f; }
+
+  // x = the least-squares solution for Atb
+  inline void solve(const double* atb, double* x) const { _f.solve(atb, x); }
+
+private:
+  double _ata[N][N];
+  int _nRows;
+  Factor _f;
+
+  // AtA = L L'; false if a pivot falls below minPivot
+  bool _factorCholesky(double minPivot)
+  {
+    for (int jj = 0; jj < N; jj++) {
+      double diag = _ata[jj][jj];
+      for (int kk = 0; kk < jj; kk++) {
+        diag -= _f.factor[jj][kk] * _f.factor[jj][kk];
+      }
+      if (diag <= minPivot) {
+        return false;
+      }
+      _f.factor[jj][jj] = sqrt(diag);
+      _f.invDiag[jj] = 1.0 / _f.factor[jj][jj];
+      for (int ii = jj + 1; ii < N; ii++) {
+        double sum = _ata[ii][jj];
+        for (int kk = 0; kk < jj; kk++) {
+          sum -= _f.factor[ii][kk] * _f.factor[jj][kk];
+        }
+        _f.factor[ii][jj] = sum * _f.invDiag[jj];
+      }
+    }
+    return true;
+  }
+
+  // pseudo-inverse of AtA by cyclic Jacobi rotations, dropping
+  // eigenvalues at or below minEigen
+  void _factorEigen(double minEigen)
+  {
+    double aa[N][N], vv[N][N];
+    for (int ii = 0; ii < N; ii++) {
+      for (int jj = 0; jj < N; jj++) {
+        aa[ii][jj] = ii >= jj ? _ata[ii][jj] : _ata[jj][ii];
+        vv[ii][jj] = ii == jj ? 1.0 : 0.0;
+      }
+    }
+
+    for (int sweep = 0; sweep < 50; sweep++) {
+      double offDiag = 0.0;
+      for (int pp = 0; pp < N; pp++) {
+        for (int qq = pp + 1; qq < N; qq++) {
+          offDiag += aa[pp][qq] * aa[pp][qq];
+        }
+      }
+      if (offDiag == 0.0) {
+        break;
+      }
+      for (int pp = 0; pp < N; pp++) {
+        for (int qq = pp + 1; qq < N; qq++) {
+          if (aa[pp][qq] == 0.0) {
+            continue;
+          }
+          const double theta = (aa[qq][qq] - aa[pp][pp]) / (2.0 * aa[pp][qq]);
+          const double tt = (theta >= 0.0 ? 1.0 : -1.0) /
+                            (fabs(theta) + sqrt(theta * theta + 1.0));
+          const double cc = 1.0 / sqrt(tt * tt + 1.0);
+          const double ss = tt * cc;
+          for (int kk = 0; kk < N; kk++) {
+            const double akp = aa[kk][pp];
+            const double akq = aa[kk][qq];
+            aa[kk][pp] = cc * akp - ss * akq;
+            aa[kk][qq] = ss * akp + cc * akq;
+          }
+          for (int kk = 0; kk < N; kk++) {
+            const double apk = aa[pp][kk];
+            const double aqk = aa[qq][kk];
+            aa[pp][kk] = cc * apk - ss * aqk;
+            aa[qq][kk] = ss * apk + cc * aqk;
+          }
+          for (int kk = 0; kk < N; kk++) {
+            const double vkp = vv[kk][pp];
+            const double vkq = vv[kk][qq];
+            vv[kk][pp] = cc * vkp - ss * vkq;
+            vv[kk][qq] = ss * vkp + cc * vkq;
+          }
+        }
+      }
+    }
+
+    double invEigen[N];
+    for (int kk = 0; kk < N; kk++) {
+      invEigen[kk] = aa[kk][kk] > minEigen ? 1.0 / aa[kk][kk] : 0.0;
+    }
+    for (int ii = 0; ii < N; ii++) {
+      for (int jj = 0; jj < N; jj++) {
+        double sum = 0.0;
+        for (int kk = 0; kk < N; kk++) {
+          sum += vv[ii][kk] * invEigen[kk] * vv[jj][kk];
+        }
+        _f.factor[ii][jj] = sum;
+      }
+    }
+  }
+};
+
+#endif // RADX_RADX2GRID_LEAST_SQUARES_H_
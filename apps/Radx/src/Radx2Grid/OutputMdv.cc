@@ -236,10 +236,15 @@ void OutputMdv::addField(const RadxVol &vol,
 
   MdvxField *fld = new MdvxField(fhdr, vhdr, data);
   if (_params.output_format == Params::MDV) {
-    if (inputDataType == Radx::SI08 ||
-        inputDataType == Radx::UI08 ||
-        inputDataType == Radx::SI16 ||
-        inputDataType == Radx::UI16) {
+    if (_params.output_packing == Params::PACKING_INT8) {
+      fld->convertType(Mdvx::ENCODING_INT8,
+                       Mdvx::COMPRESSION_GZIP,
+                       Mdvx::SCALING_DYNAMIC);
+    } else if (_params.output_packing == Params::PACKING_INT16 ||
+               inputDataType == Radx::SI08 ||
+               inputDataType == Radx::UI08 ||
+               inputDataType == Radx::SI16 ||
+               inputDataType == Radx::UI16) {
       fld->convertType(Mdvx::ENCODING_INT16,
                        Mdvx::COMPRESSION_GZIP,
                        Mdvx::SCALING_DYNAMIC);
@@ -247,6 +252,16 @@ void OutputMdv::addField(const RadxVol &vol,
       fld->convertType(Mdvx::ENCODING_FLOAT32,
                        Mdvx::COMPRESSION_GZIP);
     }
+  } else if (_params.output_packing == Params::PACKING_INT8) {
+    // the CF translation writes packed fields as byte/short with
+    // scale_factor and add_offset
+    fld->convertType(Mdvx::ENCODING_INT8,
+                     Mdvx::COMPRESSION_NONE,
+                     Mdvx::SCALING_DYNAMIC);
+  } else if (_params.output_packing == Params::PACKING_INT16) {
+    fld->convertType(Mdvx::ENCODING_INT16,
+                     Mdvx::COMPRESSION_NONE,
+                     Mdvx::SCALING_DYNAMIC);
   }
   
   // if (_params.output_format == Params::ZEBRA_NETCDF) {
@@ -2821,10 +2821,10 @@ using namespace std;
     tt->ptype = ENUM_TYPE;
     tt->param_name = tdrpStrDup("output_format");
     tt->descr = tdrpStrDup("Set the output format");
-    tt->help = tdrpStrDup("CF_NETCDF: CF-compliant NetCDF. See http://cf-pcmdi.llnl.gov/documents/cf-conventions. ZEBRA_NETCDF: NetCDF format specifically for ZEBRA display. This forces a conversion to a LATLON projection. MDV: legacy MDV format.");
+    tt->help = tdrpStrDup("CF_NETCDF: CF-compliant NetCDF. See http://cf-pcmdi.llnl.gov/documents/cf-conventions. ZEBRA_NETCDF: NetCDF format specifically for ZEBRA display. This forces a conversion to a LATLON projection. MDV: legacy MDV format. RASTER: GeoTIFF, INTERP_MODE_CART_MAP only - see RASTER OUTPUT. ZARR: Zarr v2 directory store of independently compressed chunks, INTERP_MODE_CART_MAP only - see ZARR OUTPUT.");
     tt->val_offset = (char *) &output_format - &_start_;
     tt->enum_def.name = tdrpStrDup("output_format_t");
-    tt->enum_def.nfields = 5;
+    tt->enum_def.nfields = 6;
     tt->enum_def.fields = (enum_field_t *)
         tdrpMalloc(tt->enum_def.nfields * sizeof(enum_field_t));
       tt->enum_def.fields[0].name = tdrpStrDup("CF_NETCDF");
@@ -2837,6 +2837,8 @@ using namespace std;
       tt->enum_def.fields[3].val = CEDRIC;
       tt->enum_def.fields[4].name = tdrpStrDup("RASTER");
       tt->enum_def.fields[4].val = RASTER;
+      tt->enum_def.fields[5].name = tdrpStrDup("ZARR");
+      tt->enum_def.fields[5].val = ZARR;
     tt->single_val.e = CF_NETCDF;
     tt++;
     
@@ -3075,6 +3077,705 @@ using namespace std;
     tt->single_val.s = tdrpStrDup("");
     tt++;
     
+    // Parameter 'Comment 34'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = COMMENT_TYPE;
+    tt->param_name = tdrpStrDup("Comment 34");
+    tt->comment_hdr = tdrpStrDup("RADX2GRIDPLUS PERFORMANCE TRACING");
+    tt->comment_text = tdrpStrDup("Applies only to INTERP_MODE_CART_MAP.");
+    tt++;
+    
+    // Parameter 'write_trace_events'
+    // ctype is 'tdrp_bool_t'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = BOOL_TYPE;
+    tt->param_name = tdrpStrDup("write_trace_events");
+    tt->descr = tdrpStrDup("Option to record a timeline of the processing pipeline.");
+    tt->help = tdrpStrDup("If true, begin/end spans are recorded for each pipeline stage, per volume and per thread, including time spent waiting on the inter-stage queues. Contended acquisitions of the grid accumulation locks are recorded as a counter. The timeline is written in the Chrome/Perfetto trace-event JSON format, and can be opened in chrome://tracing or https://ui.perfetto.dev.");
+    tt->val_offset = (char *) &write_trace_events - &_start_;
+    tt->single_val.b = pFALSE;
+    tt++;
+    
+    // Parameter 'trace_events_path'
+    // ctype is 'char*'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = STRING_TYPE;
+    tt->param_name = tdrpStrDup("trace_events_path");
+    tt->descr = tdrpStrDup("Path of the trace-event output file.");
+    tt->help = tdrpStrDup("Applies only if write_trace_events is true. The file is written once all volumes have been processed.");
+    tt->val_offset = (char *) &trace_events_path - &_start_;
+    tt->single_val.s = tdrpStrDup("./Radx2Grid_trace.json");
+    tt++;
+    
+    // Parameter 'Comment 35'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = COMMENT_TYPE;
+    tt->param_name = tdrpStrDup("Comment 35");
+    tt->comment_hdr = tdrpStrDup("HARDWARE PERFORMANCE COUNTERS");
+    tt->comment_text = tdrpStrDup("");
+    tt++;
+    
+    // Parameter 'collect_perf_counters'
+    // ctype is 'tdrp_bool_t'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = BOOL_TYPE;
+    tt->param_name = tdrpStrDup("collect_perf_counters");
+    tt->descr = tdrpStrDup("Option to count CPU events for each processing stage.");
+    tt->help = tdrpStrDup("If true, cycles, instructions, cache misses and branch misses are counted with perf_event_open, and printed after each stage, alongside the TIMING output. Applies to each phase of the legacy interpolators and to each stage of the INTERP_MODE_CART_MAP pipeline. The pipeline stages overlap, so their counts include whatever else was running at the time. Needs access to the hardware counters - see /proc/sys/kernel/perf_event_paranoid.");
+    tt->val_offset = (char *) &collect_perf_counters - &_start_;
+    tt->single_val.b = pFALSE;
+    tt++;
+    
+    // Parameter 'Comment 36'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = COMMENT_TYPE;
+    tt->param_name = tdrpStrDup("Comment 36");
+    tt->comment_hdr = tdrpStrDup("RASTER OUTPUT");
+    tt->comment_text = tdrpStrDup("Applies only to INTERP_MODE_CART_MAP with output_format = RASTER. Fields are written as GeoTIFF, in an azimuthal equidistant projection centred on the radar.");
+    tt++;
+    
+    // Parameter 'raster_layout'
+    // ctype is '_raster_layout_t'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = ENUM_TYPE;
+    tt->param_name = tdrpStrDup("raster_layout");
+    tt->descr = tdrpStrDup("Layout of the GeoTIFF files.");
+    tt->help = tdrpStrDup("RASTER_BAND_PER_LEVEL: one file per field, with one band per height level. RASTER_FILE_PER_LEVEL: one single-band file per field per height level, named with the height in meters.");
+    tt->val_offset = (char *) &raster_layout - &_start_;
+    tt->enum_def.name = tdrpStrDup("raster_layout_t");
+    tt->enum_def.nfields = 2;
+    tt->enum_def.fields = (enum_field_t *)
+        tdrpMalloc(tt->enum_def.nfields * sizeof(enum_field_t));
+      tt->enum_def.fields[0].name = tdrpStrDup("RASTER_BAND_PER_LEVEL");
+      tt->enum_def.fields[0].val = RASTER_BAND_PER_LEVEL;
+      tt->enum_def.fields[1].name = tdrpStrDup("RASTER_FILE_PER_LEVEL");
+      tt->enum_def.fields[1].val = RASTER_FILE_PER_LEVEL;
+    tt->single_val.e = RASTER_BAND_PER_LEVEL;
+    tt++;
+    
+    // Parameter 'raster_compression'
+    // ctype is '_raster_compression_t'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = ENUM_TYPE;
+    tt->param_name = tdrpStrDup("raster_compression");
+    tt->descr = tdrpStrDup("Compression of the GeoTIFF tiles.");
+    tt->help = tdrpStrDup("LZW and DEFLATE use the floating point predictor. Tiles are compressed on all cores.");
+    tt->val_offset = (char *) &raster_compression - &_start_;
+    tt->enum_def.name = tdrpStrDup("raster_compression_t");
+    tt->enum_def.nfields = 3;
+    tt->enum_def.fields = (enum_field_t *)
+        tdrpMalloc(tt->enum_def.nfields * sizeof(enum_field_t));
+      tt->enum_def.fields[0].name = tdrpStrDup("RASTER_COMPRESS_NONE");
+      tt->enum_def.fields[0].val = RASTER_COMPRESS_NONE;
+      tt->enum_def.fields[1].name = tdrpStrDup("RASTER_COMPRESS_LZW");
+      tt->enum_def.fields[1].val = RASTER_COMPRESS_LZW;
+      tt->enum_def.fields[2].name = tdrpStrDup("RASTER_COMPRESS_DEFLATE");
+      tt->enum_def.fields[2].val = RASTER_COMPRESS_DEFLATE;
+    tt->single_val.e = RASTER_COMPRESS_DEFLATE;
+    tt++;
+    
+    // Parameter 'raster_tile_size'
+    // ctype is 'int'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = INT_TYPE;
+    tt->param_name = tdrpStrDup("raster_tile_size");
+    tt->descr = tdrpStrDup("Width and height of the GeoTIFF tiles, in pixels.");
+    tt->help = tdrpStrDup("Must be a multiple of 16.");
+    tt->val_offset = (char *) &raster_tile_size - &_start_;
+    tt->has_min = TRUE;
+    tt->has_max = TRUE;
+    tt->min_val.i = 16;
+    tt->max_val.i = 4096;
+    tt->single_val.i = 256;
+    tt++;
+    
+    // Parameter 'raster_build_overviews'
+    // ctype is 'tdrp_bool_t'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = BOOL_TYPE;
+    tt->param_name = tdrpStrDup("raster_build_overviews");
+    tt->descr = tdrpStrDup("Option to add overviews to the GeoTIFF files.");
+    tt->help = tdrpStrDup("If true, averaged overviews are built at factors of 2, 4, 8 ... until the overview fits in one tile.");
+    tt->val_offset = (char *) &raster_build_overviews - &_start_;
+    tt->single_val.b = pFALSE;
+    tt++;
+    
+    // Parameter 'Comment 37'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = COMMENT_TYPE;
+    tt->param_name = tdrpStrDup("Comment 37");
+    tt->comment_hdr = tdrpStrDup("PACKED OUTPUT");
+    tt->comment_text = tdrpStrDup("");
+    tt++;
+    
+    // Parameter 'output_packing'
+    // ctype is '_output_packing_t'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = ENUM_TYPE;
+    tt->param_name = tdrpStrDup("output_packing");
+    tt->descr = tdrpStrDup("Encoding of the output fields.");
+    tt->help = tdrpStrDup("PACKING_INT16 and PACKING_INT8 store each field as 16 or 8 bit integers, with a scale_factor and add_offset chosen from the range of the field in each volume, and the lowest integer value as the _FillValue for missing data. The quantization step is (max - min) / 65534 for INT16 and (max - min) / 254 for INT8, so INT8 suits fields with a narrow range or coarse resolution only. Applies to CF_NETCDF output of INTERP_MODE_CART_MAP, and to MDV and CF_NETCDF output of the other interpolation modes. With PACKING_FLOAT32, MDV fields of 8 or 16 bit input data are still written as INT16, as before.");
+    tt->val_offset = (char *) &output_packing - &_start_;
+    tt->enum_def.name = tdrpStrDup("output_packing_t");
+    tt->enum_def.nfields = 3;
+    tt->enum_def.fields = (enum_field_t *)
+        tdrpMalloc(tt->enum_def.nfields * sizeof(enum_field_t));
+      tt->enum_def.fields[0].name = tdrpStrDup("PACKING_FLOAT32");
+      tt->enum_def.fields[0].val = PACKING_FLOAT32;
+      tt->enum_def.fields[1].name = tdrpStrDup("PACKING_INT16");
+      tt->enum_def.fields[1].val = PACKING_INT16;
+      tt->enum_def.fields[2].name = tdrpStrDup("PACKING_INT8");
+      tt->enum_def.fields[2].val = PACKING_INT8;
+    tt->single_val.e = PACKING_FLOAT32;
+    tt++;
+    
+    // Parameter 'Comment 38'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = COMMENT_TYPE;
+    tt->param_name = tdrpStrDup("Comment 38");
+    tt->comment_hdr = tdrpStrDup("ZARR OUTPUT");
+    tt->comment_text = tdrpStrDup("Applies only to INTERP_MODE_CART_MAP with output_format = ZARR. Each volume is written as a Zarr v2 directory store named zarr_<instrument>_<time>.zarr, with one array per field, dimensions (z0, y0, x0), and x0, y0 and z0 coordinate arrays. Each chunk holds one tile of one level, in its own file, so a reader can fetch any tile with a single small read. The metadata of all arrays is also consolidated in .zmetadata at the top of the store. Fields are written as float32, or packed as set by output_packing.");
+    tt++;
+    
+    // Parameter 'zarr_chunk_size'
+    // ctype is 'int'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = INT_TYPE;
+    tt->param_name = tdrpStrDup("zarr_chunk_size");
+    tt->descr = tdrpStrDup("Width and height of the Zarr chunks, in grid cells.");
+    tt->help = tdrpStrDup("Each chunk covers one z level.");
+    tt->val_offset = (char *) &zarr_chunk_size - &_start_;
+    tt->has_min = TRUE;
+    tt->has_max = TRUE;
+    tt->min_val.i = 16;
+    tt->max_val.i = 4096;
+    tt->single_val.i = 256;
+    tt++;
+    
+    // Parameter 'zarr_compression_level'
+    // ctype is 'int'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = INT_TYPE;
+    tt->param_name = tdrpStrDup("zarr_compression_level");
+    tt->descr = tdrpStrDup("zlib compression level of the Zarr chunks.");
+    tt->help = tdrpStrDup("Chunks are byte-shuffled and deflated in parallel. 0 stores the chunks uncompressed.");
+    tt->val_offset = (char *) &zarr_compression_level - &_start_;
+    tt->has_min = TRUE;
+    tt->has_max = TRUE;
+    tt->min_val.i = 0;
+    tt->max_val.i = 9;
+    tt->single_val.i = 4;
+    tt++;
+    
+    // Parameter 'Comment 39'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = COMMENT_TYPE;
+    tt->param_name = tdrpStrDup("Comment 39");
+    tt->comment_hdr = tdrpStrDup("DERIVED 2D PRODUCTS");
+    tt->comment_text = tdrpStrDup("Applies only to INTERP_MODE_CART_MAP. The products are computed from the reflectivity column at each (x, y) point, in the same pass that normalizes the grid, and written to the output file with the 3D fields. Missing levels in a column are skipped.");
+    tt++;
+    
+    // Parameter 'derived_dbz_field_name'
+    // ctype is 'char*'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = STRING_TYPE;
+    tt->param_name = tdrpStrDup("derived_dbz_field_name");
+    tt->descr = tdrpStrDup("Name of the reflectivity field for the derived products.");
+    tt->help = tdrpStrDup("Must be one of the output fields. The fast path reads and grids the reflectivity as REF.");
+    tt->val_offset = (char *) &derived_dbz_field_name - &_start_;
+    tt->single_val.s = tdrpStrDup("REF");
+    tt++;
+    
+    // Parameter 'compute_column_max_dbz'
+    // ctype is 'tdrp_bool_t'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = BOOL_TYPE;
+    tt->param_name = tdrpStrDup("compute_column_max_dbz");
+    tt->descr = tdrpStrDup("Option to compute the column-maximum reflectivity, COLMAX.");
+    tt->help = tdrpStrDup("");
+    tt->val_offset = (char *) &compute_column_max_dbz - &_start_;
+    tt->single_val.b = pFALSE;
+    tt++;
+    
+    // Parameter 'compute_echo_top'
+    // ctype is 'tdrp_bool_t'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = BOOL_TYPE;
+    tt->param_name = tdrpStrDup("compute_echo_top");
+    tt->descr = tdrpStrDup("Option to compute the echo top height, ECHO_TOP, in km MSL.");
+    tt->help = tdrpStrDup("The height of the highest grid level with reflectivity at or above echo_top_threshold_dbz, interpolated linearly to the threshold with the level above.");
+    tt->val_offset = (char *) &compute_echo_top - &_start_;
+    tt->single_val.b = pFALSE;
+    tt++;
+    
+    // Parameter 'echo_top_threshold_dbz'
+    // ctype is 'double'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = DOUBLE_TYPE;
+    tt->param_name = tdrpStrDup("echo_top_threshold_dbz");
+    tt->descr = tdrpStrDup("Reflectivity threshold for ECHO_TOP (dBZ).");
+    tt->help = tdrpStrDup("");
+    tt->val_offset = (char *) &echo_top_threshold_dbz - &_start_;
+    tt->single_val.d = 18;
+    tt++;
+    
+    // Parameter 'compute_vil'
+    // ctype is 'tdrp_bool_t'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = BOOL_TYPE;
+    tt->param_name = tdrpStrDup("compute_vil");
+    tt->descr = tdrpStrDup("Option to compute the vertically integrated liquid, VIL, in kg/m2.");
+    tt->help = tdrpStrDup("VIL = sum of 3.44e-6 * Z^(4/7) * dz over the column, Z in mm6/m3 averaged between adjacent levels. Reflectivity is capped at vil_max_dbz to limit the contribution of hail.");
+    tt->val_offset = (char *) &compute_vil - &_start_;
+    tt->single_val.b = pFALSE;
+    tt++;
+    
+    // Parameter 'vil_max_dbz'
+    // ctype is 'double'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = DOUBLE_TYPE;
+    tt->param_name = tdrpStrDup("vil_max_dbz");
+    tt->descr = tdrpStrDup("Cap on the reflectivity used for VIL (dBZ).");
+    tt->help = tdrpStrDup("");
+    tt->val_offset = (char *) &vil_max_dbz - &_start_;
+    tt->single_val.d = 56;
+    tt++;
+    
+    // Parameter 'Comment 40'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = COMMENT_TYPE;
+    tt->param_name = tdrpStrDup("Comment 40");
+    tt->comment_hdr = tdrpStrDup("SPARSE GRID STORAGE");
+    tt->comment_text = tdrpStrDup("");
+    tt++;
+    
+    // Parameter 'sparse_grid_storage'
+    // ctype is 'tdrp_bool_t'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = BOOL_TYPE;
+    tt->param_name = tdrpStrDup("sparse_grid_storage");
+    tt->descr = tdrpStrDup("Option to accumulate the grid in sparse 8x8x8 bricks.");
+    tt->help = tdrpStrDup("Applies only to INTERP_MODE_CART_MAP. If true, the sum, weight and count grids of each field are stored as bricks of 8x8x8 cells, allocated only when a gate first touches them. Untouched bricks - beyond the maximum range, or above the highest beam - take no memory, are skipped when the grid is normalized, and their chunks are not written to compressed netCDF or Zarr output, where readers see them as _FillValue. Worthwhile for large domains, where many cells receive no data.");
+    tt->val_offset = (char *) &sparse_grid_storage - &_start_;
+    tt->single_val.b = pFALSE;
+    tt++;
+    
+    // Parameter 'Comment 41'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = COMMENT_TYPE;
+    tt->param_name = tdrpStrDup("Comment 41");
+    tt->comment_hdr = tdrpStrDup("SUPEROBBING");
+    tt->comment_text = tdrpStrDup("");
+    tt++;
+    
+    // Parameter 'superob_gates'
+    // ctype is 'tdrp_bool_t'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = BOOL_TYPE;
+    tt->param_name = tdrpStrDup("superob_gates");
+    tt->descr = tdrpStrDup("Option to aggregate near-range gates into super-observations before gridding.");
+    tt->help = tdrpStrDup("Applies only to INTERP_MODE_CART_MAP. Near the radar, many gates of a sweep fall within one grid cell. If true, gates within superob_max_range_km whose centres fall in the same grid cell, in the same sweep, are replaced by one super-observation at their mean position, with the mean value of each field, counted as that many gates. The scatter cost then scales with the number of occupied cells rather than the number of gates. The result differs slightly from gridding each gate - use run_regression.sh -s to measure the difference.");
+    tt->val_offset = (char *) &superob_gates - &_start_;
+    tt->single_val.b = pFALSE;
+    tt++;
+    
+    // Parameter 'superob_max_range_km'
+    // ctype is 'double'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = DOUBLE_TYPE;
+    tt->param_name = tdrpStrDup("superob_max_range_km");
+    tt->descr = tdrpStrDup("Range limit for superobbing (km).");
+    tt->help = tdrpStrDup("Gates beyond this range are gridded one by one. Set it to where the gate spacing and beam width become comparable to the grid spacing.");
+    tt->val_offset = (char *) &superob_max_range_km - &_start_;
+    tt->has_min = TRUE;
+    tt->min_val.d = 0;
+    tt->single_val.d = 60;
+    tt++;
+    
+    // Parameter 'Comment 42'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = COMMENT_TYPE;
+    tt->param_name = tdrpStrDup("Comment 42");
+    tt->comment_hdr = tdrpStrDup("GATE ORDERING");
+    tt->comment_text = tdrpStrDup("");
+    tt++;
+    
+    // Parameter 'gate_order'
+    // ctype is '_gate_order_t'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = ENUM_TYPE;
+    tt->param_name = tdrpStrDup("gate_order");
+    tt->descr = tdrpStrDup("Order in which gates are scattered onto the grid.");
+    tt->help = tdrpStrDup("Applies only to INTERP_MODE_CART_MAP. GATE_ORDER_FILE: ray by ray, as read. Consecutive gates then update distant parts of the grid from one task to the next. GATE_ORDER_MORTON and GATE_ORDER_HILBERT: gates are first sorted, in parallel, by the index of their grid cell along a Morton (Z-order) or Hilbert curve, so each task updates a compact region of the grid, for better cache and TLB locality on large grids. Hilbert has the better locality, Morton the cheaper index. The grid values do not depend on the order, apart from rounding. Superobs, see superob_gates, are ordered the same way.");
+    tt->val_offset = (char *) &gate_order - &_start_;
+    tt->enum_def.name = tdrpStrDup("gate_order_t");
+    tt->enum_def.nfields = 3;
+    tt->enum_def.fields = (enum_field_t *)
+        tdrpMalloc(tt->enum_def.nfields * sizeof(enum_field_t));
+      tt->enum_def.fields[0].name = tdrpStrDup("GATE_ORDER_FILE");
+      tt->enum_def.fields[0].val = GATE_ORDER_FILE;
+      tt->enum_def.fields[1].name = tdrpStrDup("GATE_ORDER_MORTON");
+      tt->enum_def.fields[1].val = GATE_ORDER_MORTON;
+      tt->enum_def.fields[2].name = tdrpStrDup("GATE_ORDER_HILBERT");
+      tt->enum_def.fields[2].val = GATE_ORDER_HILBERT;
+    tt->single_val.e = GATE_ORDER_FILE;
+    tt++;
+    
+    // Parameter 'Comment 43'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = COMMENT_TYPE;
+    tt->param_name = tdrpStrDup("Comment 43");
+    tt->comment_hdr = tdrpStrDup("FUSED GATE KERNEL");
+    tt->comment_text = tdrpStrDup("");
+    tt++;
+    
+    // Parameter 'fuse_gate_stages'
+    // ctype is 'tdrp_bool_t'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = BOOL_TYPE;
+    tt->param_name = tdrpStrDup("fuse_gate_stages");
+    tt->descr = tdrpStrDup("Option to expand, locate and scatter each gate in one pass.");
+    tt->help = tdrpStrDup("Applies only to INTERP_MODE_CART_MAP. By default the gates go through three stages, each storing per-gate arrays for the next: expansion of the rays into gates (range, elevation, azimuth and field values), then the gate positions and radius of influence, then the scatter onto the grid. If true, each ray is processed in one pass from the input fields: the trig for the ray is computed once, and each gate's range, position and radius of influence are computed and the gate scattered at once, with no per-gate arrays. The grid is the same. superob_gates and gate_order need the per-gate arrays, and do not apply in this mode. The staged mode is kept for debugging.");
+    tt->val_offset = (char *) &fuse_gate_stages - &_start_;
+    tt->single_val.b = pFALSE;
+    tt++;
+    
+    // Parameter 'Comment 44'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = COMMENT_TYPE;
+    tt->param_name = tdrpStrDup("Comment 44");
+    tt->comment_hdr = tdrpStrDup("RADIUS OF INFLUENCE");
+    tt->comment_text = tdrpStrDup("Applies only to INTERP_MODE_CART_MAP. Each gate is spread over the grid cells within its radius of influence, so the radius sets both the smoothness of the grid and the cost of interpGrid, which grows with its cube. Apart from ROI_DISTANCE_HEIGHT, the radius depends only on the slant range of the gate, and is looked up in a table precomputed at roi_table_spacing_m.");
+    tt++;
+    
+    // Parameter 'roi_model'
+    // ctype is '_roi_model_t'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = ENUM_TYPE;
+    tt->param_name = tdrpStrDup("roi_model");
+    tt->descr = tdrpStrDup("Model for the radius of influence of a gate.");
+    tt->help = tdrpStrDup("ROI_DISTANCE_HEIGHT: 1.5 degrees of the ground distance plus 2% of the height above the radar, as in earlier versions. ROI_CONSTANT: roi_constant_m at all ranges. ROI_BEAM_WIDTH: roi_beam_width_factor times the width of the beam at the range of the gate. ROI_BARNES: the distance at which a Barnes weight, tuned to the spacing of the gates, falls to roi_barnes_min_weight - see Koch et al. (1983). The spacing is the larger of the gate spacing and the spacing of the rays at the range of the gate. ROI_RANGE_TABLE: interpolated linearly in roi_range_table. All but ROI_RANGE_TABLE are limited to [roi_min_m, roi_max_m].");
+    tt->val_offset = (char *) &roi_model - &_start_;
+    tt->enum_def.name = tdrpStrDup("roi_model_t");
+    tt->enum_def.nfields = 5;
+    tt->enum_def.fields = (enum_field_t *)
+        tdrpMalloc(tt->enum_def.nfields * sizeof(enum_field_t));
+      tt->enum_def.fields[0].name = tdrpStrDup("ROI_DISTANCE_HEIGHT");
+      tt->enum_def.fields[0].val = ROI_DISTANCE_HEIGHT;
+      tt->enum_def.fields[1].name = tdrpStrDup("ROI_CONSTANT");
+      tt->enum_def.fields[1].val = ROI_CONSTANT;
+      tt->enum_def.fields[2].name = tdrpStrDup("ROI_BEAM_WIDTH");
+      tt->enum_def.fields[2].val = ROI_BEAM_WIDTH;
+      tt->enum_def.fields[3].name = tdrpStrDup("ROI_BARNES");
+      tt->enum_def.fields[3].val = ROI_BARNES;
+      tt->enum_def.fields[4].name = tdrpStrDup("ROI_RANGE_TABLE");
+      tt->enum_def.fields[4].val = ROI_RANGE_TABLE;
+    tt->single_val.e = ROI_DISTANCE_HEIGHT;
+    tt++;
+    
+    // Parameter 'roi_min_m'
+    // ctype is 'double'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = DOUBLE_TYPE;
+    tt->param_name = tdrpStrDup("roi_min_m");
+    tt->descr = tdrpStrDup("Lower limit of the radius of influence (m).");
+    tt->help = tdrpStrDup("");
+    tt->val_offset = (char *) &roi_min_m - &_start_;
+    tt->has_min = TRUE;
+    tt->min_val.d = 0;
+    tt->single_val.d = 500;
+    tt++;
+    
+    // Parameter 'roi_max_m'
+    // ctype is 'double'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = DOUBLE_TYPE;
+    tt->param_name = tdrpStrDup("roi_max_m");
+    tt->descr = tdrpStrDup("Upper limit of the radius of influence (m).");
+    tt->help = tdrpStrDup("");
+    tt->val_offset = (char *) &roi_max_m - &_start_;
+    tt->has_min = TRUE;
+    tt->min_val.d = 0;
+    tt->single_val.d = 2000;
+    tt++;
+    
+    // Parameter 'roi_constant_m'
+    // ctype is 'double'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = DOUBLE_TYPE;
+    tt->param_name = tdrpStrDup("roi_constant_m");
+    tt->descr = tdrpStrDup("Radius of influence for ROI_CONSTANT (m).");
+    tt->help = tdrpStrDup("");
+    tt->val_offset = (char *) &roi_constant_m - &_start_;
+    tt->has_min = TRUE;
+    tt->min_val.d = 0;
+    tt->single_val.d = 1000;
+    tt++;
+    
+    // Parameter 'roi_beam_width_deg'
+    // ctype is 'double'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = DOUBLE_TYPE;
+    tt->param_name = tdrpStrDup("roi_beam_width_deg");
+    tt->descr = tdrpStrDup("Half-power beam width, for ROI_BEAM_WIDTH (deg).");
+    tt->help = tdrpStrDup("");
+    tt->val_offset = (char *) &roi_beam_width_deg - &_start_;
+    tt->has_min = TRUE;
+    tt->min_val.d = 0;
+    tt->single_val.d = 1;
+    tt++;
+    
+    // Parameter 'roi_beam_width_factor'
+    // ctype is 'double'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = DOUBLE_TYPE;
+    tt->param_name = tdrpStrDup("roi_beam_width_factor");
+    tt->descr = tdrpStrDup("Radius of influence in beam widths, for ROI_BEAM_WIDTH.");
+    tt->help = tdrpStrDup("");
+    tt->val_offset = (char *) &roi_beam_width_factor - &_start_;
+    tt->has_min = TRUE;
+    tt->min_val.d = 0;
+    tt->single_val.d = 1;
+    tt++;
+    
+    // Parameter 'roi_barnes_ray_spacing_deg'
+    // ctype is 'double'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = DOUBLE_TYPE;
+    tt->param_name = tdrpStrDup("roi_barnes_ray_spacing_deg");
+    tt->descr = tdrpStrDup("Spacing of the rays, for ROI_BARNES (deg).");
+    tt->help = tdrpStrDup("");
+    tt->val_offset = (char *) &roi_barnes_ray_spacing_deg - &_start_;
+    tt->has_min = TRUE;
+    tt->min_val.d = 0;
+    tt->single_val.d = 1;
+    tt++;
+    
+    // Parameter 'roi_barnes_gate_spacing_m'
+    // ctype is 'double'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = DOUBLE_TYPE;
+    tt->param_name = tdrpStrDup("roi_barnes_gate_spacing_m");
+    tt->descr = tdrpStrDup("Spacing of the gates, for ROI_BARNES (m).");
+    tt->help = tdrpStrDup("");
+    tt->val_offset = (char *) &roi_barnes_gate_spacing_m - &_start_;
+    tt->has_min = TRUE;
+    tt->min_val.d = 0;
+    tt->single_val.d = 250;
+    tt++;
+    
+    // Parameter 'roi_barnes_min_weight'
+    // ctype is 'double'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = DOUBLE_TYPE;
+    tt->param_name = tdrpStrDup("roi_barnes_min_weight");
+    tt->descr = tdrpStrDup("Barnes weight at the radius of influence, for ROI_BARNES.");
+    tt->help = tdrpStrDup("Smaller values give larger radii, and smoother grids.");
+    tt->val_offset = (char *) &roi_barnes_min_weight - &_start_;
+    tt->has_min = TRUE;
+    tt->has_max = TRUE;
+    tt->min_val.d = 0.0001;
+    tt->max_val.d = 0.9;
+    tt->single_val.d = 0.01;
+    tt++;
+    
+    // Parameter 'roi_range_table'
+    // ctype is '_roi_range_t'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = STRUCT_TYPE;
+    tt->param_name = tdrpStrDup("roi_range_table");
+    tt->descr = tdrpStrDup("Radius of influence against slant range, for ROI_RANGE_TABLE.");
+    tt->help = tdrpStrDup("Entries in increasing order of range. The radius is interpolated linearly between entries, and held at the first and last entries beyond them.");
+    tt->array_offset = (char *) &_roi_range_table - &_start_;
+    tt->array_n_offset = (char *) &roi_range_table_n - &_start_;
+    tt->is_array = TRUE;
+    tt->array_len_fixed = FALSE;
+    tt->array_elem_size = sizeof(roi_range_t);
+    tt->array_n = 4;
+    tt->struct_def.name = tdrpStrDup("roi_range_t");
+    tt->struct_def.nfields = 2;
+    tt->struct_def.fields = (struct_field_t *)
+        tdrpMalloc(tt->struct_def.nfields * sizeof(struct_field_t));
+      tt->struct_def.fields[0].ftype = tdrpStrDup("double");
+      tt->struct_def.fields[0].fname = tdrpStrDup("range_km");
+      tt->struct_def.fields[0].ptype = DOUBLE_TYPE;
+      tt->struct_def.fields[0].rel_offset = 
+        (char *) &_roi_range_table->range_km - (char *) _roi_range_table;
+      tt->struct_def.fields[1].ftype = tdrpStrDup("double");
+      tt->struct_def.fields[1].fname = tdrpStrDup("roi_km");
+      tt->struct_def.fields[1].ptype = DOUBLE_TYPE;
+      tt->struct_def.fields[1].rel_offset = 
+        (char *) &_roi_range_table->roi_km - (char *) _roi_range_table;
+    tt->n_struct_vals = 8;
+    tt->struct_vals = (tdrpVal_t *)
+        tdrpMalloc(tt->n_struct_vals * sizeof(tdrpVal_t));
+      tt->struct_vals[0].d = 0;
+      tt->struct_vals[1].d = 0.5;
+      tt->struct_vals[2].d = 50;
+      tt->struct_vals[3].d = 1;
+      tt->struct_vals[4].d = 150;
+      tt->struct_vals[5].d = 2;
+      tt->struct_vals[6].d = 300;
+      tt->struct_vals[7].d = 4;
+    tt++;
+    
+    // Parameter 'roi_table_spacing_m'
+    // ctype is 'double'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = DOUBLE_TYPE;
+    tt->param_name = tdrpStrDup("roi_table_spacing_m");
+    tt->descr = tdrpStrDup("Range spacing of the precomputed radius of influence table (m).");
+    tt->help = tdrpStrDup("The table extends to roi_table_max_range_km, and is held at its last entry beyond that.");
+    tt->val_offset = (char *) &roi_table_spacing_m - &_start_;
+    tt->has_min = TRUE;
+    tt->min_val.d = 1;
+    tt->single_val.d = 100;
+    tt++;
+    
+    // Parameter 'roi_table_max_range_km'
+    // ctype is 'double'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = DOUBLE_TYPE;
+    tt->param_name = tdrpStrDup("roi_table_max_range_km");
+    tt->descr = tdrpStrDup("Maximum range of the precomputed radius of influence table (km).");
+    tt->help = tdrpStrDup("");
+    tt->val_offset = (char *) &roi_table_max_range_km - &_start_;
+    tt->has_min = TRUE;
+    tt->min_val.d = 1;
+    tt->single_val.d = 600;
+    tt++;
+    
+    // Parameter 'Comment 45'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = COMMENT_TYPE;
+    tt->param_name = tdrpStrDup("Comment 45");
+    tt->comment_hdr = tdrpStrDup("SPATIAL INDEX FOR REORDER AND SAT INTERPOLATION");
+    tt->comment_text = tdrpStrDup("");
+    tt++;
+    
+    // Parameter 'reorder_spatial_index'
+    // ctype is '_spatial_index_t'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = ENUM_TYPE;
+    tt->param_name = tdrpStrDup("reorder_spatial_index");
+    tt->descr = tdrpStrDup("Index used to find the radar points around each grid point.");
+    tt->help = tdrpStrDup("Applies to INTERP_MODE_CART_REORDER and INTERP_MODE_CART_SAT. SPATIAL_INDEX_KD_TREE: a KD-tree, which suits any spread of points. SPATIAL_INDEX_BUCKETS: the points are sorted, in parallel, into a uniform grid of cubic buckets, and each search visits the buckets around the grid point, nearest first. Cheaper to build and search when the points are spread fairly evenly and the search radius spans a few buckets. Both give the same neighbors.");
+    tt->val_offset = (char *) &reorder_spatial_index - &_start_;
+    tt->enum_def.name = tdrpStrDup("spatial_index_t");
+    tt->enum_def.nfields = 2;
+    tt->enum_def.fields = (enum_field_t *)
+        tdrpMalloc(tt->enum_def.nfields * sizeof(enum_field_t));
+      tt->enum_def.fields[0].name = tdrpStrDup("SPATIAL_INDEX_KD_TREE");
+      tt->enum_def.fields[0].val = SPATIAL_INDEX_KD_TREE;
+      tt->enum_def.fields[1].name = tdrpStrDup("SPATIAL_INDEX_BUCKETS");
+      tt->enum_def.fields[1].val = SPATIAL_INDEX_BUCKETS;
+    tt->single_val.e = SPATIAL_INDEX_KD_TREE;
+    tt++;
+    
+    // Parameter 'reorder_bucket_size_km'
+    // ctype is 'double'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = DOUBLE_TYPE;
+    tt->param_name = tdrpStrDup("reorder_bucket_size_km");
+    tt->descr = tdrpStrDup("Edge of the buckets for SPATIAL_INDEX_BUCKETS (km).");
+    tt->help = tdrpStrDup("If 0, reorder_search_radius_km. The buckets are enlarged if needed to keep their number within a few times the number of points.");
+    tt->val_offset = (char *) &reorder_bucket_size_km - &_start_;
+    tt->has_min = TRUE;
+    tt->min_val.d = 0;
+    tt->single_val.d = 0;
+    tt++;
+    
+    // Parameter 'Comment 46'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = COMMENT_TYPE;
+    tt->param_name = tdrpStrDup("Comment 46");
+    tt->comment_hdr = tdrpStrDup("REORDER LEAST SQUARES FITS");
+    tt->comment_text = tdrpStrDup("");
+    tt++;
+    
+    // Parameter 'reorder_reuse_fits_across_volumes'
+    // ctype is 'tdrp_bool_t'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = BOOL_TYPE;
+    tt->param_name = tdrpStrDup("reorder_reuse_fits_across_volumes");
+    tt->descr = tdrpStrDup("Option to keep the least squares fits from one volume for the next.");
+    tt->help = tdrpStrDup("Applies to INTERP_MODE_CART_REORDER with reorder_weighted_interpolation = FALSE. The fit at a grid point depends only on the locations of the radar points around it, so it is factored once and shared by the fields. If this is TRUE the fits are also kept, and reused for the next volume if the radar location and gate locations have not changed. MEMORY: the fits kept take 4 bytes per grid point, plus about 180 bytes per grid point with data at all the radar points around it - up to about 1.8 GB for a 500 x 500 x 40 grid with data everywhere.");
+    tt->val_offset = (char *) &reorder_reuse_fits_across_volumes - &_start_;
+    tt->single_val.b = pFALSE;
+    tt++;
+    
+    // Parameter 'Comment 47'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = COMMENT_TYPE;
+    tt->param_name = tdrpStrDup("Comment 47");
+    tt->comment_hdr = tdrpStrDup("CART SEARCH MATRIX");
+    tt->comment_text = tdrpStrDup("");
+    tt++;
+    
+    // Parameter 'search_matrix_cache_size'
+    // ctype is 'int'
+    
+    memset(tt, 0, sizeof(TDRPtable));
+    tt->ptype = INT_TYPE;
+    tt->param_name = tdrpStrDup("search_matrix_cache_size");
+    tt->descr = tdrpStrDup("Number of scan strategies for which the filled search matrix is kept.");
+    tt->help = tdrpStrDup("Applies to INTERP_MODE_CART. The search matrix finds the rays around each grid point, and is filled for every volume. The fill depends only on which cells of the matrix hold a ray, so it is kept for each scan strategy (the VCP, or scan id), and reused for the next volume with that strategy if those cells are unchanged. Each strategy kept takes 16 bytes per cell of the matrix - about 20 MB for a full 360 degree scan up to 25 degrees elevation. Set to 0 to fill the matrix every volume.");
+    tt->val_offset = (char *) &search_matrix_cache_size - &_start_;
+    tt->has_min = TRUE;
+    tt->min_val.i = 0;
+    tt->single_val.i = 4;
+    tt++;
+    
     // trailing entry has param_name set to NULL
     
     tt->param_name = NULL;
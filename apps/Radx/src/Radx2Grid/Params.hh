@@ -103,7 +103,8 @@ public:
     ZEBRA_NETCDF = 1,
     MDV = 2,
     CEDRIC = 3,
-    RASTER = 4
+    RASTER = 4,
+    ZARR = 5
   } output_format_t;
 
   typedef enum {
@@ -113,6 +114,42 @@ public:
     NETCDF4 = 3
   } netcdf_style_t;
 
+  typedef enum {
+    RASTER_BAND_PER_LEVEL = 0,
+    RASTER_FILE_PER_LEVEL = 1
+  } raster_layout_t;
+
+  typedef enum {
+    RASTER_COMPRESS_NONE = 0,
+    RASTER_COMPRESS_LZW = 1,
+    RASTER_COMPRESS_DEFLATE = 2
+  } raster_compression_t;
+
+  typedef enum {
+    PACKING_FLOAT32 = 0,
+    PACKING_INT16 = 1,
+    PACKING_INT8 = 2
+  } output_packing_t;
+
+  typedef enum {
+    GATE_ORDER_FILE = 0,
+    GATE_ORDER_MORTON = 1,
+    GATE_ORDER_HILBERT = 2
+  } gate_order_t;
+
+  typedef enum {
+    ROI_DISTANCE_HEIGHT = 0,
+    ROI_CONSTANT = 1,
+    ROI_BEAM_WIDTH = 2,
+    ROI_BARNES = 3,
+    ROI_RANGE_TABLE = 4
+  } roi_model_t;
+
+  typedef enum {
+    SPATIAL_INDEX_KD_TREE = 0,
+    SPATIAL_INDEX_BUCKETS = 1
+  } spatial_index_t;
+
   // struct typedefs
 
   typedef struct {
@@ -173,6 +210,11 @@ public:
     logical_t combination_method;
   } censoring_field_t;
 
+  typedef struct {
+    double range_km;
+    double roi_km;
+  } roi_range_t;
+
   ///////////////////////////
   // Member functions
   //
@@ -770,6 +812,81 @@ public:
 
   char* ncf_comment;
 
+  tdrp_bool_t write_trace_events;
+
+  char* trace_events_path;
+
+  tdrp_bool_t collect_perf_counters;
+
+  raster_layout_t raster_layout;
+
+  raster_compression_t raster_compression;
+
+  int raster_tile_size;
+
+  tdrp_bool_t raster_build_overviews;
+
+  output_packing_t output_packing;
+
+  int zarr_chunk_size;
+
+  int zarr_compression_level;
+
+  char* derived_dbz_field_name;
+
+  tdrp_bool_t compute_column_max_dbz;
+
+  tdrp_bool_t compute_echo_top;
+
+  double echo_top_threshold_dbz;
+
+  tdrp_bool_t compute_vil;
+
+  double vil_max_dbz;
+
+  tdrp_bool_t sparse_grid_storage;
+
+  tdrp_bool_t superob_gates;
+
+  double superob_max_range_km;
+
+  gate_order_t gate_order;
+
+  tdrp_bool_t fuse_gate_stages;
+
+  roi_model_t roi_model;
+
+  double roi_min_m;
+
+  double roi_max_m;
+
+  double roi_constant_m;
+
+  double roi_beam_width_deg;
+
+  double roi_beam_width_factor;
+
+  double roi_barnes_ray_spacing_deg;
+
+  double roi_barnes_gate_spacing_m;
+
+  double roi_barnes_min_weight;
+
+  roi_range_t *_roi_range_table;
+  int roi_range_table_n;
+
+  double roi_table_spacing_m;
+
+  double roi_table_max_range_km;
+
+  spatial_index_t reorder_spatial_index;
+
+  double reorder_bucket_size_km;
+
+  tdrp_bool_t reorder_reuse_fits_across_volumes;
+
+  int search_matrix_cache_size;
+
   char _end_; // end of data region
               // needed for zeroing out data
 
@@ -777,7 +894,7 @@ private:
 
   void _init();
 
-  mutable TDRPtable _table[187];
+  mutable TDRPtable _table[238];
 
   const char *_className;
 
@@ -0,0 +1,181 @@
+#include "PerfCounters.hh"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sstream>
+#include <sys/syscall.h>
+#include <tbb/task_scheduler_observer.h>
+#include <unistd.h>
+
+std::atomic<bool> PerfCounters::_enabled(false);
+bool PerfCounters::_available[PerfCounters::N_EVENTS] = {};
+std::mutex PerfCounters::_registryMutex;
+std::vector<PerfCounters::ThreadCounters> PerfCounters::_registry;
+thread_local bool PerfCounters::_registered = false;
+
+namespace {
+
+const uint64_t _configs[PerfCounters::N_EVENTS] = {
+  PERF_COUNT_HW_CPU_CYCLES,
+  PERF_COUNT_HW_INSTRUCTIONS,
+  PERF_COUNT_HW_CACHE_MISSES,
+  PERF_COUNT_HW_BRANCH_MISSES
+};
+
+const char* _names[PerfCounters::N_EVENTS] = {
+  "cycles",
+  "instructions",
+  "cache misses",
+  "branch misses"
+};
+
+// registers each TBB worker as it joins the arena
+
+class _WorkerObserver : public tbb::task_scheduler_observer
+{
+public:
+  void on_scheduler_entry(bool) override { PerfCounters::registerThread(); }
+};
+
+_WorkerObserver _observer;
+
+} // namespace
+
+PerfCounters::Sample
+PerfCounters::Sample::operator-(const Sample& rhs) const
+{
+  Sample diff;
+  for (int ii = 0; ii < N_EVENTS; ii++) {
+    diff.vals[ii] = vals[ii] - rhs.vals[ii];
+  }
+  return diff;
+}
+
+PerfCounters::Sample&
+PerfCounters::Sample::operator+=(const Sample& rhs)
+{
+  for (int ii = 0; ii < N_EVENTS; ii++) {
+    vals[ii] += rhs.vals[ii];
+  }
+  return *this;
+}
+
+int
+PerfCounters::_open(event_t event)
+{
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof(attr);
+  attr.config = _configs[event];
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format =
+    PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+  // this thread, any cpu, no group
+  return int(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+int
+PerfCounters::enable()
+{
+  if (isEnabled()) {
+    return 0;
+  }
+
+  // probe on the calling thread; events the CPU lacks (common under
+  // virtualization) are left out rather than failing the lot
+
+  ThreadCounters counters;
+  int nOpen = 0;
+  for (int ii = 0; ii < N_EVENTS; ii++) {
+    counters.fds[ii] = _open(event_t(ii));
+    _available[ii] = counters.fds[ii] >= 0;
+    if (_available[ii]) {
+      nOpen++;
+    } else {
+      std::cerr << "WARNING - PerfCounters::enable" << std::endl;
+      std::cerr << "  Cannot count " << _names[ii] << ": " << strerror(errno)
+                << std::endl;
+    }
+  }
+  if (nOpen == 0) {
+    std::cerr << "  Check /proc/sys/kernel/perf_event_paranoid" << std::endl;
+    return -1;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(_registryMutex);
+    _registry.push_back(counters);
+  }
+  _registered = true;
+  _enabled.store(true, std::memory_order_relaxed);
+  _observer.observe(true);
+  return 0;
+}
+
+void
+PerfCounters::registerThread()
+{
+  if (_registered || !isEnabled()) {
+    return;
+  }
+  ThreadCounters counters;
+  for (int ii = 0; ii < N_EVENTS; ii++) {
+    counters.fds[ii] = _available[ii] ? _open(event_t(ii)) : -1;
+  }
+  std::lock_guard<std::mutex> lock(_registryMutex);
+  _registry.push_back(counters);
+  _registered = true;
+}
+
+PerfCounters::Sample
+PerfCounters::read()
+{
+  Sample sample;
+  if (!isEnabled()) {
+    return sample;
+  }
+
+  // value, time enabled, time running - scale up if multiplexed
+
+  std::lock_guard<std::mutex> lock(_registryMutex);
+  for (const ThreadCounters& counters : _registry) {
+    for (int ii = 0; ii < N_EVENTS; ii++) {
+      uint64_t buf[3];
+      if (counters.fds[ii] < 0 ||
+          ::read(counters.fds[ii], buf, sizeof(buf)) != sizeof(buf) ||
+          buf[2] == 0) {
+        continue;
+      }
+      sample.vals[ii] += double(buf[0]) * double(buf[1]) / double(buf[2]);
+    }
+  }
+  return sample;
+}
+
+std::string
+PerfCounters::format(const Sample& delta)
+{
+  std::ostringstream out;
+  out.precision(4);
+  for (int ii = 0; ii < N_EVENTS; ii++) {
+    if (_available[ii]) {
+      out << _names[ii] << ": " << delta.vals[ii] << ", ";
+    }
+  }
+  double instr = delta.vals[INSTRUCTIONS];
+  if (_available[CYCLES] && _available[INSTRUCTIONS] &&
+      delta.vals[CYCLES] > 0) {
+    out << "IPC: " << instr / delta.vals[CYCLES] << ", ";
+  }
+  if (_available[CACHE_MISSES] && instr > 0) {
+    out << "cache MPKI: " << delta.vals[CACHE_MISSES] * 1000.0 / instr
+        << ", ";
+  }
+  std::string str = out.str();
+  return str.empty() ? str : str.substr(0, str.size() - 2);
+}
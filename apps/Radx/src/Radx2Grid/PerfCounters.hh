@@ -0,0 +1,109 @@
+#ifndef RADX_RADX2GRID_PERF_COUNTERS_H_
+#define RADX_RADX2GRID_PERF_COUNTERS_H_
+
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Hardware performance counters from perf_event_open: cycles,
+// instructions, cache misses and branch misses, counted in user space.
+//
+// Counters are opened per thread and read() sums every registered thread,
+// so a difference of two reads covers the TBB workers as well as the
+// calling thread. Threads register themselves with registerThread(); TBB
+// workers are registered by a scheduler observer installed by enable().
+// Stages that overlap in the pipeline share the counts of whatever ran at
+// the same time - Radx2GridBench -perf gives per-kernel counts in
+// isolation.
+
+class PerfCounters
+{
+public:
+  enum event_t
+  {
+    CYCLES,
+    INSTRUCTIONS,
+    CACHE_MISSES,
+    BRANCH_MISSES,
+    N_EVENTS
+  };
+
+  // counts, scaled for multiplexing
+  struct Sample
+  {
+    double vals[N_EVENTS] = {};
+
+    Sample operator-(const Sample& rhs) const;
+    Sample& operator+=(const Sample& rhs);
+  };
+
+  // Open counters on the calling thread and watch for TBB workers.
+  // Returns 0 on success, -1 if perf_event_open is not available.
+  static int enable();
+
+  static inline bool isEnabled()
+  {
+    return _enabled.load(std::memory_order_relaxed);
+  }
+
+  // Open counters on the calling thread, once per thread.
+  static void registerThread();
+
+  // Sum over all registered threads. All zero when disabled.
+  static Sample read();
+
+  // "cycles: ..., instructions: ..., IPC: ..., ..." for a delta.
+  static std::string format(const Sample& delta);
+
+private:
+  struct ThreadCounters
+  {
+    int fds[N_EVENTS];
+  };
+
+  static std::atomic<bool> _enabled;
+  static bool _available[N_EVENTS];
+  static std::mutex _registryMutex;
+  static std::vector<ThreadCounters> _registry;
+  static thread_local bool _registered;
+
+  static int _open(event_t event);
+};
+
+// Scoped counter: prints the counts over its lifetime to cerr as
+//   PERF, task: <name>, cycles: ...
+
+class PerfScope
+{
+public:
+  PerfScope(const char* name)
+    : _name(name)
+    , _active(PerfCounters::isEnabled())
+  {
+    if (_active) {
+      PerfCounters::registerThread();
+      _start = PerfCounters::read();
+    }
+  }
+
+  ~PerfScope()
+  {
+    if (_active) {
+      std::cerr << "PERF, task: " << _name << ", "
+                << PerfCounters::format(PerfCounters::read() - _start)
+                << std::endl;
+    }
+  }
+
+  PerfScope(const PerfScope&) = delete;
+  PerfScope& operator=(const PerfScope&) = delete;
+
+private:
+  const char* _name;
+  bool _active;
+  PerfCounters::Sample _start;
+};
+
+#endif // RADX_RADX2GRID_PERF_COUNTERS_H_
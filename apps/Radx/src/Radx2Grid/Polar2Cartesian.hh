@@ -2,21 +2,60 @@
 #define RADX_RADX2GRID_POLAR_2_CARTESIAN_H_
 
 #include "PolarDataStream.hh"
+#include "RadiusOfInfluence.hh"
 #include "tbb/partitioner.h"
+#include <algorithm>
+#include <cmath>
+
+// Position of a gate relative to the radar, m
+struct GateGeometry
+{
+  double groundDistance;
+  double zr;
+  double x, y, z;
+  double roi;
+};
 
 class Polar2Cartesian
 {
 public:
   // constructor & destructor
-  Polar2Cartesian(std::shared_ptr<Repository> store);
+  Polar2Cartesian(std::shared_ptr<Repository> store, const Params& params);
   ~Polar2Cartesian();
 
   void calculateXYZ(int nthreads);
 
+  // Geometry of the gate at range (m) on a ray, given the sine and
+  // cosine of the ray elevation and of its angle from the x axis,
+  // 4/3 earth radius model, with the radius of influence from roi.
+  // Shared by calculateXYZ and the fused scatter kernel in Cart2Grid,
+  // which hoists the trig out of the gate loop.
+  static inline GateGeometry gateGeometry(double range, double sinElev,
+                                          double cosElev, double cosAngle,
+                                          double sinAngle, double altitudeAgl,
+                                          const RadiusOfInfluence& roi)
+  {
+    const double effRadius = 4.0 * 6371008.0 / 3.0;
+    GateGeometry geom;
+    // (Eq 2.28b)
+    geom.zr = sqrt(range * range + (range * 2.0 * effRadius) * sinElev +
+                   effRadius * effRadius) -
+              effRadius;
+    // (Eq 2.28c)
+    geom.groundDistance =
+      effRadius * asin(range * cosElev / (effRadius + geom.zr));
+    geom.x = geom.groundDistance * cosAngle;
+    geom.y = geom.groundDistance * sinAngle;
+    geom.z = geom.zr + altitudeAgl;
+    geom.roi = roi.evaluate(range, geom.groundDistance, geom.zr);
+    return geom;
+  }
+
   static tbb::affinity_partitioner ap;
 
 private:
   std::shared_ptr<Repository> _store;
+  RadiusOfInfluence _roi;
 };
 
 #endif // RADX_RADX2GRID_POLAR_2_CARTESIAN_H_
@@ -172,11 +172,14 @@ int PolarInterp::interpVol()
 
   _computeAzGridDetails();
 
-  // initialize the output grid dimensions
+  // initialize the output grid dimensions, and the projection
+  // if the radar or grid has changed
 
   _initZLevels();
   _initGrid();
-  _initProjection();
+  if (_gridGeomHasChanged()) {
+    _initProjection();
+  }
 
   // compute search matrix angle limits - keep the matrix
   // as small as possible for efficiency
@@ -197,10 +200,6 @@ int PolarInterp::interpVol()
   }
   _doInterp();
 
-  // transform for output
-
-  _transformForOutput();
-
   // write out data
 
   if (_writeOutputFile()) {
@@ -1018,7 +1017,8 @@ void PolarInterp::_loadNearestGridPt(int ifield, int ptIndex, int igate,
   // compute weighted mean
 
   if (nContrib >= 1) {
-    _outputFields[ifield][ptIndex] = closestVal;
+    _outputFields[ifield][ptIndex] =
+      _outputVal(_interpFields[ifield], closestVal);
   } else {
     _outputFields[ifield][ptIndex] = missingFl32;
   }
@@ -1056,7 +1056,8 @@ void PolarInterp::_loadInterpGridPt(int ifield, int ptIndex, int igate,
     if (sumWts > 0) {
       interpVal = sumVals / sumWts;
     }
-    _outputFields[ifield][ptIndex] = interpVal;
+    _outputFields[ifield][ptIndex] =
+      _outputVal(_interpFields[ifield], interpVal);
   } else {
     _outputFields[ifield][ptIndex] = missingFl32;
   }
@@ -1097,7 +1098,8 @@ void PolarInterp::_loadFoldedGridPt(int ifield, int ptIndex, int igate,
     double angleInterp = atan2(sumY, sumX);
     double valInterp =
         _getFoldValue(angleInterp, intFld.foldLimitLower, intFld.foldRange);
-    _outputFields[ifield][ptIndex] = valInterp;
+    _outputFields[ifield][ptIndex] =
+      _outputVal(_interpFields[ifield], valInterp);
   } else {
     _outputFields[ifield][ptIndex] = missingFl32;
   }
@@ -67,7 +67,6 @@ PpiInterp::PpiInterp(const string &progName,
   _searchRight = NULL;
 
   _prevRadarLat = _prevRadarLon = _prevRadarAltKm = -9999.0;
-  _gridLoc = NULL;
   _nzAlloc = _nyAlloc = _nxAlloc = 0;
   _outputFields = NULL;
 
@@ -124,7 +123,7 @@ int PpiInterp::interpVol()
 
   // initialize the output grid dimensions if things have changed
   
-  if (_geomHasChanged() || _gridLoc == NULL) {
+  if (_geomHasChanged() || !_gridLocs.isAllocated()) {
 
     // initialize grid
 
@@ -160,10 +159,6 @@ int PpiInterp::interpVol()
   }
   _doInterp();
 
-  // transform for output
-
-  _transformForOutput();
-
   // write out data
 
   if (_writeOutputFile()) {
@@ -393,16 +388,7 @@ void PpiInterp::_initGrid()
   _gridMiny = _params.grid_xy_geom.miny;
   _gridDy = _params.grid_xy_geom.dy;
 
-  _gridLoc = (GridLoc ****)
-    umalloc3(_nEl, _gridNy, _gridNx, sizeof(GridLoc *));
-  
-  for (int iz = 0; iz < _nEl; iz++) {
-    for (int iy = 0; iy < _gridNy; iy++) {
-      for (int ix = 0; ix < _gridNx; ix++) {
-        _gridLoc[iz][iy][ix] = new GridLoc;
-      }
-    }
-  }
+  _gridLocs.alloc(_nEl, _gridNy, _gridNx);
 
   _nzAlloc = _nEl;
   _nyAlloc = _gridNy;
@@ -424,18 +410,8 @@ void PpiInterp::_freeGridLoc()
   
 {
   
-  if (_gridLoc) {
-    for (int iz = 0; iz < _nzAlloc; iz++) {
-      for (int iy = 0; iy < _nyAlloc; iy++) {
-        for (int ix = 0; ix < _nxAlloc; ix++) {
-          delete _gridLoc[iz][iy][ix];
-        }
-      }
-    }
-    ufree3((void ***) _gridLoc);
-    _gridLoc = NULL;
-    _nzAlloc = _nyAlloc = _nxAlloc = 0;
-  }
+  _gridLocs.clear();
+  _nzAlloc = _nyAlloc = _nxAlloc = 0;
 
 }
 
@@ -668,10 +644,10 @@ void PpiInterp::_computeGridRow(int iz, int iy)
     
     // compute elevation
     
-    GridLoc *loc = _gridLoc[iz][iy][ix];
-    loc->az = azimuth;
-    loc->slantRange = gndRange / cosElev;
-    loc->gndRange = gndRange;
+    size_t ii = _gridLocs.index(iz, iy, ix);
+    _gridLocs.az[ii] = azimuth;
+    _gridLocs.slantRange[ii] = gndRange / cosElev;
+    _gridLocs.gndRange[ii] = gndRange;
     
   } // ix
 
@@ -1071,11 +1047,11 @@ void PpiInterp::_interpRow(int iel, int iy)
 
     // get the grid location
     
-    const GridLoc *loc = _gridLoc[iel][iy][ix];
+    const GridLoc loc = _gridLocs.get(iel, iy, ix);
     
     // find starting location in search vector
 
-    double az = _conditionAz(loc->az);
+    double az = _conditionAz(loc.az);
     int iaz = _getSearchAzIndex(az);
     
     if (iaz < 0) {
@@ -1161,7 +1137,7 @@ void PpiInterp::_interpRow(int iel, int iy)
 
     // get gate indices, compute weights based on range
 
-    double rangeKm = loc->slantRange;
+    double rangeKm = loc.slantRange;
     double dgate = (rangeKm - _startRangeKm) / _gateSpacingKm;
     int igateInner = (int) floor(dgate);
     int igateOuter = igateInner + 1;
@@ -1256,7 +1232,7 @@ void PpiInterp::_loadWtsFor1ValidRay(const SearchPoint &left,
 // load up weights for case where we
 // have 2 valid rays
   
-void PpiInterp::_loadWtsFor2ValidRays(const GridLoc *loc,
+void PpiInterp::_loadWtsFor2ValidRays(const GridLoc &loc,
                                       const SearchPoint &left,
                                       const SearchPoint &right,
                                       double wtInner,
@@ -1265,7 +1241,7 @@ void PpiInterp::_loadWtsFor2ValidRays(const GridLoc *loc,
 
 {
   
-  double az = _conditionAz(loc->az);
+  double az = _conditionAz(loc.az);
 
   // compute 'distance' in el/az space from ray to grid location
   // compute weights based on inverse of
@@ -1326,7 +1302,8 @@ void PpiInterp::_loadNearestGridPt(int ifield,
   // compute weighted mean
   
   if (nContrib >= _params.min_nvalid_for_interp) {
-    _outputFields[ifield][ptIndex] = closestVal;
+    _outputFields[ifield][ptIndex] =
+      _outputVal(_interpFields[ifield], closestVal);
   } else {
     _outputFields[ifield][ptIndex] = missingFl32;
   }
@@ -1369,7 +1346,8 @@ void PpiInterp::_loadInterpGridPt(int ifield,
     if (sumWts > 0) {
       interpVal = sumVals / sumWts;
     }
-    _outputFields[ifield][ptIndex] = interpVal;
+    _outputFields[ifield][ptIndex] =
+      _outputVal(_interpFields[ifield], interpVal);
   } else {
     _outputFields[ifield][ptIndex] = missingFl32;
   }
@@ -1415,7 +1393,8 @@ void PpiInterp::_loadFoldedGridPt(int ifield,
     double angleInterp = atan2(sumY, sumX);
     double valInterp = _getFoldValue(angleInterp,
                                      intFld.foldLimitLower, intFld.foldRange);
-    _outputFields[ifield][ptIndex] = valInterp;
+    _outputFields[ifield][ptIndex] =
+      _outputVal(_interpFields[ifield], valInterp);
   } else {
     _outputFields[ifield][ptIndex] = missingFl32;
   }
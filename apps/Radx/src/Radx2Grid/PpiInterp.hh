@@ -181,7 +181,7 @@ private:
                             double wtOuter, 
                             Neighbors &wts);
   
-  void _loadWtsFor2ValidRays(const GridLoc *loc,
+  void _loadWtsFor2ValidRays(const GridLoc &loc,
                              const SearchPoint &left,
                              const SearchPoint &right,
                              double wtInner,
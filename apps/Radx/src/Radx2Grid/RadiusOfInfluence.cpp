@@ -0,0 +1,90 @@
+#include "RadiusOfInfluence.hh"
+#include <iostream>
+
+RadiusOfInfluence::RadiusOfInfluence(const Params& params)
+  : _model(params.roi_model)
+  , _perGate(params.roi_model == Params::ROI_DISTANCE_HEIGHT)
+  , _minRoi(params.roi_min_m)
+  , _maxRoi(std::max(params.roi_max_m, params.roi_min_m))
+  , _spacing(params.roi_table_spacing_m)
+  , _invSpacing(1.0 / params.roi_table_spacing_m)
+{
+  if (_model == Params::ROI_RANGE_TABLE) {
+    _rangeTable.assign(params._roi_range_table,
+                       params._roi_range_table + params.roi_range_table_n);
+    std::sort(_rangeTable.begin(), _rangeTable.end(),
+              [](const Params::roi_range_t& a, const Params::roi_range_t& b) {
+                return a.range_km < b.range_km;
+              });
+    if (_rangeTable.empty()) {
+      std::cerr << "WARNING - RadiusOfInfluence::RadiusOfInfluence"
+                << std::endl;
+      std::cerr << "  roi_range_table is empty, using roi_constant_m"
+                << std::endl;
+      _model = Params::ROI_CONSTANT;
+    }
+  }
+
+  // table at 0, spacing, ... up to and including the maximum range
+
+  const double maxRange = params.roi_table_max_range_km * 1000.0;
+  const size_t nEntries = size_t(std::ceil(maxRange * _invSpacing)) + 1;
+  _table.resize(std::max(nEntries, size_t(2)));
+  for (size_t ii = 0; ii < _table.size(); ii++) {
+    _table[ii] = _compute(params, double(ii) * _spacing);
+  }
+  _lastPos = double(_table.size() - 1);
+}
+
+// radius of influence at a slant range (m), for the range-only models
+
+double
+RadiusOfInfluence::_compute(const Params& params, double range) const
+{
+  double roi = _minRoi;
+  switch (_model) {
+    case Params::ROI_CONSTANT:
+      roi = params.roi_constant_m;
+      break;
+    case Params::ROI_BEAM_WIDTH: {
+      const double beamWidth =
+        2.0 * range * tan(params.roi_beam_width_deg * M_PI / 360.0);
+      roi = params.roi_beam_width_factor * beamWidth;
+      break;
+    }
+    case Params::ROI_BARNES: {
+      // Koch et al. (1983): kappa = 5.052 (2 dn / pi)^2 for data spacing
+      // dn, weight exp(-r^2 / kappa), which falls to the minimum weight at
+      // r = sqrt(kappa ln(1 / w))
+      const double raySpacing =
+        range * params.roi_barnes_ray_spacing_deg * M_PI / 180.0;
+      const double dn = std::max(params.roi_barnes_gate_spacing_m, raySpacing);
+      const double kappa = 5.052 * pow(2.0 * dn / M_PI, 2.0);
+      roi = sqrt(kappa * log(1.0 / params.roi_barnes_min_weight));
+      break;
+    }
+    case Params::ROI_RANGE_TABLE:
+      return _interpRangeTable(range);
+    default:
+      break;
+  }
+  return std::min(std::max(roi, _minRoi), _maxRoi);
+}
+
+double
+RadiusOfInfluence::_interpRangeTable(double range) const
+{
+  const double rangeKm = range / 1000.0;
+  if (rangeKm <= _rangeTable.front().range_km) {
+    return _rangeTable.front().roi_km * 1000.0;
+  }
+  for (size_t ii = 1; ii < _rangeTable.size(); ii++) {
+    const Params::roi_range_t& lo = _rangeTable[ii - 1];
+    const Params::roi_range_t& hi = _rangeTable[ii];
+    if (rangeKm <= hi.range_km) {
+      const double frac = (rangeKm - lo.range_km) / (hi.range_km - lo.range_km);
+      return (lo.roi_km + frac * (hi.roi_km - lo.roi_km)) * 1000.0;
+    }
+  }
+  return _rangeTable.back().roi_km * 1000.0;
+}
@@ -0,0 +1,60 @@
+#ifndef RADX_RADX2GRID_RADIUS_OF_INFLUENCE_H_
+#define RADX_RADX2GRID_RADIUS_OF_INFLUENCE_H_
+
+#include "Params.hh"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+// Radius of influence of a gate, by the model chosen with roi_model.
+//
+// ROI_DISTANCE_HEIGHT depends on the ground distance and height of the
+// gate, and is computed for each gate. The other models depend only on
+// the slant range, and are tabulated once at roi_table_spacing_m out to
+// roi_table_max_range_km, so evaluate() costs a linear interpolation
+// whatever the model.
+
+class RadiusOfInfluence
+{
+public:
+  RadiusOfInfluence(const Params& params);
+
+  // radius of influence (m) of a gate at slant range (m), with its ground
+  // distance and height above the radar (m)
+  inline double evaluate(double range, double groundDistance,
+                         double zr) const
+  {
+    if (_perGate) {
+      double radiusOfInfluence =
+        groundDistance * 1.5 / 180.0 * M_PI + zr * 0.02;
+      return std::min(std::max(radiusOfInfluence, _minRoi), _maxRoi);
+    }
+    const double pos = std::max(range, 0.0) * _invSpacing;
+    if (pos >= _lastPos) {
+      return _table.back();
+    }
+    const size_t ii = size_t(pos);
+    const double frac = pos - double(ii);
+    return _table[ii] + frac * (_table[ii + 1] - _table[ii]);
+  }
+
+  // true if the model depends only on the slant range
+  inline bool isTabulated() const { return !_perGate; }
+  inline const std::vector<double>& getTable() const { return _table; }
+  inline double getSpacing() const { return _spacing; }
+
+private:
+  Params::roi_model_t _model;
+  bool _perGate;
+  double _minRoi, _maxRoi;
+  double _spacing, _invSpacing;
+  double _lastPos;
+  std::vector<double> _table;
+  std::vector<Params::roi_range_t> _rangeTable;
+
+  double _compute(const Params& params, double range) const;
+  double _interpRangeTable(double range) const;
+};
+
+#endif // RADX_RADX2GRID_RADIUS_OF_INFLUENCE_H_
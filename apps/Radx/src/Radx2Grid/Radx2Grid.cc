@@ -37,7 +37,9 @@
 ///////////////////////////////////////////////////////////////
 
 #include "Radx2Grid.hh"
+#include "FastTransform.hh"
 #include "OutputMdv.hh"
+#include "PerfCounters.hh"
 #include "Radx2GridPlus.hh"
 #include <Mdv/GenericRadxFile.hh>
 #include <Radx/RadxField.hh>
@@ -114,6 +116,15 @@ Radx2Grid::Radx2Grid(int argc, char **argv)
   if (_params.override_volume_number || _params.autoincrement_volume_number) {
     _volNum = _params.starting_volume_number;
   }
+
+  // hardware counters, before any worker threads start
+
+  if (_params.collect_perf_counters) {
+    if (PerfCounters::enable()) {
+      cerr << "WARNING: " << _progName << endl;
+      cerr << "  Cannot collect hardware performance counters" << endl;
+    }
+  }
 }
 
 //////////////////////////////////////
@@ -1049,13 +1060,16 @@ void Radx2Grid::_setupTransformFields() {
       // transform
 
       xfield->convertToFl32();
+      Radx::fl32 *data = xfield->getDataFl32();
+      size_t nPoints = xfield->getNPoints();
+      Radx::fl32 missing = xfield->getMissingFl32();
       if (transform.transform == Params::TRANSFORM_DB_TO_LINEAR ||
           transform.transform == Params::TRANSFORM_DB_TO_LINEAR_AND_BACK) {
-        xfield->transformDbToLinear();
+        FastTransform::dbToLinear(data, nPoints, missing);
       } else if (transform.transform == Params::TRANSFORM_LINEAR_TO_DB ||
                  transform.transform ==
                      Params::TRANSFORM_LINEAR_TO_DB_AND_BACK) {
-        xfield->transformLinearToDb();
+        FastTransform::linearToDb(data, nPoints, missing);
       }
 
       if (makeCopy) {
@@ -1292,6 +1306,25 @@ void Radx2Grid::_initInterpFields() {
     }   // ii
   }
 
+  // set the transforms back for output from the parameters
+
+  if (_params.transform_fields_for_interpolation) {
+    for (int ii = 0; ii < _params.transform_fields_n; ii++) {
+      const Params::transform_field_t &transform =
+          _params._transform_fields[ii];
+      string radxName = transform.output_name;
+      for (size_t ifld = 0; ifld < _interpFields.size(); ifld++) {
+        if (_interpFields[ifld].radxName == radxName) {
+          _interpFields[ifld].toDbForOutput =
+              (transform.transform == Params::TRANSFORM_DB_TO_LINEAR_AND_BACK);
+          _interpFields[ifld].toLinearForOutput =
+              (transform.transform == Params::TRANSFORM_LINEAR_TO_DB_AND_BACK);
+          break;
+        }
+      } // ifld
+    }   // ii
+  }
+
   // rename fields
 
   if (_params.rename_fields) {
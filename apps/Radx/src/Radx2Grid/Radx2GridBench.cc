@@ -0,0 +1,457 @@
+///////////////////////////////////////////////////////////////
+//
+// main for Radx2GridBench
+//
+// Times each kernel of the Radx2GridPlus (INTERP_MODE_CART_MAP)
+// pipeline in isolation, over a sweep of gate counts, grid sizes
+// and thread counts, and writes the results as CSV or JSON.
+//
+///////////////////////////////////////////////////////////////
+
+#include "Cart2Grid.hh"
+#include "Params.hh"
+#include "PerfCounters.hh"
+#include "Polar2Cartesian.hh"
+#include "PolarDataStream.hh"
+#include "SyntheticVolume.hh"
+#include "WriteOutput.hh"
+#include "tbb/task_scheduler_init.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+struct Options
+{
+  vector<int> gates = { 460, 920, 1840 };
+  vector<vector<int>> grids = { { 200, 200, 20 }, { 500, 500, 20 } };
+  vector<int> threads = { int(std::thread::hardware_concurrency()) };
+  int nSweeps = 14;
+  int nRaysPerSweep = 360;
+  int reps = 3;
+  double coverage = 0.3;
+  vector<string> fields = { "REF" };
+  bool json = false;
+  bool perf = false;
+  bool writeOutput = true;
+  string outputPath;
+  string paramsPath;
+  string scratchDir = ".";
+};
+
+struct Result
+{
+  string kernel;
+  int nGates;
+  int nx, ny, nz;
+  int nThreads;
+  size_t nPoints;
+  vector<double> secs;
+  PerfCounters::Sample perf; // summed over reps
+};
+
+void
+_usage(ostream& out, const string& progName)
+{
+  out << "Usage: " << progName << " [args as below]\n"
+      << "Options:\n"
+      << "\n"
+      << "  [ -h ] produce this list.\n"
+      << "\n"
+      << "  [ -gates n1,n2,... ] gates per ray (default 460,920,1840)\n"
+      << "\n"
+      << "  [ -grids nxXnyXnz,... ] grid sizes (default 200x200x20,500x500x20)\n"
+      << "\n"
+      << "  [ -threads n1,n2,... ] thread counts (default: all cores)\n"
+      << "\n"
+      << "  [ -sweeps ? ] number of sweeps (default 14)\n"
+      << "\n"
+      << "  [ -rays ? ] rays per sweep (default 360)\n"
+      << "\n"
+      << "  [ -reps ? ] repetitions per kernel (default 3)\n"
+      << "\n"
+      << "  [ -coverage ? ] fraction of the volume with echo (default 0.3)\n"
+      << "\n"
+      << "  [ -fields f1,f2,... ] input fields (default REF)\n"
+      << "\n"
+      << "  [ -params ? ] TDRP params file for grid spacing and output\n"
+      << "\n"
+      << "  [ -scratch ? ] directory for writeOutputFile files (default .)\n"
+      << "\n"
+      << "  [ -no_write ] skip the writeOutputFile kernel\n"
+      << "\n"
+      << "  [ -json ] write JSON instead of CSV\n"
+      << "\n"
+      << "  [ -perf ] add hardware counter columns (perf_event_open)\n"
+      << "\n"
+      << "  [ -o ? ] results file (default stdout)\n"
+      << endl;
+}
+
+bool
+_parseIntList(const char* str, vector<int>& vals)
+{
+  vals.clear();
+  stringstream ss(str);
+  string tok;
+  while (getline(ss, tok, ',')) {
+    int val = atoi(tok.c_str());
+    if (val <= 0) {
+      return false;
+    }
+    vals.push_back(val);
+  }
+  return !vals.empty();
+}
+
+bool
+_parseGridList(const char* str, vector<vector<int>>& grids)
+{
+  grids.clear();
+  stringstream ss(str);
+  string tok;
+  while (getline(ss, tok, ',')) {
+    int nx, ny, nz;
+    if (sscanf(tok.c_str(), "%dx%dx%d", &nx, &ny, &nz) != 3 || nx <= 0 ||
+        ny <= 0 || nz <= 0) {
+      return false;
+    }
+    grids.push_back({ nx, ny, nz });
+  }
+  return !grids.empty();
+}
+
+int
+_parseArgs(int argc, char** argv, Options& opts)
+{
+  string progName(argv[0]);
+  bool OK = true;
+  for (int i = 1; i < argc; i++) {
+    bool hasVal = i < argc - 1;
+    if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "-help")) {
+      _usage(cout, progName);
+      exit(0);
+    } else if (!strcmp(argv[i], "-gates") && hasVal) {
+      OK &= _parseIntList(argv[++i], opts.gates);
+    } else if (!strcmp(argv[i], "-grids") && hasVal) {
+      OK &= _parseGridList(argv[++i], opts.grids);
+    } else if (!strcmp(argv[i], "-threads") && hasVal) {
+      OK &= _parseIntList(argv[++i], opts.threads);
+    } else if (!strcmp(argv[i], "-sweeps") && hasVal) {
+      opts.nSweeps = atoi(argv[++i]);
+      OK &= opts.nSweeps > 0;
+    } else if (!strcmp(argv[i], "-rays") && hasVal) {
+      opts.nRaysPerSweep = atoi(argv[++i]);
+      OK &= opts.nRaysPerSweep > 0;
+    } else if (!strcmp(argv[i], "-reps") && hasVal) {
+      opts.reps = atoi(argv[++i]);
+      OK &= opts.reps > 0;
+    } else if (!strcmp(argv[i], "-coverage") && hasVal) {
+      opts.coverage = atof(argv[++i]);
+      OK &= opts.coverage >= 0.0 && opts.coverage <= 1.0;
+    } else if (!strcmp(argv[i], "-fields") && hasVal) {
+      opts.fields.clear();
+      stringstream ss(argv[++i]);
+      string tok;
+      while (getline(ss, tok, ',')) {
+        opts.fields.push_back(tok);
+      }
+      OK &= !opts.fields.empty();
+    } else if (!strcmp(argv[i], "-params") && hasVal) {
+      opts.paramsPath = argv[++i];
+    } else if (!strcmp(argv[i], "-scratch") && hasVal) {
+      opts.scratchDir = argv[++i];
+    } else if (!strcmp(argv[i], "-no_write")) {
+      opts.writeOutput = false;
+    } else if (!strcmp(argv[i], "-json")) {
+      opts.json = true;
+    } else if (!strcmp(argv[i], "-perf")) {
+      opts.perf = true;
+    } else if (!strcmp(argv[i], "-o") && hasVal) {
+      opts.outputPath = argv[++i];
+    } else {
+      cerr << "ERROR - unknown or incomplete arg: " << argv[i] << endl;
+      OK = false;
+    }
+  }
+  if (!OK) {
+    _usage(cerr, progName);
+    return -1;
+  }
+  return 0;
+}
+
+// Time one run of func, adding the wall time and the hardware counts
+// to res.
+
+void
+_timeIt(Result& res, const function<void()>& func)
+{
+  PerfCounters::Sample perfStart = PerfCounters::read();
+  auto start = chrono::steady_clock::now();
+  func();
+  res.secs.push_back(
+    chrono::duration<double>(chrono::steady_clock::now() - start).count());
+  res.perf += PerfCounters::read() - perfStart;
+}
+
+void
+_runConfig(const Options& opts, const Params& params, int nGates,
+           int nThreads, vector<Result>& results)
+{
+  const int nx = params.grid_xy_geom.nx;
+  const int ny = params.grid_xy_geom.ny;
+  const int nz = params.grid_z_geom.nz;
+  tbb::task_scheduler_init init(nThreads);
+
+  SyntheticVolume::Config config;
+  config.nSweeps = opts.nSweeps;
+  config.nRaysPerSweep = opts.nRaysPerSweep;
+  config.nGates = nGates;
+  config.precipCoverage = opts.coverage;
+  config.fields = opts.fields;
+  config.instrumentName = "BENCH";
+  Repository input;
+  SyntheticVolume(config).fillRepository(input);
+
+  auto newResult = [&](const string& kernel) {
+    Result res;
+    res.kernel = kernel;
+    res.nGates = nGates;
+    res.nx = nx;
+    res.ny = ny;
+    res.nz = nz;
+    res.nThreads = nThreads;
+    res.nPoints = input.nPoints;
+    return res;
+  };
+
+  // PolarDataStream::populateOutputValues
+
+  Result expand = newResult("populateOutputValues");
+  shared_ptr<PolarDataStream> pds;
+  for (int irep = 0; irep < opts.reps; irep++) {
+    pds = make_shared<PolarDataStream>(input.inputFile, params);
+    *pds->getRepository() = input;
+    _timeIt(expand, [&]() { pds->populateOutputValues(nThreads); });
+  }
+  results.push_back(expand);
+  auto store = pds->getRepository();
+
+  // Polar2Cartesian::calculateXYZ
+
+  Result xyz = newResult("calculateXYZ");
+  Polar2Cartesian p2c(store, params);
+  for (int irep = 0; irep < opts.reps; irep++) {
+    _timeIt(xyz, [&]() { p2c.calculateXYZ(nThreads); });
+  }
+  results.push_back(xyz);
+
+  // Cart2Grid constructor, with and without the cached geometry
+
+  Result geom = newResult("Cart2Grid_geometry");
+  Result alloc = newResult("Cart2Grid_alloc");
+  shared_ptr<Cart2Grid> c2g;
+  for (int irep = 0; irep < opts.reps; irep++) {
+    Cart2Grid::clearGeometry();
+    c2g.reset();
+    _timeIt(geom,
+            [&]() { c2g = make_shared<Cart2Grid>(store, params, nThreads); });
+    c2g.reset();
+    _timeIt(alloc,
+            [&]() { c2g = make_shared<Cart2Grid>(store, params, nThreads); });
+  }
+  results.push_back(geom);
+  results.push_back(alloc);
+
+  // Cart2Grid::interpGrid - scatter plus normalization
+
+  Result interp = newResult("interpGrid");
+  for (int irep = 0; irep < opts.reps; irep++) {
+    c2g = make_shared<Cart2Grid>(store, params, nThreads);
+    _timeIt(interp, [&]() { c2g->interpGrid(nThreads); });
+  }
+  results.push_back(interp);
+
+  // Cart2Grid::interpGrid with fuse_gate_stages, straight from the input
+  // fields - compare with the sum of the three staged kernels
+
+  Params fusedParams(params);
+  fusedParams.fuse_gate_stages = pTRUE;
+  auto rawStore = make_shared<Repository>(input);
+  Result fused = newResult("interpGrid_fused");
+  for (int irep = 0; irep < opts.reps; irep++) {
+    auto fusedGrid = make_shared<Cart2Grid>(rawStore, fusedParams, nThreads);
+    _timeIt(fused, [&]() { fusedGrid->interpGrid(nThreads); });
+  }
+  results.push_back(fused);
+
+  // Cart2Grid::computeGrid - normalization only
+
+  Result compute = newResult("computeGrid");
+  for (int irep = 0; irep < opts.reps; irep++) {
+    _timeIt(compute, [&]() { c2g->computeGrid(nThreads); });
+  }
+  results.push_back(compute);
+
+  // WriteOutput::writeOutputFile
+
+  if (opts.writeOutput) {
+    Result write = newResult("writeOutputFile");
+    for (int irep = 0; irep < opts.reps; irep++) {
+      WriteOutput wo(c2g, store, params);
+      _timeIt(write, [&]() { wo.writeOutputFile(); });
+    }
+    results.push_back(write);
+  }
+
+  Cart2Grid::clearGeometry();
+}
+
+void
+_writeResults(ostream& out, const vector<Result>& results, bool json,
+              bool perf)
+{
+  if (json) {
+    out << "[" << endl;
+  } else {
+    out << "kernel,gates,nx,ny,nz,threads,n_points,reps,min_sec,median_sec,"
+           "mean_sec"
+        << (perf ? ",cycles,instructions,cache_misses,branch_misses" : "")
+        << endl;
+  }
+  for (size_t ii = 0; ii < results.size(); ii++) {
+    const Result& res = results[ii];
+    vector<double> secs = res.secs;
+    sort(secs.begin(), secs.end());
+    double mean = 0.0;
+    for (double sec : secs) {
+      mean += sec;
+    }
+    mean /= secs.size();
+    double median = secs[secs.size() / 2];
+
+    // hardware counts per rep
+    double counts[PerfCounters::N_EVENTS];
+    for (int ievent = 0; ievent < PerfCounters::N_EVENTS; ievent++) {
+      counts[ievent] = res.perf.vals[ievent] / secs.size();
+    }
+
+    if (json) {
+      out << "  {\"kernel\": \"" << res.kernel << "\", \"gates\": "
+          << res.nGates << ", \"nx\": " << res.nx << ", \"ny\": " << res.ny
+          << ", \"nz\": " << res.nz << ", \"threads\": " << res.nThreads
+          << ", \"n_points\": " << res.nPoints
+          << ", \"reps\": " << secs.size() << ", \"min_sec\": " << secs[0]
+          << ", \"median_sec\": " << median << ", \"mean_sec\": " << mean;
+      if (perf) {
+        out << ", \"cycles\": " << counts[PerfCounters::CYCLES]
+            << ", \"instructions\": " << counts[PerfCounters::INSTRUCTIONS]
+            << ", \"cache_misses\": " << counts[PerfCounters::CACHE_MISSES]
+            << ", \"branch_misses\": "
+            << counts[PerfCounters::BRANCH_MISSES];
+      }
+      out << "}" << (ii + 1 < results.size() ? "," : "") << endl;
+    } else {
+      out << res.kernel << "," << res.nGates << "," << res.nx << ","
+          << res.ny << "," << res.nz << "," << res.nThreads << ","
+          << res.nPoints << "," << secs.size() << "," << secs[0] << ","
+          << median << "," << mean;
+      if (perf) {
+        for (int ievent = 0; ievent < PerfCounters::N_EVENTS; ievent++) {
+          out << "," << counts[ievent];
+        }
+      }
+      out << endl;
+    }
+  }
+  if (json) {
+    out << "]" << endl;
+  }
+}
+
+} // namespace
+
+int
+main(int argc, char** argv)
+{
+  Options opts;
+  if (_parseArgs(argc, argv, opts)) {
+    return -1;
+  }
+
+  Params params;
+  if (!opts.paramsPath.empty() &&
+      params.load(opts.paramsPath.c_str(), NULL, TRUE, FALSE)) {
+    cerr << "ERROR - Radx2GridBench" << endl;
+    cerr << "  Cannot load params file: " << opts.paramsPath << endl;
+    return -1;
+  }
+  params.debug = Params::DEBUG_OFF;
+
+  // open the results file before moving to the scratch dir
+
+  ofstream resultsFile;
+  if (!opts.outputPath.empty()) {
+    resultsFile.open(opts.outputPath.c_str());
+    if (!resultsFile) {
+      cerr << "ERROR - Radx2GridBench" << endl;
+      cerr << "  Cannot open results file: " << opts.outputPath << endl;
+      return -1;
+    }
+  }
+
+  if (chdir(opts.scratchDir.c_str())) {
+    cerr << "ERROR - Radx2GridBench" << endl;
+    cerr << "  Cannot change to scratch dir: " << opts.scratchDir << endl;
+    return -1;
+  }
+
+  if (opts.perf && PerfCounters::enable()) {
+    cerr << "ERROR - Radx2GridBench" << endl;
+    cerr << "  Cannot open hardware performance counters" << endl;
+    return -1;
+  }
+
+  vector<Result> results;
+  for (const auto& grid : opts.grids) {
+    // keep the grid centred on the radar
+    params.grid_xy_geom.nx = grid[0];
+    params.grid_xy_geom.ny = grid[1];
+    params.grid_z_geom.nz = grid[2];
+    params.grid_xy_geom.minx = -0.5 * (grid[0] - 1) * params.grid_xy_geom.dx;
+    params.grid_xy_geom.miny = -0.5 * (grid[1] - 1) * params.grid_xy_geom.dy;
+    for (int nGates : opts.gates) {
+      for (int nThreads : opts.threads) {
+        cerr << "Running gates=" << nGates << " grid=" << grid[0] << "x"
+             << grid[1] << "x" << grid[2] << " threads=" << nThreads
+             << endl;
+        _runConfig(opts, params, nGates, nThreads, results);
+      }
+    }
+  }
+
+  if (resultsFile.is_open()) {
+    _writeResults(resultsFile, results, opts.json, opts.perf);
+  } else {
+    _writeResults(cout, results, opts.json, opts.perf);
+  }
+
+  return 0;
+}
@@ -0,0 +1,318 @@
+///////////////////////////////////////////////////////////////
+//
+// main for Radx2GridCompare
+//
+// Compares a gridded test file against a golden gridded file,
+// field by field, and reports RMSE, bias, coverage and max abs
+// difference. Exits non-zero if any field is outside the given
+// tolerances.
+//
+// Handles both the legacy CF NetCDF output (time, z0, y0, x0)
+// and the Radx2GridPlus output (z0, y0, x0), as well as older
+// Radx2GridPlus files in (x0, y0, z0), by matching the
+// dimension names.
+//
+///////////////////////////////////////////////////////////////
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "netcdf"
+
+using namespace std;
+
+namespace {
+
+struct Options
+{
+  string goldenPath;
+  string testPath;
+  vector<string> fields = { "REF" };
+  double maxRmse = 1.0;
+  double maxBias = 0.5;
+  double maxAbsDiff = 10.0;
+  double maxCoverageDiff = 0.02;
+  bool header = true;
+};
+
+// field values on the grid, x varying fastest
+struct GridField
+{
+  size_t nx = 0, ny = 0, nz = 0;
+  vector<float> vals;
+  vector<bool> valid;
+};
+
+struct Stats
+{
+  size_t nCells = 0;
+  size_t nGolden = 0;
+  size_t nTest = 0;
+  size_t nBoth = 0;
+  double rmse = 0.0;
+  double bias = 0.0;
+  double maxAbsDiff = 0.0;
+};
+
+void
+_usage(ostream& out, const string& progName)
+{
+  out << "Usage: " << progName << " [args as below] golden_file test_file\n"
+      << "Options:\n"
+      << "\n"
+      << "  [ -h ] produce this list.\n"
+      << "\n"
+      << "  [ -fields f1,f2,... ] fields to compare (default REF)\n"
+      << "\n"
+      << "  [ -max_rmse ? ] RMSE tolerance (default 1.0)\n"
+      << "\n"
+      << "  [ -max_bias ? ] absolute bias tolerance (default 0.5)\n"
+      << "\n"
+      << "  [ -max_abs_diff ? ] max abs difference tolerance (default 10.0)\n"
+      << "\n"
+      << "  [ -max_coverage_diff ? ] tolerance on the difference in the\n"
+      << "     fraction of valid cells (default 0.02)\n"
+      << "\n"
+      << "  [ -no_header ] do not print the CSV header line\n"
+      << "\n"
+      << "  A negative tolerance disables that check.\n"
+      << endl;
+}
+
+int
+_parseArgs(int argc, char** argv, Options& opts)
+{
+  string progName(argv[0]);
+  vector<string> paths;
+  bool OK = true;
+  for (int i = 1; i < argc; i++) {
+    bool hasVal = i < argc - 1;
+    if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "-help")) {
+      _usage(cout, progName);
+      exit(0);
+    } else if (!strcmp(argv[i], "-fields") && hasVal) {
+      opts.fields.clear();
+      stringstream ss(argv[++i]);
+      string tok;
+      while (getline(ss, tok, ',')) {
+        opts.fields.push_back(tok);
+      }
+      OK &= !opts.fields.empty();
+    } else if (!strcmp(argv[i], "-max_rmse") && hasVal) {
+      opts.maxRmse = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "-max_bias") && hasVal) {
+      opts.maxBias = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "-max_abs_diff") && hasVal) {
+      opts.maxAbsDiff = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "-max_coverage_diff") && hasVal) {
+      opts.maxCoverageDiff = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "-no_header")) {
+      opts.header = false;
+    } else if (argv[i][0] != '-') {
+      paths.push_back(argv[i]);
+    } else {
+      cerr << "ERROR - unknown or incomplete arg: " << argv[i] << endl;
+      OK = false;
+    }
+  }
+  if (paths.size() != 2) {
+    cerr << "ERROR - need a golden file and a test file" << endl;
+    OK = false;
+  } else {
+    opts.goldenPath = paths[0];
+    opts.testPath = paths[1];
+  }
+  if (!OK) {
+    _usage(cerr, progName);
+    return -1;
+  }
+  return 0;
+}
+
+// Read a gridded field, reordering to x fastest whatever the dimension
+// order in the file. Packed fields are unpacked with scale_factor and
+// add_offset. Returns 0 on success, -1 on failure.
+
+int
+_readField(const string& path, const string& name, GridField& field)
+{
+  try {
+    netCDF::NcFile file(path, netCDF::NcFile::read);
+    netCDF::NcVar var = file.getVar(name);
+    if (var.isNull()) {
+      cerr << "ERROR - Radx2GridCompare::_readField" << endl;
+      cerr << "  No field " << name << " in file: " << path << endl;
+      return -1;
+    }
+
+    // strides of x, y and z in the file order; other dims must be size 1
+
+    vector<netCDF::NcDim> dims = var.getDims();
+    size_t sx = 0, sy = 0, sz = 0, stride = 1, nTotal = 1;
+    for (int ii = int(dims.size()) - 1; ii >= 0; ii--) {
+      const string dimName = dims[ii].getName();
+      const size_t size = dims[ii].getSize();
+      if (dimName[0] == 'x') {
+        field.nx = size;
+        sx = stride;
+      } else if (dimName[0] == 'y') {
+        field.ny = size;
+        sy = stride;
+      } else if (dimName[0] == 'z') {
+        field.nz = size;
+        sz = stride;
+      } else if (size != 1) {
+        cerr << "ERROR - Radx2GridCompare::_readField" << endl;
+        cerr << "  Unexpected dimension " << dimName << " of field " << name
+             << " in file: " << path << endl;
+        return -1;
+      }
+      stride *= size;
+      nTotal *= size;
+    }
+    if (field.nx == 0 || field.ny == 0 || field.nz == 0) {
+      cerr << "ERROR - Radx2GridCompare::_readField" << endl;
+      cerr << "  Field " << name << " is not gridded in x, y and z: " << path
+           << endl;
+      return -1;
+    }
+
+    vector<float> raw(nTotal);
+    var.getVar(raw.data());
+
+    // getAtt() throws on a missing attribute, so look them up in the map
+
+    float fillValue = -9999.0F;
+    float scaleFactor = 1.0F;
+    float addOffset = 0.0F;
+    map<string, netCDF::NcVarAtt> atts = var.getAtts();
+    if (atts.count("_FillValue")) {
+      atts["_FillValue"].getValues(&fillValue);
+    }
+    if (atts.count("scale_factor")) {
+      atts["scale_factor"].getValues(&scaleFactor);
+    }
+    if (atts.count("add_offset")) {
+      atts["add_offset"].getValues(&addOffset);
+    }
+
+    field.vals.resize(nTotal);
+    field.valid.resize(nTotal);
+    size_t index = 0;
+    for (size_t kk = 0; kk < field.nz; kk++) {
+      for (size_t jj = 0; jj < field.ny; jj++) {
+        for (size_t ii = 0; ii < field.nx; ii++, index++) {
+          float val = raw[kk * sz + jj * sy + ii * sx];
+          bool valid = val != fillValue && std::isfinite(val);
+          field.valid[index] = valid;
+          field.vals[index] = valid ? val * scaleFactor + addOffset : 0.0F;
+        }
+      }
+    }
+  } catch (std::exception& e) {
+    cerr << "ERROR - Radx2GridCompare::_readField" << endl;
+    cerr << "  Cannot read " << name << " from file: " << path << endl;
+    cerr << "  " << e.what() << endl;
+    return -1;
+  }
+  return 0;
+}
+
+Stats
+_computeStats(const GridField& golden, const GridField& test)
+{
+  Stats stats;
+  stats.nCells = golden.vals.size();
+  double sumDiff = 0.0;
+  double sumSq = 0.0;
+  for (size_t ii = 0; ii < stats.nCells; ii++) {
+    if (golden.valid[ii]) {
+      stats.nGolden++;
+    }
+    if (test.valid[ii]) {
+      stats.nTest++;
+    }
+    if (golden.valid[ii] && test.valid[ii]) {
+      double diff = double(test.vals[ii]) - double(golden.vals[ii]);
+      sumDiff += diff;
+      sumSq += diff * diff;
+      stats.maxAbsDiff = std::max(stats.maxAbsDiff, fabs(diff));
+      stats.nBoth++;
+    }
+  }
+  if (stats.nBoth > 0) {
+    stats.bias = sumDiff / stats.nBoth;
+    stats.rmse = sqrt(sumSq / stats.nBoth);
+  }
+  return stats;
+}
+
+bool
+_exceeds(double val, double tolerance)
+{
+  return tolerance >= 0.0 && val > tolerance;
+}
+
+} // namespace
+
+int
+main(int argc, char** argv)
+{
+  Options opts;
+  if (_parseArgs(argc, argv, opts)) {
+    return -1;
+  }
+
+  if (opts.header) {
+    cout << "test_file,field,n_cells,golden_coverage,test_coverage,n_both,"
+            "rmse,bias,max_abs_diff,status"
+         << endl;
+  }
+
+  int iret = 0;
+  for (const string& name : opts.fields) {
+    GridField golden, test;
+    if (_readField(opts.goldenPath, name, golden) ||
+        _readField(opts.testPath, name, test)) {
+      iret = 1;
+      continue;
+    }
+    if (golden.nx != test.nx || golden.ny != test.ny ||
+        golden.nz != test.nz) {
+      cerr << "ERROR - Radx2GridCompare" << endl;
+      cerr << "  Grid size mismatch for field " << name << ": " << golden.nx
+           << "x" << golden.ny << "x" << golden.nz << " vs " << test.nx
+           << "x" << test.ny << "x" << test.nz << endl;
+      iret = 1;
+      continue;
+    }
+
+    Stats stats = _computeStats(golden, test);
+    double goldenCoverage = double(stats.nGolden) / stats.nCells;
+    double testCoverage = double(stats.nTest) / stats.nCells;
+
+    string status = "PASS";
+    if (_exceeds(stats.rmse, opts.maxRmse) ||
+        _exceeds(fabs(stats.bias), opts.maxBias) ||
+        _exceeds(stats.maxAbsDiff, opts.maxAbsDiff) ||
+        _exceeds(fabs(testCoverage - goldenCoverage), opts.maxCoverageDiff)) {
+      status = "FAIL";
+      iret = 1;
+    }
+
+    cout << opts.testPath << "," << name << "," << stats.nCells << ","
+         << setprecision(6) << goldenCoverage << "," << testCoverage << ","
+         << stats.nBoth << "," << stats.rmse << "," << stats.bias << ","
+         << stats.maxAbsDiff << "," << status << endl;
+  }
+
+  return iret;
+}
@@ -2,6 +2,8 @@
 #include "Radx2GridPlus.hh"
 #include "Cart2Grid.hh"
 #include "Params.hh"
+#include "PerfCounters.hh"
+#include "TraceEvents.hh"
 #include "tbb/task_scheduler_init.h"
 #include <chrono>
 #include <memory>
@@ -76,13 +78,18 @@ _currentTimestamp()
 void
 _pushDataintoBuffer(const std::vector<string>& filepaths, const Params& params)
 {
+  TraceEvents::setThreadName("read");
 
   // DONE: Make this across threads
   for (size_t i = 0; i < filepaths.size(); i++) {
     long start_clock = _currentTimestamp();
     // Step 1: Read from netCDF
     auto pds = std::make_shared<PolarDataStream>(filepaths[i], params);
-    pds->LoadDataFromNetCDFFilesIntoRepository();
+    {
+      TraceSpan span("LoadDataFromNetCDFFilesIntoRepository", "read", int(i));
+      PerfScope perf("LoadDataFromNetCDFFilesIntoRepository");
+      pds->LoadDataFromNetCDFFilesIntoRepository();
+    }
     if (params.debug) {
       std::cerr << "Loading data: "
                 << (_currentTimestamp() - start_clock) / 1.0E6 << " sec"
@@ -95,33 +102,58 @@ _pushDataintoBuffer(const std::vector<string>& filepaths, const Params& params)
 void
 _popDatafromBuffer(int total_size, bool _debug, const Params& params)
 {
+  TraceEvents::setThreadName("process");
 
   for (auto i = 0; i < total_size; i++) {
 
-    auto p = Radx2GridPlus::polarDataStreamQueue.pop();
-    // Expand data
+    std::shared_ptr<PolarDataStream> p;
+    {
+      TraceSpan span("wait polarDataStreamQueue", "queue", i);
+      p = Radx2GridPlus::polarDataStreamQueue.pop();
+    }
+    // Expand data. With fuse_gate_stages, expansion and coordinates are
+    // computed per gate inside interpGrid instead.
 
     long start_clock = _currentTimestamp();
-    p->populateOutputValues(Radx2GridPlus::numberOfCores);
-    if (_debug) {
-      std::cerr << "Expanding data: "
-                << (_currentTimestamp() - start_clock) / 1.0E6 << " sec"
-                << std::endl;
-    }
+    if (!params.fuse_gate_stages) {
+      {
+        TraceSpan span("populateOutputValues", "compute", i);
+        PerfScope perf("populateOutputValues");
+        p->populateOutputValues(Radx2GridPlus::numberOfCores);
+      }
+      if (_debug) {
+        std::cerr << "Expanding data: "
+                  << (_currentTimestamp() - start_clock) / 1.0E6 << " sec"
+                  << std::endl;
+      }
 
-    // Calculate Cartesian Coords.
-    start_clock = _currentTimestamp();
-    auto p2c = std::make_shared<Polar2Cartesian>(p->getRepository());
-    p2c->calculateXYZ(Radx2GridPlus::numberOfCores);
-    if (_debug) {
-      std::cerr << "Append coordinates: "
-                << (_currentTimestamp() - start_clock) / 1.0E6 << " sec"
-                << std::endl;
+      // Calculate Cartesian Coords.
+      start_clock = _currentTimestamp();
+      auto p2c = std::make_shared<Polar2Cartesian>(p->getRepository(), params);
+      {
+        TraceSpan span("calculateXYZ", "compute", i);
+        PerfScope perf("calculateXYZ");
+        p2c->calculateXYZ(Radx2GridPlus::numberOfCores);
+      }
+      if (_debug) {
+        std::cerr << "Append coordinates: "
+                  << (_currentTimestamp() - start_clock) / 1.0E6 << " sec"
+                  << std::endl;
+      }
     }
 
     start_clock = _currentTimestamp();
-    auto c2g = std::make_shared<Cart2Grid>(p->getRepository(), params, Radx2GridPlus::numberOfCores);
-    c2g->interpGrid(Radx2GridPlus::numberOfCores);
+    std::shared_ptr<Cart2Grid> c2g;
+    {
+      TraceSpan span("Cart2Grid", "compute", i);
+      PerfScope perf("Cart2Grid");
+      c2g = std::make_shared<Cart2Grid>(p->getRepository(), params, Radx2GridPlus::numberOfCores);
+    }
+    {
+      TraceSpan span("interpGrid", "compute", i);
+      PerfScope perf("interpGrid");
+      c2g->interpGrid(Radx2GridPlus::numberOfCores);
+    }
     if (_debug) {
       std::cerr << "Interp coordinates: "
                 << (_currentTimestamp() - start_clock) / 1.0E6 << " sec"
@@ -134,9 +166,17 @@ _popDatafromBuffer(int total_size, bool _debug, const Params& params)
 void
 _writeToDisk(int total_size, const Params& params)
 {
+  TraceEvents::setThreadName("write");
+
   // TODO: You task
   for (auto i = 0; i < total_size; i++) {
-    auto c2g = Radx2GridPlus::gridQueue.pop();
+    std::shared_ptr<Cart2Grid> c2g;
+    {
+      TraceSpan span("wait gridQueue", "queue", i);
+      c2g = Radx2GridPlus::gridQueue.pop();
+    }
+    TraceSpan span("writeOutputFile", "write", i);
+    PerfScope perf("writeOutputFile");
     auto wo = std::make_shared<WriteOutput>(c2g, c2g->getRepository(), params);
     wo->writeOutputFile();
   }
@@ -150,6 +190,10 @@ Radx2GridPlus::processFiles(const std::vector<string>& filepaths,
   _inputDir = params.input_dir;
   _outputDir = params.output_dir;
 
+  if (params.write_trace_events) {
+    TraceEvents::enable(params.trace_events_path);
+  }
+
   //set up number of threads to be created
   if(numberOfCores > 0) 
   {
@@ -171,4 +215,6 @@ Radx2GridPlus::processFiles(const std::vector<string>& filepaths,
   thread_read_nc.join();
   thread_process_polarstream.join();
   thread_write_out.join();
+
+  TraceEvents::write();
 }
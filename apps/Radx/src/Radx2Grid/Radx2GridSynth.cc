@@ -0,0 +1,146 @@
+///////////////////////////////////////////////////////////////
+//
+// main for Radx2GridSynth
+//
+// Writes synthetic CfRadial volumes, with configurable rays,
+// gates, sweeps, fields and precipitation coverage, for
+// benchmarking Radx2Grid on inputs of any size.
+//
+///////////////////////////////////////////////////////////////
+
+#include "SyntheticVolume.hh"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+struct Options
+{
+  SyntheticVolume::Config config;
+  int count = 1;
+  string outputDir = ".";
+};
+
+void
+_usage(ostream& out, const string& progName)
+{
+  out << "Usage: " << progName << " [args as below]\n"
+      << "Options:\n"
+      << "\n"
+      << "  [ -h ] produce this list.\n"
+      << "\n"
+      << "  [ -sweeps ? ] number of sweeps (default 14)\n"
+      << "\n"
+      << "  [ -rays ? ] rays per sweep (default 360)\n"
+      << "\n"
+      << "  [ -gates ? ] gates per ray (default 1832)\n"
+      << "\n"
+      << "  [ -gate_spacing ? ] gate spacing in m (default 250)\n"
+      << "\n"
+      << "  [ -coverage ? ] fraction of the scanned area with echo\n"
+      << "     (default 0.3)\n"
+      << "\n"
+      << "  [ -cells ? ] number of convective cells (default 12)\n"
+      << "\n"
+      << "  [ -fields f1,f2,... ] field names (default REF)\n"
+      << "     REF/DBZ* get reflectivity, VEL* radial velocity\n"
+      << "\n"
+      << "  [ -seed ? ] random seed (default 1)\n"
+      << "\n"
+      << "  [ -name ? ] instrument name (default SYNTH)\n"
+      << "\n"
+      << "  [ -count ? ] number of successive volumes (default 1)\n"
+      << "\n"
+      << "  [ -o ? ] output directory (default .)\n"
+      << endl;
+}
+
+int
+_parseArgs(int argc, char** argv, Options& opts)
+{
+  string progName(argv[0]);
+  SyntheticVolume::Config& config = opts.config;
+  bool OK = true;
+  for (int i = 1; i < argc; i++) {
+    bool hasVal = i < argc - 1;
+    if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "-help")) {
+      _usage(cout, progName);
+      exit(0);
+    } else if (!strcmp(argv[i], "-sweeps") && hasVal) {
+      config.nSweeps = atoi(argv[++i]);
+      OK &= config.nSweeps > 0;
+    } else if (!strcmp(argv[i], "-rays") && hasVal) {
+      config.nRaysPerSweep = atoi(argv[++i]);
+      OK &= config.nRaysPerSweep > 0;
+    } else if (!strcmp(argv[i], "-gates") && hasVal) {
+      config.nGates = atoi(argv[++i]);
+      OK &= config.nGates > 0;
+    } else if (!strcmp(argv[i], "-gate_spacing") && hasVal) {
+      config.gateSpacingM = atof(argv[++i]);
+      OK &= config.gateSpacingM > 0.0;
+    } else if (!strcmp(argv[i], "-coverage") && hasVal) {
+      config.precipCoverage = atof(argv[++i]);
+      OK &= config.precipCoverage >= 0.0 && config.precipCoverage <= 1.0;
+    } else if (!strcmp(argv[i], "-cells") && hasVal) {
+      config.nCells = atoi(argv[++i]);
+      OK &= config.nCells >= 0;
+    } else if (!strcmp(argv[i], "-fields") && hasVal) {
+      config.fields.clear();
+      stringstream ss(argv[++i]);
+      string tok;
+      while (getline(ss, tok, ',')) {
+        config.fields.push_back(tok);
+      }
+      OK &= !config.fields.empty();
+    } else if (!strcmp(argv[i], "-seed") && hasVal) {
+      config.seed = (unsigned int)atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "-name") && hasVal) {
+      config.instrumentName = argv[++i];
+    } else if (!strcmp(argv[i], "-count") && hasVal) {
+      opts.count = atoi(argv[++i]);
+      OK &= opts.count > 0;
+    } else if (!strcmp(argv[i], "-o") && hasVal) {
+      opts.outputDir = argv[++i];
+    } else {
+      cerr << "ERROR - unknown or incomplete arg: " << argv[i] << endl;
+      OK = false;
+    }
+  }
+  if (!OK) {
+    _usage(cerr, progName);
+    return -1;
+  }
+  return 0;
+}
+
+} // namespace
+
+int
+main(int argc, char** argv)
+{
+  Options opts;
+  if (_parseArgs(argc, argv, opts)) {
+    return -1;
+  }
+
+  SyntheticVolume synth(opts.config);
+  for (int ivol = 0; ivol < opts.count; ivol++) {
+    synth.setVolumeIndex(ivol);
+    string path = opts.outputDir + "/" + synth.getFileName();
+    if (synth.writeCfRadial(path)) {
+      cerr << "ERROR - Radx2GridSynth" << endl;
+      cerr << "  Cannot write volume: " << path << endl;
+      return -1;
+    }
+    cerr << "Wrote " << synth.getNPoints() << " gates to " << path << endl;
+  }
+
+  return 0;
+}
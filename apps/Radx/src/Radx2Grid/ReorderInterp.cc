@@ -33,10 +33,12 @@
 ///////////////////////////////////////////////////////////////
 
 #include "ReorderInterp.hh"
-#include "SvdData.hh"
 #include "OutputMdv.hh"
 #include <algorithm>
 #include <map>
+#include <cstring>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
 #include <toolsa/pjg.h>
 #include <toolsa/mem.h>
 #include <toolsa/sincos.h>
@@ -49,6 +51,20 @@
 #include <Radx/RadxSweep.hh>
 using namespace std;
 
+//
+// FNV-1a hash of the bytes of a value
+
+template <class T>
+static inline void _hashValue(uint64_t &hash, const T &val)
+{
+  unsigned char bytes[sizeof(T)];
+  memcpy(bytes, &val, sizeof(T));
+  for (size_t ii = 0; ii < sizeof(T); ii++) {
+    hash ^= bytes[ii];
+    hash *= 1099511628211ULL;
+  }
+}
+
 //
 // 
 static bool _getData(int ifield, const Interp::Ray *ray, int igate, double &v)
@@ -116,12 +132,12 @@ ReorderInterp::ReorderInterp(const string &progName,
 {
 
   _prevRadarLat = _prevRadarLon = _prevRadarAltKm = -9999.0;
-  _gridLoc = NULL;        // not used here
   _outputFields = NULL;
   _zSearchRatio = _params.reorder_z_search_ratio;
+  _fitCacheKey = 0;
 
-  _kdTree = NULL;
-  _kdMat = NULL;
+  _maxSearchDistSq = 0.0;
+  _pointIndex = SpatialIndex::create(_params);
 
   _tagStartRangeKm = -9999;
   _tagGateSpacingKm = -9999;
@@ -180,11 +196,7 @@ ReorderInterp::~ReorderInterp()
   }
 
   pthread_mutex_destroy(&_debugPrintMutex);
-  pthread_mutex_destroy(&_kdTreeMutex);
-
-  if (_gridLoc != NULL)  {
-    cerr << "ERROR - ReorderInterp destructor, _gridLoc not NULL" << endl;
-  }
+  delete _pointIndex;
 
   _freeOutputArrays();
   _radarPoints.clear();
@@ -241,6 +253,10 @@ int ReorderInterp::interpVol()
   // compute the cartesian points for each gate
 
   _computeRadarPoints();
+
+  // keep or reset the least squares fits from the previous volume
+
+  _updateFitCache();
   
   // interpolate
 
@@ -250,10 +266,6 @@ int ReorderInterp::interpVol()
   _doInterp();
   _printRunTime("interpolation");
 
-  // transform for output
-
-  _transformForOutput();
-
   // write out data
 
   if (_writeOutputFile()) {
@@ -326,7 +338,6 @@ void ReorderInterp::_initThreads()
   // initialize compute object
 
   pthread_mutex_init(&_debugPrintMutex, NULL);
-  pthread_mutex_init(&_kdTreeMutex, NULL);
   
   if (_params.use_multiple_threads) {
     
@@ -458,74 +469,89 @@ void ReorderInterp::_computeRadarPoints()
   }
   beamHt.setInstrumentHtKm(_radarAltKm);
 
-  // Build the KD tree for 3D radar observations
-  
-  radar_point_t radarPt;
-  _radarPoints.clear();
+  // tag gates - the pattern does not depend on the ray length,
+  // so compute it once for the longest ray
 
-  // loop through rays
-  
-  for (size_t iray = 0; iray < _interpRays.size(); iray++) {
-    
-    const Ray *ray = _interpRays[iray];
-    double el = ray->el;
-    double az = ray->az;
-    
-    double sinAz, cosAz;
-    ta_sincos(az * DEG_TO_RAD, &sinAz, &cosAz);
-    
-    int nGates = ray->nGates;
-    double range = _startRangeKm;
-    int rayStartIndex = (int) _radarPoints.size();
+  size_t nRays = _interpRays.size();
+  int maxGates = 0;
+  for (size_t iray = 0; iray < nRays; iray++) {
+    maxGates = max(maxGates, _interpRays[iray]->nGates);
+  }
+  _computeTagGates(maxGates);
+
+  // count the points in each ray, below the max ht, to size the
+  // point array - rays in parallel
+
+  _rayPointStart.assign(nRays + 1, 0);
+  tbb::parallel_for(tbb::blocked_range<size_t>(0, nRays),
+                    [&](const tbb::blocked_range<size_t> &r) {
+    BeamHeight rayBeamHt(beamHt);
+    for (size_t iray = r.begin(); iray != r.end(); ++iray) {
+      const Ray *ray = _interpRays[iray];
+      int nPts = 0;
+      double range = _startRangeKm;
+      for (int igate = 0; igate < ray->nGates;
+           igate++, range += _gateSpacingKm) {
+        if (rayBeamHt.computeHtKm(ray->el, range) <= searchMaxZ) {
+          nPts++;
+        }
+      }
+      _rayPointStart[iray + 1] = nPts;
+    }
+  });
+  for (size_t iray = 0; iray < nRays; iray++) {
+    _rayPointStart[iray + 1] += _rayPointStart[iray];
+  }
 
-    _computeTagGates(nGates);
+  // compute the points, each ray into its own slots
 
-    for (int igate = 0; igate < nGates; igate++, range += _gateSpacingKm) {
-      
-      double xx = range * sinAz;
-      double yy = range * cosAz;
-      double zz = beamHt.computeHtKm(el, range);
+  _radarPoints.resize(_rayPointStart[nRays]);
+  tbb::parallel_for(tbb::blocked_range<size_t>(0, nRays),
+                    [&](const tbb::blocked_range<size_t> &r) {
+    BeamHeight rayBeamHt(beamHt);
+    for (size_t iray = r.begin(); iray != r.end(); ++iray) {
 
-      if (zz > searchMaxZ) {
-        continue;
-      }
+      const Ray *ray = _interpRays[iray];
+      double el = ray->el;
+      double az = ray->az;
+    
+      double sinAz, cosAz;
+      ta_sincos(az * DEG_TO_RAD, &sinAz, &cosAz);
 
-      radarPt.xx = xx;
-      radarPt.yy = yy;
-      radarPt.zz = zz;
-      radarPt.iray = iray;
-      radarPt.igate = igate;
-      radarPt.ray = ray;
+      int rayStartIndex = _rayPointStart[iray];
+      int rayEndIndex = _rayPointStart[iray + 1] - 1;
+      int index = rayStartIndex;
+      double range = _startRangeKm;
 
-      // tag the gates that will be used in the
-      // kd tree to find the closest rays
-      
-      if (_tagGates[igate]) {
-        radarPt.isTagPt = true;
-      } else {
-        radarPt.isTagPt = false;
-      }
+      for (int igate = 0; igate < ray->nGates;
+           igate++, range += _gateSpacingKm) {
       
-      radarPt.index = (int) _radarPoints.size();
-      _radarPoints.push_back(radarPt);
-
-    } // igate
-
+        double zz = rayBeamHt.computeHtKm(el, range);
+        if (zz > searchMaxZ) {
+          continue;
+        }
 
-    for (size_t ii = 0; ii < _tagGates.size(); ii++) {
-    }
+        radar_point_t &radarPt = _radarPoints[index];
+        radarPt.xx = range * sinAz;
+        radarPt.yy = range * cosAz;
+        radarPt.zz = zz;
+        radarPt.iray = iray;
+        radarPt.igate = igate;
+        radarPt.ray = ray;
 
-    // set ray index limits on each point
+        // tag the gates that will be used in the
+        // kd tree to find the closest rays
+      
+        radarPt.isTagPt = _tagGates[igate];
+        radarPt.index = index;
+        radarPt.rayStartIndex = rayStartIndex;
+        radarPt.rayEndIndex = rayEndIndex;
+        index++;
 
-    int rayEndIndex = (int) _radarPoints.size() - 1;
-    
-    for (int ii = rayStartIndex; ii <= rayEndIndex; ii++) {
-      radar_point_t &pt = _radarPoints[ii];
-      pt.rayStartIndex = rayStartIndex;
-      pt.rayEndIndex = rayEndIndex;
-    }
+      } // igate
 
-  } // iray
+    } // iray
+  });
   
   _printRunTime("Reorder - computing radar point locations");
   
@@ -608,7 +634,8 @@ void ReorderInterp::_computeGridRelative()
 
   if (fabs(_prevRadarLat - _radarLat) < 0.00001 &&
       fabs(_prevRadarLon - _radarLon) < 0.00001 &&
-      fabs(_prevRadarAltKm - _radarAltKm) < 0.00001) {
+      fabs(_prevRadarAltKm - _radarAltKm) < 0.00001 &&
+      _gridLocs.isAllocated()) {
     return;
   }
 
@@ -636,6 +663,18 @@ void ReorderInterp::_computeGridRelative()
 
   _initProjection();
 
+  // compute the grid locations, rows in parallel
+
+  if (!_gridLocs.isAllocated()) {
+    _gridLocs.alloc(_gridNz, _gridNy, _gridNx);
+  }
+  tbb::parallel_for(tbb::blocked_range<int>(0, _gridNz * _gridNy),
+                    [this](const tbb::blocked_range<int> &r) {
+    for (int irow = r.begin(); irow != r.end(); ++irow) {
+      _computeGridRelRow(irow / _gridNy, irow % _gridNy);
+    }
+  });
+
   _printRunTime("computing grid");
 
 }
@@ -643,7 +682,7 @@ void ReorderInterp::_computeGridRelative()
 ////////////////////////////////////////////////////////////
 // Compute grid relative locations for one row
 
-void ReorderInterp::_computeGridRelRow(int iz, int iy, GridLoc **locIn)
+void ReorderInterp::_computeGridRelRow(int iz, int iy)
 {
 
   // initialize beamHeight computations
@@ -686,74 +725,100 @@ void ReorderInterp::_computeGridRelRow(int iz, int iy, GridLoc **locIn)
     double yyInstr = gndRange * cosAz;
     double zzInstr = zz - _radarAltKm;
 
-    GridLoc *loc = locIn[ix];
-    loc->el = elevDeg;
-    loc->az = azimuth;
-    loc->slantRange = beamHt.getSlantRangeKm();
+    size_t ii = _gridLocs.index(iz, iy, ix);
+    _gridLocs.el[ii] = elevDeg;
+    _gridLocs.az[ii] = azimuth;
+    _gridLocs.slantRange[ii] = beamHt.getSlantRangeKm();
+    _gridLocs.gndRange[ii] = gndRange;
 
-    loc->xxInstr = xxInstr;
-    loc->yyInstr = yyInstr;
-    loc->zzInstr = zzInstr;
-    loc->zz = zz;
+    _gridLocs.xxInstr[ii] = xxInstr;
+    _gridLocs.yyInstr[ii] = yyInstr;
+    _gridLocs.zzInstr[ii] = zzInstr;
+    _gridLocs.zz[ii] = zz;
     
   } // ix
 
 }
 
 //////////////////////////////////////////////////
-// build the KD tree for ray tag points
+// build the spatial index for ray tag points
 
-void ReorderInterp::_buildKdTree()
+void ReorderInterp::_buildSpatialIndex()
 {
 
-  for (size_t ipt = 0; ipt < _radarPoints.size(); ipt++) {
-    
-    radar_point_t radarPt = _radarPoints[ipt];
-    if (!radarPt.isTagPt) {
-      continue;
+  // count the tag points in each ray, then copy them
+  // and their coordinates - rays in parallel
+
+  size_t nRays = _rayPointStart.size() - 1;
+  vector<int> tagStart(nRays + 1, 0);
+  tbb::parallel_for(tbb::blocked_range<size_t>(0, nRays),
+                    [&](const tbb::blocked_range<size_t> &r) {
+    for (size_t iray = r.begin(); iray != r.end(); ++iray) {
+      int nTags = 0;
+      for (int ipt = _rayPointStart[iray];
+           ipt < _rayPointStart[iray + 1]; ipt++) {
+        if (_radarPoints[ipt].isTagPt) {
+          nTags++;
+        }
+      }
+      tagStart[iray + 1] = nTags;
     }
-    
-    double xx = radarPt.xx;
-    double yy = radarPt.yy;
-
-    KD_real *kdPt = new KD_real[KD_DIM];
-    kdPt[0] = radarPt.zz / _zSearchRatio;
-    kdPt[1] = yy;
-    kdPt[2] = xx;
-    _kdVec.push_back(kdPt);
-    _tagPoints.push_back(radarPt);
-      
-  } // ipt
-  
-  // create array of pointers to the pts in the vector
-  
-  _kdMat = new KD_real*[_kdVec.size()];
-  for (size_t ii = 0; ii < _kdVec.size(); ii++) {
-    _kdMat[ii] = _kdVec[ii];
+  });
+  for (size_t iray = 0; iray < nRays; iray++) {
+    tagStart[iray + 1] += tagStart[iray];
+  }
+
+  _tagPoints.resize(tagStart[nRays]);
+  vector<double> coords(_tagPoints.size() * 3);
+  tbb::parallel_for(tbb::blocked_range<size_t>(0, nRays),
+                    [&](const tbb::blocked_range<size_t> &r) {
+    for (size_t iray = r.begin(); iray != r.end(); ++iray) {
+      int itag = tagStart[iray];
+      for (int ipt = _rayPointStart[iray];
+           ipt < _rayPointStart[iray + 1]; ipt++) {
+        const radar_point_t &radarPt = _radarPoints[ipt];
+        if (!radarPt.isTagPt) {
+          continue;
+        }
+        coords[itag * 3] = radarPt.zz / _zSearchRatio;
+        coords[itag * 3 + 1] = radarPt.yy;
+        coords[itag * 3 + 2] = radarPt.xx;
+        _tagPoints[itag] = radarPt;
+        itag++;
+      }
+    }
+  });
+
+  int maxTagGate = 0;
+  for (size_t itag = 0; itag < _tagPoints.size(); itag++) {
+    maxTagGate = max(maxTagGate, _tagPoints[itag].igate);
   }
   
-  _kdTree = new KD_tree((const KD_real **) _kdMat, _kdVec.size(), KD_DIM);
-  _printRunTime("building KD tree");
+  _pointIndex->build(coords.data(), _tagPoints.size());
+
+  // no search radius can exceed that at the farthest tag point
+
+  double maxRange = _startRangeKm + maxTagGate * _gateSpacingKm;
+  double maxDist = _params.reorder_search_radius_km;
+  if (_params.reorder_scale_search_radius_with_range) {
+    maxDist *= (maxRange / _params.reorder_nominal_range_for_search_radius_km);
+  }
+  if (maxDist < 1.0) {
+    maxDist = 1.0;
+  }
+  _maxSearchDistSq = maxDist * maxDist;
 
+  _printRunTime("building spatial index");
   
 }
 
 //////////////////////////////////////////////////
-// free the KD tree
+// free the spatial index
 
-void ReorderInterp::_freeKdTree()
+void ReorderInterp::_freeSpatialIndex()
 {
 
-  delete _kdTree;
-  _kdTree = NULL;
-  
-  delete[] _kdMat;
-  _kdMat = NULL;
-  
-  for (size_t ii = 0; ii < _kdVec.size(); ii++) {
-    delete[] _kdVec[ii];
-  }
-  _kdVec.clear();
+  _pointIndex->clear();
   _tagPoints.clear();
 
 }
@@ -768,9 +833,9 @@ void ReorderInterp::_doInterp()
 
   _initOutputArrays();
 
-  // build the KD tree
+  // build the spatial index
 
-  _buildKdTree();
+  _buildSpatialIndex();
   
   // perform interpolation
 
@@ -780,9 +845,9 @@ void ReorderInterp::_doInterp()
     _interpSingleThreaded();
   }
 
-  // free up the KD tree
+  // free up the spatial index
 
-  _freeKdTree();
+  _freeSpatialIndex();
   
 }
 
@@ -981,78 +1046,53 @@ void ReorderInterp::_interpPlane(int iz)
 
 {
 
-  // allocate the GridLoc array for this plane and set values
-  GridLoc ***gridLoc = 
-    (GridLoc ***)umalloc2(_gridNy, _gridNx, sizeof(GridLoc *));
-  
-  for (int iy = 0; iy < _gridNy; iy++) {
-    for (int ix = 0; ix < _gridNx; ix++) {
-      gridLoc[iy][ix] = new GridLoc;
-    }
-    _computeGridRelRow(iz, iy, gridLoc[iy]);
-  }
-
-  // copy the KD tree
-
-  pthread_mutex_lock(&_kdTreeMutex);
-  KD_tree kdTree(*_kdTree);
-  pthread_mutex_unlock(&_kdTreeMutex);
-  
   // init
   
   int nNeighbors = _params.reorder_npoints_search;
   
-  TaArray<int> tagIndexes_;
-  int *tagIndexes = tagIndexes_.alloc(nNeighbors);
-  
-  TaArray<KD_real> distSq_;
-  KD_real *distSq = distSq_.alloc(nNeighbors);
-
-  // create a vector of neighbor details, one for each
-  // point in the row
-  
+  vector<double> queryLocs(_gridNx * SpatialIndex::DIM);
+  vector<int> queryIx(_gridNx);
+  vector<int> tagIndexes(_gridNx * nNeighbors);
+  vector<double> distSq(_gridNx * nNeighbors);
+  vector<int> nFound(_gridNx);
 
   for (int iy = 0; iy < _gridNy; iy++) {
-    for (int ix = 0; ix < _gridNx; ix++) {
+
+    // set the query locations for the points in range in this row
     
-      NeighborProps *neighborProps = new NeighborProps;
-      
-      // get the grid location
-      
-      neighborProps->iz = iz;
-      neighborProps->iy = iy;
-      neighborProps->ix = ix;
-      neighborProps->loc = gridLoc[iy][ix];
-      if (neighborProps->loc->slantRange > _maxRangeKm) {
-        delete neighborProps;
+    int nQuery = 0;
+    size_t rowStart = _gridLocs.index(iz, iy, 0);
+    for (int ix = 0; ix < _gridNx; ix++) {
+      size_t ii = rowStart + ix;
+      if (_gridLocs.slantRange[ii] > _maxRangeKm) {
         continue;
       }
-      
-      // set the query location
-      
-      KD_real queryLoc[KD_DIM];
-      queryLoc[0] = neighborProps->loc->zz / _zSearchRatio;
-      queryLoc[1] = neighborProps->loc->yyInstr;
-      queryLoc[2] = neighborProps->loc->xxInstr;
-      
-      // initialize tagIndexes
-      for (int ii = 0; ii < nNeighbors; ii++) {
-        tagIndexes[ii] = -1;
+      double *queryLoc = &queryLocs[nQuery * SpatialIndex::DIM];
+      queryLoc[0] = _gridLocs.zz[ii] / _zSearchRatio;
+      queryLoc[1] = _gridLocs.yyInstr[ii];
+      queryLoc[2] = _gridLocs.xxInstr[ii];
+      queryIx[nQuery] = ix;
+      nQuery++;
+    }
+
+    // find nearest neighbors for the whole row, each search
+    // bounded by the neighbors of the previous point
+
+    _pointIndex->knnBatch(queryLocs.data(), nQuery, nNeighbors,
+                          _maxSearchDistSq, tagIndexes.data(),
+                          distSq.data(), nFound.data());
+
+    for (int iq = 0; iq < nQuery; iq++) {
+
+      if (nFound[iq] == 0) {
+        continue;
       }
+      const int *cellIndexes = &tagIndexes[iq * nNeighbors];
+      const double *cellDistSq = &distSq[iq * nNeighbors];
       
-      // get closest point from KD tree, and check distance
+      // check distance of closest point
       
-      kdTree.nnquery(queryLoc, // query location
-                     1, // get only 1 point
-                     KD_EUCLIDEAN, // search metric
-                     1, // Minkowski parameter
-                     tagIndexes, // out: indices of nearest nbrs
-                     distSq); // out: squares of distances of nbrs
-
-      if (tagIndexes[0] >= (int) _tagPoints.size()) {
-        continue;
-      }
-      const radar_point_t &closestPt = _tagPoints[tagIndexes[0]];
+      const radar_point_t &closestPt = _tagPoints[cellIndexes[0]];
       double range = _startRangeKm + closestPt.igate * _gateSpacingKm;
       double dtest = _params.reorder_search_radius_km;
       if (_params.reorder_scale_search_radius_with_range) {
@@ -1062,51 +1102,33 @@ void ReorderInterp::_interpPlane(int iz)
         dtest = 1.0;
       }
       double dtestSq = dtest * dtest;
-      if (distSq[0] > dtestSq) {
+      if (cellDistSq[0] > dtestSq) {
         // the closest point is greater than dtest away from cell
         // so don't process this cell
-        delete neighborProps;
         continue;
       }
       
-      // Find nearest neighbors
-      
-      kdTree.nnquery(queryLoc, // query location
-                     nNeighbors, // number of neighbors to search for
-                     KD_EUCLIDEAN, // search metric
-                     1, // Minkowski parameter
-                     tagIndexes, // out: indices of nearest nbrs
-                     distSq); // out: squares of distances of nbrs
+      int ix = queryIx[iq];
+      GridLoc loc = _gridLocs.get(rowStart + ix);
+      NeighborProps neighborProps;
+      neighborProps.iz = iz;
+      neighborProps.iy = iy;
+      neighborProps.ix = ix;
+      neighborProps.loc = &loc;
       
-      for (int jj = 0; jj < nNeighbors; jj++) {
-        int tagIndex = tagIndexes[jj];
-        if (tagIndex < 0) {
-          continue;
-        }
-        if (distSq[jj] <= dtestSq) {
-          neighborProps->tagIndexes.push_back(tagIndex);
-          neighborProps->distSq.push_back(distSq[jj]);
+      for (int jj = 0; jj < nFound[iq]; jj++) {
+        if (cellDistSq[jj] <= dtestSq) {
+          neighborProps.tagIndexes.push_back(cellIndexes[jj]);
+          neighborProps.distSq.push_back(cellDistSq[jj]);
         } else {
           // no more
           break;
         }
       }
       
-      _interpPoint(*neighborProps, *gridLoc[iy][ix]);
-      delete neighborProps;
-    } // ix
+      _interpPoint(neighborProps, loc);
+    } // iq
   } // iy
-  
-
-  //
-  // delete the GridLoc array
-  //
-  for (int iy = 0; iy < _gridNy; iy++) {
-    for (int ix = 0; ix < _gridNx; ix++) {
-      delete gridLoc[iy][ix];
-    }
-  }
-  ufree2((void **) gridLoc);
 
   char buf[1000];
   sprintf(buf, "interpolating plane %d", iz);
@@ -1237,16 +1259,12 @@ void ReorderInterp::_interpPoint(const NeighborProps &neighborProps,
   int iy = neighborProps.iy;
   int ix = neighborProps.ix;
 
-  //
-  // If sharing Svd between all fields, create object now, otherwise
-  // leave NULL
-  //
-  // SvdData *svd = NULL;
-  // if (!_params.full_svd)
-  // {
-  //   svd = new SvdData(interpPts, pointLoc.xxInstr, pointLoc.yyInstr,
-  // 		      pointLoc.zz);
-  // }
+  // least squares fits, factored once for each set of points with
+  // data and shared by the fields - reserved so that pointers to the
+  // entries stay valid
+
+  vector<fit_entry_t> fits;
+  fits.reserve(_interpFields.size());
 
   // interpolate fields
   
@@ -1263,19 +1281,15 @@ void ReorderInterp::_interpPoint(const NeighborProps &neighborProps,
 	}
       } else {
 	if (_interpFields[ifield].fieldFolds) {
-	  _computeFoldedGridPt(ifield, iz, iy, ix, pointLoc, interpPts);
+	  _computeFoldedGridPt(ifield, iz, iy, ix, pointLoc, interpPts, fits);
 	} else {
-	  _computeInterpGridPt(ifield, iz, iy, ix, pointLoc, interpPts);
+	  _computeInterpGridPt(ifield, iz, iy, ix, pointLoc, interpPts, fits);
 	}
       }
     }
     
   } // ifield
 
-  // if (!_params.full_svd)
-  // {
-  //   delete svd;
-  // }
 }
 
 ///////////////////////////////////////////////////////
@@ -1447,7 +1461,8 @@ void ReorderInterp::_computeNearestGridPt(int ifield,
   int gridPtIndex = iz * _nPointsPlane + iy * _gridNx + ix;
 
   if (nContrib > 0) {
-    _outputFields[ifield][gridPtIndex] = closestVal;
+    _outputFields[ifield][gridPtIndex] =
+      _outputVal(_interpFields[ifield], closestVal);
   } else {
     _outputFields[ifield][gridPtIndex] = missingFl32;
   }
@@ -1460,14 +1475,16 @@ void ReorderInterp::_computeNearestGridPt(int ifield,
 void ReorderInterp::_computeInterpGridPt(int ifield,
                                          int iz, int iy, int ix,
 					 const GridLoc &loc,
-                                         const vector<radar_point_t> &interpPts)
+                                         const vector<radar_point_t> &interpPts,
+                                         vector<fit_entry_t> &fits)
   
 {
   double v;
-  bool good = _computeSvd(ifield, iz, iy, ix, loc, interpPts, v);
+  bool good = _computeSvd(ifield, iz, iy, ix, loc, interpPts, fits, v);
   int gridPtIndex = iz * _nPointsPlane + iy * _gridNx + ix;
   if (good) {
-    _outputFields[ifield][gridPtIndex] = v;
+    _outputFields[ifield][gridPtIndex] =
+      _outputVal(_interpFields[ifield], v);
   } else {
     _outputFields[ifield][gridPtIndex] = missingFl32;
   }
@@ -1477,44 +1494,39 @@ bool
 ReorderInterp::_computeSvd(int ifield, int iz, int iy, int ix, 
 			   const GridLoc &loc,
 			   const vector<radar_point_t> &interpPts,
+                           vector<fit_entry_t> &fits,
 			   double &v)
 {
-  // copy the interp points
-  vector<radar_point_t> newInterpPts(interpPts);
-
   // try to collect all data
+  vector<int> used;
   vector<double> b;
-  bool good = _collectLocalData(ifield, newInterpPts, loc, b);
+  bool good = _collectLocalData(ifield, interpPts, loc, used, b);
   if (good) {
-    SvdData svd(newInterpPts, loc.xxInstr, loc.yyInstr, loc.zz);
-    if (!svd.isOk()) {
-      cerr << "ERROR _computeSvd - Could not create SVD" << endl;
+    int gridPtIndex = iz * _nPointsPlane + iy * _gridNx + ix;
+    const FitFactor *fit = _getFit(gridPtIndex, interpPts, used, loc, fits);
+    if (fit == NULL) {
+      cerr << "ERROR _computeSvd - Could not factor the fit" << endl;
       return false;
     }
-    if (svd.compute(b)) {
-      // return constant term which is the last (3rd) one
-      v = svd.getTerm(3);
-      const Field &intFld = _interpFields[ifield];
-      if (intFld.isBounded) {
-	if (v < intFld.boundLimitLower || v > intFld.boundLimitUpper) {
-	  if (_params.debug >= Params::DEBUG_VERBOSE) {
-	    cerr << "Data field " << ifield << " out of bounds " << v << endl;
-	  }
-	  return false;
-	}
-      }
-      // check limits
-      double minVal, maxVal;
-      _computeMinMax(b, minVal, maxVal);
-      if (v < minVal || v > maxVal) {
-        v = missingDouble;
+    // return constant term which is the last (3rd) one
+    v = _linearFitValue(*fit, interpPts, used, loc, b);
+    const Field &intFld = _interpFields[ifield];
+    if (intFld.isBounded) {
+      if (v < intFld.boundLimitLower || v > intFld.boundLimitUpper) {
+        if (_params.debug >= Params::DEBUG_VERBOSE) {
+          cerr << "Data field " << ifield << " out of bounds " << v << endl;
+        }
         return false;
       }
-      return true;
-    } else {
-      cerr << "ERROR _computeSvd - Could not compute SVD" << endl;
+    }
+    // check limits
+    double minVal, maxVal;
+    _computeMinMax(b, minVal, maxVal);
+    if (v < minVal || v > maxVal) {
+      v = missingDouble;
       return false;
     }
+    return true;
   } else {
     if (_params.debug  >= Params::DEBUG_VERBOSE) {
       cerr << "Not enough local data" << endl;
@@ -1546,6 +1558,132 @@ void ReorderInterp::_computeMinMax(const vector<double> &bb,
   }
 }
 
+/////////////////////////////////////////////////////
+// get the linear fit to the points with data about a grid point,
+// factoring it only if no other field has data at the same points,
+// and it is not cached from the previous volume.
+// Returns NULL if the fit cannot be factored.
+
+const ReorderInterp::FitFactor *
+ReorderInterp::_getFit(int gridPtIndex,
+                       const vector<radar_point_t> &interpPts,
+                       const vector<int> &used,
+                       const GridLoc &loc,
+                       vector<fit_entry_t> &fits)
+{
+
+  // data at every point - use the cache if active
+
+  if (used.size() == interpPts.size() && !_fitCacheIndex.empty()) {
+    int &index = _fitCacheIndex[gridPtIndex];
+    if (index < 0) {
+      LinearFit fit;
+      cached_fit_t cached;
+      cached.ok = _factorLinearFit(interpPts, used, loc, fit);
+      cached.fit = fit.getFactor();
+      index = (int) (_fitCache.push_back(cached) - _fitCache.begin());
+    }
+    const cached_fit_t &cached = _fitCache[index];
+    return cached.ok ? &cached.fit : NULL;
+  }
+
+  // factored already for another field?
+
+  for (size_t ii = 0; ii < fits.size(); ii++) {
+    if (fits[ii].used == used) {
+      return fits[ii].ok ? &fits[ii].fit.getFactor() : NULL;
+    }
+  }
+
+  fit_entry_t entry;
+  entry.used = used;
+  entry.ok = _factorLinearFit(interpPts, used, loc, entry.fit);
+  fits.push_back(entry);
+  return entry.ok ? &fits.back().fit.getFactor() : NULL;
+
+}
+
+/////////////////////////////////////////////////////
+// keep the cached fits if the geometry is unchanged since the
+// previous volume, otherwise reset them
+
+void ReorderInterp::_updateFitCache()
+{
+
+  if (!_params.reorder_reuse_fits_across_volumes ||
+      _params.reorder_weighted_interpolation) {
+    _fitCache.clear();
+    _fitCacheIndex.clear();
+    return;
+  }
+
+  // the radar location, search radius and radar points determine
+  // the points around every grid point
+
+  uint64_t key = 14695981039346656037ULL;
+  _hashValue(key, _radarLat);
+  _hashValue(key, _radarLon);
+  _hashValue(key, _radarAltKm);
+  _hashValue(key, _maxSearchRadius);
+  for (size_t ii = 0; ii < _radarPoints.size(); ii++) {
+    const radar_point_t &pt = _radarPoints[ii];
+    _hashValue(key, pt.xx);
+    _hashValue(key, pt.yy);
+    _hashValue(key, pt.zz);
+    _hashValue(key, pt.iray);
+    _hashValue(key, pt.igate);
+  }
+
+  if (key == _fitCacheKey && (int) _fitCacheIndex.size() == _nPointsVol) {
+    if (_params.debug) {
+      cerr << "  Geometry unchanged, reusing least squares fits" << endl;
+    }
+    return;
+  }
+
+  _fitCache.clear();
+  _fitCacheIndex.assign(_nPointsVol, -1);
+  _fitCacheKey = key;
+
+}
+
+/////////////////////////////////////////////////////
+// factor the linear fit to the points about a grid point
+
+bool ReorderInterp::_factorLinearFit(const vector<radar_point_t> &pts,
+                                     const vector<int> &used,
+                                     const GridLoc &loc, LinearFit &fit)
+{
+  fit.reset();
+  for (size_t ii = 0; ii < used.size(); ii++) {
+    double row[4];
+    _setFitRow(pts[used[ii]], loc, row);
+    fit.addRow(row);
+  }
+  return fit.factor();
+}
+
+/////////////////////////////////////////////////////
+// value of the linear fit at the grid point - the constant term -
+// for data values b at the points
+
+double ReorderInterp::_linearFitValue(const FitFactor &fit,
+                                      const vector<radar_point_t> &pts,
+                                      const vector<int> &used,
+                                      const GridLoc &loc,
+                                      const vector<double> &b)
+{
+  double atb[4] = {0.0, 0.0, 0.0, 0.0};
+  for (size_t ii = 0; ii < used.size(); ii++) {
+    double row[4];
+    _setFitRow(pts[used[ii]], loc, row);
+    LinearFit::addRhs(row, b[ii], atb);
+  }
+  double coeffs[4];
+  fit.solve(atb, coeffs);
+  return coeffs[3];
+}
+
 /////////////////////////////////////////////////////
 // load up data for a grid point using interpolation
 
@@ -1591,7 +1729,8 @@ ReorderInterp::_computeWeightedInterpGridPt(int ifield,
     if (sumWtsValid > 0) {
       interpVal = sumVals / sumWtsValid;
     }
-    _outputFields[ifield][gridPtIndex] = interpVal;
+    _outputFields[ifield][gridPtIndex] =
+      _outputVal(_interpFields[ifield], interpVal);
   } else {
     _outputFields[ifield][gridPtIndex] = missingFl32;
   }
@@ -1604,62 +1743,46 @@ ReorderInterp::_computeWeightedInterpGridPt(int ifield,
 void ReorderInterp::_computeFoldedGridPt(int ifield,
                                          int iz, int iy, int ix,
 					 const GridLoc &loc,
-                                         const vector<radar_point_t> &interpPts)
+                                         const vector<radar_point_t> &interpPts,
+                                         vector<fit_entry_t> &fits)
   
 {
-  // copy interp points
-  vector<radar_point_t> newInterpPts(interpPts);
-
   // try to collect all data
+  vector<int> used;
   vector<double> x, y;
-  bool good = _collectLocalFoldedData(ifield, newInterpPts, x, y);
+  bool good = _collectLocalFoldedData(ifield, interpPts, used, x, y);
   double xfit=0, yfit=0;
+  int gridPtIndex = iz * _nPointsPlane + iy * _gridNx + ix;
   if (good) {
-    SvdData info(newInterpPts, loc.xxInstr, loc.yyInstr, loc.zz);
-    if (info.isOk())
-    {
-      if (info.compute(x)) {
-	// return constant term which is the last (3rd) one
-	xfit = info.getTerm(3);
-        // check limits
-        double minVal, maxVal;
-        _computeMinMax(x, minVal, maxVal);
-        if (xfit < minVal || xfit > maxVal) {
-          good = false;
-        }
-      } else {
-	cerr << "ERROR _computeFoldedGridPt " << endl;
-	cerr << "Could not compute SVD result" << endl;
-	good = false;
+    const FitFactor *fit = _getFit(gridPtIndex, interpPts, used, loc, fits);
+    if (fit != NULL) {
+      // return constant term which is the last (3rd) one
+      xfit = _linearFitValue(*fit, interpPts, used, loc, x);
+      yfit = _linearFitValue(*fit, interpPts, used, loc, y);
+      // check limits
+      double minVal, maxVal;
+      _computeMinMax(x, minVal, maxVal);
+      if (xfit < minVal || xfit > maxVal) {
+        good = false;
       }
-      if (info.compute(y)) {
-	// return constant term which is the last (3rd) one
-	yfit = info.getTerm(3);
-        // check limits
-        double minVal, maxVal;
-        _computeMinMax(y, minVal, maxVal);
-        if (yfit < minVal || yfit > maxVal) {
-          good = false;
-        }
-      } else {
-	cerr << "ERROR _computeFoldedGridPt " << endl;
-	cerr << "Could not compute SVD result" << endl;
-	good = false;
+      _computeMinMax(y, minVal, maxVal);
+      if (yfit < minVal || yfit > maxVal) {
+        good = false;
       }
     } else {
       good = false;
       cerr << "ERROR _computeFoldedGridPt " << endl;
-      cerr << "Could not create SVD data" << endl;
+      cerr << "Could not factor the fit" << endl;
     }
   }
 
-  int gridPtIndex = iz * _nPointsPlane + iy * _gridNx + ix;
   if (good) {
     double angleInterp = atan2(yfit, xfit);
     const Field &intFld = _interpFields[ifield];
     double valInterp = _getFoldValue(angleInterp,
                                      intFld.foldLimitLower, intFld.foldRange);
-    _outputFields[ifield][gridPtIndex] = valInterp;
+    _outputFields[ifield][gridPtIndex] =
+      _outputVal(_interpFields[ifield], valInterp);
   } else {
     _outputFields[ifield][gridPtIndex] = missingFl32;
   }
@@ -1714,7 +1837,8 @@ ReorderInterp::_computeWeightedFoldedGridPt(int ifield,
     double angleInterp = atan2(sumY, sumX);
     double valInterp = _getFoldValue(angleInterp,
                                      intFld.foldLimitLower, intFld.foldRange);
-    _outputFields[ifield][gridPtIndex] = valInterp;
+    _outputFields[ifield][gridPtIndex] =
+      _outputVal(_interpFields[ifield], valInterp);
   } else {
     _outputFields[ifield][gridPtIndex] = missingFl32;
   }
@@ -1725,14 +1849,15 @@ ReorderInterp::_computeWeightedFoldedGridPt(int ifield,
 // load up data for a grid point using interpolation
 
 bool ReorderInterp::_collectLocalData(int ifield, 
-				      vector<radar_point_t> &interpPts,
+				      const vector<radar_point_t> &interpPts,
 				      const GridLoc &loc,
+				      vector<int> &used,
 				      vector<double> &b) const
 {
   bool good = true;
   int numGood = 0;
+  used.clear();
   b.clear();
-  vector<radar_point_t> iPts;
   bool above=false;
   bool below=false;
   for (size_t ii = 0; ii < interpPts.size(); ii++) {
@@ -1749,7 +1874,7 @@ bool ReorderInterp::_collectLocalData(int ifield,
 	  below = true;
 	}
 	b.push_back(v);
-	iPts.push_back(interpPts[ii]);
+	used.push_back((int) ii);
 	numGood ++;
       }
     } else {
@@ -1773,7 +1898,6 @@ bool ReorderInterp::_collectLocalData(int ifield,
       good = false;
     }
   }
-  interpPts = iPts;
   return good;
 }
 
@@ -1782,15 +1906,16 @@ bool ReorderInterp::_collectLocalData(int ifield,
 // for a folded field
 
 bool ReorderInterp::_collectLocalFoldedData(int ifield, 
-					    vector<radar_point_t> &interpPts,
+					    const vector<radar_point_t> &interpPts,
+					    vector<int> &used,
 					    vector<double> &x,
 					    vector<double> &y) const
 {
   bool good = true;
 
+  used.clear();
   x.clear();
   y.clear();
-  vector<radar_point_t> iPts;
   const Field &intFld = _interpFields[ifield];
 
   for (size_t ii = 0; ii < interpPts.size(); ii++) {
@@ -1806,7 +1931,7 @@ bool ReorderInterp::_collectLocalFoldedData(int ifield,
 	ta_sincos(angle, &sinVal, &cosVal);
 	x.push_back(cosVal);
 	y.push_back(sinVal);
-	iPts.push_back(interpPts[ii]);
+	used.push_back((int) ii);
       }
     } else {
       good = false;
@@ -1823,7 +1948,6 @@ bool ReorderInterp::_collectLocalFoldedData(int ifield,
     }
     good = false;
   }
-  interpPts = iPts;
   return good;
 }
 
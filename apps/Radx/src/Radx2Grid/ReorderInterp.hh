@@ -38,8 +38,11 @@
 #define ReorderInterp_HH
 
 #include "Interp.hh"
-#include <kd/kd.hh>
+#include "LeastSquares.hh"
+#include "SpatialIndex.hh"
 #include <iostream>
+#include <stdint.h>
+#include <tbb/concurrent_vector.h>
 
 // class SvdData;
 
@@ -81,7 +84,6 @@ private:
   deque<ReorderThread *> _activeThreads;
   deque<ReorderThread *> _availThreads;
   pthread_mutex_t _debugPrintMutex;
-  pthread_mutex_t _kdTreeMutex;
   
   // keeping track of points in radar space
 
@@ -100,19 +102,18 @@ private:
     double distSq;
   } radar_point_t;
   vector<radar_point_t> _radarPoints;
+  vector<int> _rayPointStart; // first point of each ray, and the end
 
   typedef struct {
     radar_point_t first;
     radar_point_t second;
   } ray_closest_t;
   
-  // KD tree for radar points
-  
-  static const int KD_DIM = 3;
-  
-  vector<KD_real *> _kdVec;
-  KD_real **_kdMat;
-  KD_tree *_kdTree;
+  // index of the tag points, KD tree or buckets - read-only once
+  // built, so shared by the threads without locking
+
+  SpatialIndex *_pointIndex;
+  double _maxSearchDistSq; // bound on the search radius, squared
 
   // tag gates - use to identify rays closest to grid points
 
@@ -126,6 +127,33 @@ private:
   double _maxZ;
   double _zSearchRatio;
 
+  // linear fit v = v0 + a dx + b dy + c dz about a grid point,
+  // solved in fixed-size arrays. The fit depends only on the point
+  // locations, so it is factored once per set of points with data and
+  // shared by the fields.
+
+  typedef LeastSquares<4> LinearFit;
+  typedef LinearFit::Factor FitFactor;
+
+  typedef struct {
+    vector<int> used; // indexes of the points with data
+    LinearFit fit;
+    bool ok;
+  } fit_entry_t;
+
+  // fits to all the points around each grid point, kept for the next
+  // volume while the radar and gate locations are unchanged. Only the
+  // grid points fitted get an entry, added by the threads as they go;
+  // _fitCacheIndex holds the entry of each grid point, -1 if none.
+
+  typedef struct {
+    bool ok;
+    FitFactor fit;
+  } cached_fit_t;
+  tbb::concurrent_vector<cached_fit_t> _fitCache;
+  vector<int> _fitCacheIndex;
+  uint64_t _fitCacheKey;
+
   // class for point neighbors
 
   class NeighborProps {
@@ -150,10 +178,10 @@ private:
   void _computeTagGates(int nGates);
 
   void _computeGridRelative();
-  void _computeGridRelRow(int iz, int iy, GridLoc **loc);
+  void _computeGridRelRow(int iz, int iy);
 
-  void _buildKdTree();
-  void _freeKdTree();
+  void _buildSpatialIndex();
+  void _freeSpatialIndex();
 
   void _doInterp();
   void _interpSingleThreaded();
@@ -176,17 +204,42 @@ private:
   void _computeFoldedGridPt(int ifield,
                             int iz, int iy, int ix,
 			    const GridLoc &loc,
-                            const vector<radar_point_t> &interpPts);
+                            const vector<radar_point_t> &interpPts,
+                            vector<fit_entry_t> &fits);
   void _computeInterpGridPt(int ifield,
                             int iz, int iy, int ix,
 			    const GridLoc &loc,
-                            const vector<radar_point_t> &interpPts);
+                            const vector<radar_point_t> &interpPts,
+                            vector<fit_entry_t> &fits);
   // bool _computeInterpSvdLookup(SvdData *svd, 
   // 			       int ifield, int iz, int iy, int ix, 
   // 			       const vector<radar_point_t> &interpPts,
   // 			       double &v);
   bool _computeSvd(int ifield, int iz, int iy, int ix, const GridLoc &loc,
-		   const vector<radar_point_t> &interpPts, double &v);
+		   const vector<radar_point_t> &interpPts,
+                   vector<fit_entry_t> &fits, double &v);
+
+  const FitFactor *_getFit(int gridPtIndex,
+                           const vector<radar_point_t> &interpPts,
+                           const vector<int> &used, const GridLoc &loc,
+                           vector<fit_entry_t> &fits);
+  void _updateFitCache();
+  static bool _factorLinearFit(const vector<radar_point_t> &pts,
+                               const vector<int> &used,
+                               const GridLoc &loc, LinearFit &fit);
+  static double _linearFitValue(const FitFactor &fit,
+                                const vector<radar_point_t> &pts,
+                                const vector<int> &used,
+                                const GridLoc &loc,
+                                const vector<double> &b);
+  static inline void _setFitRow(const radar_point_t &pt, const GridLoc &loc,
+                                double *row) {
+    row[0] = pt.xx - loc.xxInstr;
+    row[1] = pt.yy - loc.yyInstr;
+    row[2] = pt.zz - loc.zz;
+    row[3] = 1.0;
+  }
+
   void _computeMinMax(const vector<double> &bb,
                       double &minVal, double &maxVal);
   void _computeWeightedFoldedGridPt(int ifield,
@@ -199,11 +252,13 @@ private:
   // bool _collectLocalData(int ifield, const vector<radar_point_t> &interpPts,
   // 			 vector<double> &b, double &missing) const;
 
-  bool _collectLocalData(int ifield, vector<radar_point_t> &interpPts,
-			 const GridLoc &loc, vector<double> &b) const;
+  bool _collectLocalData(int ifield, const vector<radar_point_t> &interpPts,
+			 const GridLoc &loc, vector<int> &used,
+                         vector<double> &b) const;
 
   bool _collectLocalFoldedData(int ifield, 
-			       vector<radar_point_t> &interpPts,
+			       const vector<radar_point_t> &interpPts,
+			       vector<int> &used,
 			       vector<double> &x,
 			       vector<double> &y) const;
 
@@ -35,6 +35,8 @@
 #include "OutputMdv.hh"
 #include <algorithm>
 #include <map>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
 #include <toolsa/pjg.h>
 #include <toolsa/mem.h>
 #include <toolsa/sincos.h>
@@ -64,12 +66,10 @@ SatInterp::SatInterp(const string &progName,
 {
 
   _prevRadarLat = _prevRadarLon = _prevRadarAltKm = -9999.0;
-  _gridLoc = NULL;
   _outputFields = NULL;
   _zSearchRatio = _params.reorder_z_search_ratio;
 
-  _kdTree = NULL;
-  _kdMat = NULL;
+  _pointIndex = SpatialIndex::create(_params);
 
   _tagStartRangeKm = -9999;
   _tagGateSpacingKm = -9999;
@@ -128,20 +128,7 @@ SatInterp::~SatInterp()
   }
 
   pthread_mutex_destroy(&_debugPrintMutex);
-  pthread_mutex_destroy(&_kdTreeMutex);
-
-  // free up grid
-
-  if (_gridLoc) {
-    for (int iz = 0; iz < _gridNz; iz++) {
-      for (int iy = 0; iy < _gridNy; iy++) {
-        for (int ix = 0; ix < _gridNx; ix++) {
-          delete _gridLoc[iz][iy][ix];
-        }
-      }
-    }
-    ufree3((void ***) _gridLoc);
-  }
+  delete _pointIndex;
 
   _freeOutputArrays();
   _instrPoints.clear();
@@ -251,16 +238,7 @@ void SatInterp::_initGrid()
   _gridMiny = _params.grid_xy_geom.miny;
   _gridDy = _params.grid_xy_geom.dy;
   
-  _gridLoc = (GridLoc ****)
-    umalloc3(_gridNz, _gridNy, _gridNx, sizeof(GridLoc *));
-  
-  for (int iz = 0; iz < _gridNz; iz++) {
-    for (int iy = 0; iy < _gridNy; iy++) {
-      for (int ix = 0; ix < _gridNx; ix++) {
-        _gridLoc[iz][iy][ix] = new GridLoc;
-      }
-    }
-  }
+  _gridLocs.alloc(_gridNz, _gridNy, _gridNx);
 
 }
   
@@ -273,7 +251,6 @@ void SatInterp::_initThreads()
   // initialize compute object
 
   pthread_mutex_init(&_debugPrintMutex, NULL);
-  pthread_mutex_init(&_kdTreeMutex, NULL);
   
   if (_params.use_multiple_threads) {
     
@@ -398,14 +375,15 @@ void SatInterp::_initOutputArrays()
 void SatInterp::_computeInstrPoints()
 {
   
-  // Build the KD tree for 3D instr observations
-  
-  instr_point_t instrPt;
-  _instrPoints.clear();
+  // instrument location for each ray - one projection per ray,
+  // since all its gates share it
 
-  // loop through rays
-  
-  for (size_t iray = 0; iray < _interpRays.size(); iray++) {
+  size_t nRays = _interpRays.size();
+  vector<double> rayXx(nRays), rayYy(nRays);
+  int maxGates = 0;
+  _rayPointStart.assign(nRays + 1, 0);
+
+  for (size_t iray = 0; iray < nRays; iray++) {
     
     const Ray *ray = _interpRays[iray];
     const RadxGeoref *georef = ray->inputRay->getGeoreference();
@@ -415,58 +393,59 @@ void SatInterp::_computeInstrPoints()
       lat = georef->getLatitude();
       lon = georef->getLongitude();
     }
-    
-    int nGates = ray->nGates;
-    double range = _startRangeKm;
-    double deltaRange  = _gateSpacingKm;
-    if (_params.sat_data_invert_in_range) {
-      range += nGates * _gateSpacingKm;
-      deltaRange *= -1.0;
-    }
-    int rayStartIndex = (int) _instrPoints.size();
+    _proj.latlon2xy(lat, lon, rayXx[iray], rayYy[iray]);
 
-    _computeTagGates(nGates);
+    maxGates = max(maxGates, ray->nGates);
+    _rayPointStart[iray + 1] = _rayPointStart[iray] + ray->nGates;
 
-    for (int igate = 0; igate < nGates; igate++, range += deltaRange) {
-      
-      double xx, yy;
-      _proj.latlon2xy(lat, lon, xx, yy);
+  } // iray
 
-      double zz = range;
-      
-      instrPt.xx = xx;
-      instrPt.yy = yy;
-      instrPt.zz = zz;
-      instrPt.iray = iray;
-      instrPt.igate = igate;
-      instrPt.ray = ray;
-
-      // tag the gates that will be used in the
-      // kd tree to find the closest rays
-      
-      if (_tagGates[igate]) {
-        instrPt.isTagPt = true;
-      } else {
-        instrPt.isTagPt = false;
-      }
-      
-      instrPt.index = (int) _instrPoints.size();
-      _instrPoints.push_back(instrPt);
+  // tag gates - the pattern does not depend on the ray length,
+  // so compute it once for the longest ray
 
-    } // igate
+  _computeTagGates(maxGates);
 
+  // compute the points, rays in parallel, each into its own slots
 
-    // set ray index limits on each point
+  _instrPoints.resize(_rayPointStart[nRays]);
+  tbb::parallel_for(tbb::blocked_range<size_t>(0, nRays),
+                    [&](const tbb::blocked_range<size_t> &r) {
+    for (size_t iray = r.begin(); iray != r.end(); ++iray) {
 
-    int rayEndIndex = (int) _instrPoints.size() - 1;
-    
-    for (int ii = rayStartIndex; ii <= rayEndIndex; ii++) {
-      instr_point_t &pt = _instrPoints[ii];
-      pt.rayStartIndex = rayStartIndex;
-      pt.rayEndIndex = rayEndIndex;
-    }
+      const Ray *ray = _interpRays[iray];
+      int nGates = ray->nGates;
+      double range = _startRangeKm;
+      double deltaRange  = _gateSpacingKm;
+      if (_params.sat_data_invert_in_range) {
+        range += nGates * _gateSpacingKm;
+        deltaRange *= -1.0;
+      }
+      int rayStartIndex = _rayPointStart[iray];
+      int rayEndIndex = _rayPointStart[iray + 1] - 1;
 
-  } // iray
+      for (int igate = 0; igate < nGates; igate++, range += deltaRange) {
+      
+        int index = rayStartIndex + igate;
+        instr_point_t &instrPt = _instrPoints[index];
+        instrPt.xx = rayXx[iray];
+        instrPt.yy = rayYy[iray];
+        instrPt.zz = range;
+        instrPt.iray = iray;
+        instrPt.igate = igate;
+        instrPt.ray = ray;
+
+        // tag the gates that will be used in the
+        // kd tree to find the closest rays
+      
+        instrPt.isTagPt = _tagGates[igate];
+        instrPt.index = index;
+        instrPt.rayStartIndex = rayStartIndex;
+        instrPt.rayEndIndex = rayEndIndex;
+
+      } // igate
+
+    } // iray
+  });
   
   _printRunTime("Reorder - computing instr point locations");
   
@@ -532,6 +511,13 @@ void SatInterp::_computeGridRelative()
 
   _initProjection();
 
+  // the grid locations do not depend on the instrument, so are
+  // recomputed only if the grid has changed
+
+  if (!_gridGeomHasChanged(false)) {
+    return;
+  }
+  
   if (_params.use_multiple_threads) {
 
     _computeGridRelMultiThreaded();
@@ -623,70 +609,76 @@ void SatInterp::_computeGridRelRow(int iz, int iy)
 
   for (int ix = 0; ix < _gridNx; ix++, xx += _gridDx) {
     
-    GridLoc *loc = _gridLoc[iz][iy][ix];
-    
-    loc->xxInstr = xx;
-    loc->yyInstr = yy;
-    loc->zzInstr = zz;
+    size_t ii = _gridLocs.index(iz, iy, ix);
+    _gridLocs.xxInstr[ii] = xx;
+    _gridLocs.yyInstr[ii] = yy;
+    _gridLocs.zzInstr[ii] = zz;
 
   } // ix
 
 }
 
 //////////////////////////////////////////////////
-// build the KD tree for ray tag points
+// build the spatial index for ray tag points
 
-void SatInterp::_buildKdTree()
+void SatInterp::_buildSpatialIndex()
 {
 
-  for (size_t ipt = 0; ipt < _instrPoints.size(); ipt++) {
-    
-    instr_point_t instrPt = _instrPoints[ipt];
-    if (!instrPt.isTagPt) {
-      continue;
+  // count the tag points in each ray, then copy them
+  // and their coordinates - rays in parallel
+
+  size_t nRays = _rayPointStart.size() - 1;
+  vector<int> tagStart(nRays + 1, 0);
+  tbb::parallel_for(tbb::blocked_range<size_t>(0, nRays),
+                    [&](const tbb::blocked_range<size_t> &r) {
+    for (size_t iray = r.begin(); iray != r.end(); ++iray) {
+      int nTags = 0;
+      for (int ipt = _rayPointStart[iray];
+           ipt < _rayPointStart[iray + 1]; ipt++) {
+        if (_instrPoints[ipt].isTagPt) {
+          nTags++;
+        }
+      }
+      tagStart[iray + 1] = nTags;
     }
-    
-    double xx = instrPt.xx;
-    double yy = instrPt.yy;
-
-    KD_real *kdPt = new KD_real[KD_DIM];
-    kdPt[0] = instrPt.zz / _zSearchRatio;
-    kdPt[1] = yy;
-    kdPt[2] = xx;
-    _kdVec.push_back(kdPt);
-    _tagPoints.push_back(instrPt);
-      
-  } // ipt
-  
-  // create array of pointers to the pts in the vector
-  
-  _kdMat = new KD_real*[_kdVec.size()];
-  for (size_t ii = 0; ii < _kdVec.size(); ii++) {
-    _kdMat[ii] = _kdVec[ii];
+  });
+  for (size_t iray = 0; iray < nRays; iray++) {
+    tagStart[iray + 1] += tagStart[iray];
   }
-  
-  _kdTree = new KD_tree((const KD_real **) _kdMat, _kdVec.size(), KD_DIM);
-  _printRunTime("building KD tree");
 
+  _tagPoints.resize(tagStart[nRays]);
+  vector<double> coords(_tagPoints.size() * 3);
+  tbb::parallel_for(tbb::blocked_range<size_t>(0, nRays),
+                    [&](const tbb::blocked_range<size_t> &r) {
+    for (size_t iray = r.begin(); iray != r.end(); ++iray) {
+      int itag = tagStart[iray];
+      for (int ipt = _rayPointStart[iray];
+           ipt < _rayPointStart[iray + 1]; ipt++) {
+        const instr_point_t &instrPt = _instrPoints[ipt];
+        if (!instrPt.isTagPt) {
+          continue;
+        }
+        coords[itag * 3] = instrPt.zz / _zSearchRatio;
+        coords[itag * 3 + 1] = instrPt.yy;
+        coords[itag * 3 + 2] = instrPt.xx;
+        _tagPoints[itag] = instrPt;
+        itag++;
+      }
+    }
+  });
+  
+  _pointIndex->build(coords.data(), _tagPoints.size());
+  _printRunTime("building spatial index");
   
 }
 
 //////////////////////////////////////////////////
-// free the KD tree
+// free the spatial index
 
-void SatInterp::_freeKdTree()
+void SatInterp::_freeSpatialIndex()
 {
 
-  delete _kdTree;
-  _kdTree = NULL;
-  
-  delete[] _kdMat;
-  _kdMat = NULL;
-  
-  for (size_t ii = 0; ii < _kdVec.size(); ii++) {
-    delete[] _kdVec[ii];
-  }
-  _kdVec.clear();
+  _pointIndex->clear();
   _tagPoints.clear();
 
 }
@@ -701,9 +693,9 @@ void SatInterp::_doInterp()
 
   _initOutputArrays();
 
-  // build the KD tree
+  // build the spatial index
 
-  _buildKdTree();
+  _buildSpatialIndex();
   
   // perform interpolation
 
@@ -713,9 +705,9 @@ void SatInterp::_doInterp()
     _interpSingleThreaded();
   }
 
-  // free up the KD tree
+  // free up the spatial index
 
-  _freeKdTree();
+  _freeSpatialIndex();
   
 }
 
@@ -789,28 +781,40 @@ void SatInterp::_interpPlane(int iz)
 
 {
 
-  // copy the KD tree
-
-  pthread_mutex_lock(&_kdTreeMutex);
-  KD_tree kdTree(*_kdTree);
-  pthread_mutex_unlock(&_kdTreeMutex);
-  
   // init
   
   int nNeighbors = _params.reorder_npoints_search;
+  double dtestSq = _maxSearchRadius * _maxSearchRadius;
   
-  TaArray<int> tagIndexes_;
-  int *tagIndexes = tagIndexes_.alloc(nNeighbors);
-  
-  TaArray<KD_real> distSq_;
-  KD_real *distSq = distSq_.alloc(nNeighbors);
+  vector<double> queryLocs(_gridNx * SpatialIndex::DIM);
+  vector<int> tagIndexes(_gridNx * nNeighbors);
+  vector<double> distSq(_gridNx * nNeighbors);
+  vector<int> nFound(_gridNx);
 
   // create a vector of neighbor details, one for each
-  // point in the row
+  // point in the plane
   
   vector<NeighborProps *> neighbors;
   
   for (int iy = 0; iy < _gridNy; iy++) {
+
+    // set the query locations for the row
+    
+    size_t rowStart = _gridLocs.index(iz, iy, 0);
+    for (int ix = 0; ix < _gridNx; ix++) {
+      double *queryLoc = &queryLocs[ix * SpatialIndex::DIM];
+      queryLoc[0] = _gridLocs.zzInstr[rowStart + ix] / _zSearchRatio;
+      queryLoc[1] = _gridLocs.yyInstr[rowStart + ix];
+      queryLoc[2] = _gridLocs.xxInstr[rowStart + ix];
+    }
+      
+    // find nearest neighbors for the whole row, each search
+    // bounded by the neighbors of the previous point
+
+    _pointIndex->knnBatch(queryLocs.data(), _gridNx, nNeighbors,
+                          dtestSq, tagIndexes.data(),
+                          distSq.data(), nFound.data());
+
     for (int ix = 0; ix < _gridNx; ix++) {
     
       NeighborProps *neighborProps = new NeighborProps;
@@ -820,44 +824,11 @@ void SatInterp::_interpPlane(int iz)
       neighborProps->iz = iz;
       neighborProps->iy = iy;
       neighborProps->ix = ix;
-      neighborProps->loc = _gridLoc[iz][iy][ix];
-      
-      // set the query location
+      neighborProps->loc = _gridLocs.get(rowStart + ix);
       
-      KD_real queryLoc[KD_DIM];
-      queryLoc[0] = neighborProps->loc->zzInstr / _zSearchRatio;
-      queryLoc[1] = neighborProps->loc->yyInstr;
-      queryLoc[2] = neighborProps->loc->xxInstr;
-      
-      // initialize tagIndexes
-      
-      for (int ii = 0; ii < nNeighbors; ii++) {
-        tagIndexes[ii] = -1;
-      }
-      
-      double dtestSq = _maxSearchRadius * _maxSearchRadius;
-      
-      // Find nearest neighbors
-
-      kdTree.nnquery(queryLoc, // query location
-                     nNeighbors, // number of neighbors to search for
-                     KD_EUCLIDEAN, // search metric
-                     1, // Minkowski parameter
-                     tagIndexes, // out: indices of nearest nbrs
-                     distSq); // out: squares of distances of nbrs
-      
-      for (int jj = 0; jj < nNeighbors; jj++) {
-        int tagIndex = tagIndexes[jj];
-        if (tagIndex < 0) {
-          continue;
-        }
-        if (distSq[jj] <= dtestSq) {
-          neighborProps->tagIndexes.push_back(tagIndex);
-          neighborProps->distSq.push_back(distSq[jj]);
-        } else {
-          // no more
-          break;
-        }
+      for (int jj = 0; jj < nFound[ix]; jj++) {
+        neighborProps->tagIndexes.push_back(tagIndexes[ix * nNeighbors + jj]);
+        neighborProps->distSq.push_back(distSq[ix * nNeighbors + jj]);
       }
       
       neighbors.push_back(neighborProps);
@@ -900,7 +871,7 @@ void SatInterp::_interpPoint(const NeighborProps &neighborProps)
   }
   
   vector<instr_point_t> interpPts;
-  const GridLoc &loc = *neighborProps.loc;
+  const GridLoc &loc = neighborProps.loc;
 
   bool dataAbove = false;
   bool dataBelow = false;
@@ -1096,7 +1067,6 @@ void SatInterp::_computeInterpGridPt(int ifield,
   for (size_t ii = 0; ii < interpPts.size(); ii++) {
 
     instr_point_t rpt(interpPts[ii]);
-    GridLoc loc(*_gridLoc[iz][iy][ix]);
 
     const Ray *ray = _interpRays[rpt.iray];
     if (ray) {
@@ -1152,7 +1122,6 @@ void SatInterp::_computeFoldedGridPt(int ifield,
   for (size_t ii = 0; ii < interpPts.size(); ii++) {
 
     instr_point_t rpt(interpPts[ii]);
-    GridLoc loc(*_gridLoc[iz][iy][ix]);
 
     const Ray *ray = _interpRays[rpt.iray];
     if (ray) {
@@ -37,7 +37,7 @@
 #define SatInterp_HH
 
 #include "Interp.hh"
-#include <kd/kd.hh>
+#include "SpatialIndex.hh"
 #include <iostream>
 
 class SatInterp : public Interp {
@@ -76,7 +76,6 @@ private:
   deque<SatThread *> _activeThreads;
   deque<SatThread *> _availThreads;
   pthread_mutex_t _debugPrintMutex;
-  pthread_mutex_t _kdTreeMutex;
   
   // keeping track of points in instr space
 
@@ -95,19 +94,17 @@ private:
     double distSq;
   } instr_point_t;
   vector<instr_point_t> _instrPoints;
+  vector<int> _rayPointStart; // first point of each ray, and the end
 
   typedef struct {
     instr_point_t first;
     instr_point_t second;
   } ray_closest_t;
   
-  // KD tree for instr points
-  
-  static const int KD_DIM = 3;
-  
-  vector<KD_real *> _kdVec;
-  KD_real **_kdMat;
-  KD_tree *_kdTree;
+  // index of the tag points, KD tree or buckets - read-only once
+  // built, so shared by the threads without locking
+
+  SpatialIndex *_pointIndex;
 
   // tag gates - use to identify rays closest to grid points
 
@@ -125,7 +122,7 @@ private:
 
   class NeighborProps {
   public:
-    const GridLoc *loc;
+    GridLoc loc;
     int iz, iy, ix;
     vector<int> tagIndexes;
     vector<double> distSq;
@@ -148,8 +145,8 @@ private:
   void _computeGridRelMultiThreaded();
   void _computeGridRelRow(int iz, int iy);
 
-  void _buildKdTree();
-  void _freeKdTree();
+  void _buildSpatialIndex();
+  void _freeSpatialIndex();
 
   void _doInterp();
   void _interpSingleThreaded();
@@ -0,0 +1,92 @@
+#ifndef RADX_RADX2GRID_SPACE_FILLING_CURVE_H_
+#define RADX_RADX2GRID_SPACE_FILLING_CURVE_H_
+
+#include <cstdint>
+
+// Indices along 3D space-filling curves, for ordering work by locality.
+// Cells close on the curve are close in the grid, so processing points in
+// curve order keeps the working set of the grid small. Coordinates have
+// at most 'bits' bits each, bits <= 21.
+
+namespace SpaceFillingCurve {
+
+// number of bits needed for coordinates in [0, n)
+inline int
+bitsFor(uint32_t n)
+{
+  int bits = 1;
+  while (bits < 21 && (uint32_t(1) << bits) < n) {
+    bits++;
+  }
+  return bits;
+}
+
+// spread the low 21 bits of v to every third bit
+inline uint64_t
+_spread3(uint32_t v)
+{
+  uint64_t x = v & 0x1fffff;
+  x = (x | x << 32) & 0x1f00000000ffffULL;
+  x = (x | x << 16) & 0x1f0000ff0000ffULL;
+  x = (x | x << 8) & 0x100f00f00f00f00fULL;
+  x = (x | x << 4) & 0x10c30c30c30c30c3ULL;
+  x = (x | x << 2) & 0x1249249249249249ULL;
+  return x;
+}
+
+// Morton (Z-order) index, k varying fastest
+inline uint64_t
+morton(uint32_t i, uint32_t j, uint32_t k)
+{
+  return _spread3(i) << 2 | _spread3(j) << 1 | _spread3(k);
+}
+
+// Hilbert index, after Skilling (2004), "Programming the Hilbert curve".
+// Better locality than Morton - no long jumps between octants - for a
+// few more operations per point.
+inline uint64_t
+hilbert(uint32_t i, uint32_t j, uint32_t k, int bits)
+{
+  uint32_t X[3] = { i, j, k };
+  const uint32_t M = uint32_t(1) << (bits - 1);
+
+  // inverse undo
+  for (uint32_t Q = M; Q > 1; Q >>= 1) {
+    const uint32_t P = Q - 1;
+    for (int n = 0; n < 3; n++) {
+      if (X[n] & Q) {
+        X[0] ^= P;
+      } else {
+        const uint32_t t = (X[0] ^ X[n]) & P;
+        X[0] ^= t;
+        X[n] ^= t;
+      }
+    }
+  }
+
+  // Gray encode
+  X[1] ^= X[0];
+  X[2] ^= X[1];
+  uint32_t t = 0;
+  for (uint32_t Q = M; Q > 1; Q >>= 1) {
+    if (X[2] & Q) {
+      t ^= Q - 1;
+    }
+  }
+  for (int n = 0; n < 3; n++) {
+    X[n] ^= t;
+  }
+
+  // interleave the transposed index, most significant bit first
+  uint64_t index = 0;
+  for (int b = bits - 1; b >= 0; b--) {
+    for (int n = 0; n < 3; n++) {
+      index = index << 1 | ((X[n] >> b) & 1);
+    }
+  }
+  return index;
+}
+
+} // namespace SpaceFillingCurve
+
+#endif // RADX_RADX2GRID_SPACE_FILLING_CURVE_H_
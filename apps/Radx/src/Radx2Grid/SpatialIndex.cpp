@@ -0,0 +1,91 @@
+#include "SpatialIndex.hh"
+#include "BucketIndex.hh"
+#include "FlatKdTree.hh"
+#include "Params.hh"
+#include <algorithm>
+
+SpatialIndex*
+SpatialIndex::create(const Params& params)
+{
+  if (params.reorder_spatial_index == Params::SPATIAL_INDEX_BUCKETS) {
+    double bucketSize = params.reorder_bucket_size_km;
+    if (bucketSize <= 0.0) {
+      bucketSize = params.reorder_search_radius_km;
+    }
+    return new BucketIndex(bucketSize);
+  }
+  return new FlatKdTree;
+}
+
+void
+SpatialIndex::clear()
+{
+  _coords.clear();
+  _index.clear();
+}
+
+void
+SpatialIndex::_copyPoints(const double* coords, const std::vector<int>& perm)
+{
+  _coords.resize(perm.size() * DIM);
+  _index.resize(perm.size());
+  for (size_t ii = 0; ii < perm.size(); ii++) {
+    _index[ii] = perm[ii];
+    for (int dd = 0; dd < DIM; dd++) {
+      _coords[ii * DIM + dd] = coords[size_t(perm[ii]) * DIM + dd];
+    }
+  }
+}
+
+int
+SpatialIndex::knn(const double* q, int k, double maxDistSq, int* idx,
+                  double* distSq) const
+{
+  if (_index.empty() || k <= 0) {
+    return 0;
+  }
+  const int nFound = _search(q, k, maxDistSq, idx, distSq, 0);
+  for (int ii = 0; ii < nFound; ii++) {
+    idx[ii] = _index[idx[ii]];
+  }
+  return nFound;
+}
+
+void
+SpatialIndex::knnBatch(const double* q, int nq, int k, double maxDistSq,
+                       int* idx, double* distSq, int* nFound) const
+{
+  if (_index.empty() || k <= 0) {
+    std::fill(nFound, nFound + nq, 0);
+    return;
+  }
+
+  // positions of the previous query's neighbours
+
+  std::vector<int> prev(k);
+  int nPrev = 0;
+
+  for (int iq = 0; iq < nq; iq++) {
+    const double* qq = q + size_t(iq) * DIM;
+    int* qIdx = idx + size_t(iq) * k;
+    double* qDistSq = distSq + size_t(iq) * k;
+
+    // seed with the previous neighbours, at their distances from this
+    // query - an upper bound on the k-th distance before searching
+
+    int nSeed = 0;
+    for (int ii = 0; ii < nPrev; ii++) {
+      const double d = _distSq(qq, &_coords[size_t(prev[ii]) * DIM]);
+      if (d <= maxDistSq) {
+        nSeed = _insert(k, prev[ii], d, qIdx, qDistSq, nSeed);
+      }
+    }
+
+    nFound[iq] = _search(qq, k, maxDistSq, qIdx, qDistSq, nSeed);
+    nPrev = nFound[iq];
+    for (int ii = 0; ii < nPrev; ii++) {
+      prev[ii] = qIdx[ii];
+      qIdx[ii] = _index[qIdx[ii]];
+    }
+  }
+}
@@ -0,0 +1,92 @@
+#ifndef RADX_RADX2GRID_SPATIAL_INDEX_H_
+#define RADX_RADX2GRID_SPATIAL_INDEX_H_
+
+#include <cstddef>
+#include <vector>
+
+class Params;
+
+// Read-only index of 3D points for nearest-neighbour searches, the base
+// of FlatKdTree and BucketIndex.
+//
+// A subclass copies the points in its own order when built, and searches
+// them by position in that order. Once built the index is not modified,
+// so any number of threads may query it at once without locking or
+// copying; the queries write only to the caller's arrays.
+
+class SpatialIndex
+{
+public:
+  static const int DIM = 3;
+
+  virtual ~SpatialIndex() {}
+
+  // New index of the type set by reorder_spatial_index, for the caller
+  // to delete. Buckets are reorder_bucket_size_km across, or the search
+  // radius if that is not set.
+  static SpatialIndex* create(const Params& params);
+
+  // Build from nPoints points of DIM coordinates each, point ii at
+  // coords[ii * DIM]. Queries return indices into this array.
+  virtual void build(const double* coords, size_t nPoints) = 0;
+
+  virtual void clear();
+
+  inline size_t size() const { return _index.size(); }
+
+  // The (at most) k points closest to q, within sqrt(maxDistSq). Their
+  // indices and squared distances are written to idx[] and distSq[],
+  // closest first. Returns the number found.
+  int knn(const double* q, int k, double maxDistSq, int* idx,
+          double* distSq) const;
+
+  // knn for nq queries, query iq at q[iq * DIM], its results at
+  // idx[iq * k], distSq[iq * k] and nFound[iq]. Meant for a row of grid
+  // cells: the neighbours of one cell are the first candidates for the
+  // next, so the search is bounded from the start.
+  void knnBatch(const double* q, int nq, int k, double maxDistSq, int* idx,
+                double* distSq, int* nFound) const;
+
+protected:
+  std::vector<double> _coords; // in index order
+  std::vector<int> _index;     // original index, in index order
+
+  // Search from the nFound candidates already in pos[] and distSq[],
+  // as positions in index order. Returns the new count.
+  virtual int _search(const double* q, int k, double maxDistSq, int* pos,
+                      double* distSq, int nFound) const = 0;
+
+  // Add a candidate to the sorted neighbour lists, unless it is already
+  // there. Returns the new count.
+  static inline int _insert(int k, int pos, double d, int* idx,
+                            double* distSq, int nFound)
+  {
+    for (int ii = 0; ii < nFound; ii++) {
+      if (idx[ii] == pos) {
+        return nFound;
+      }
+    }
+    int jj = nFound < k ? nFound : k - 1;
+    while (jj > 0 && distSq[jj - 1] > d) {
+      idx[jj] = idx[jj - 1];
+      distSq[jj] = distSq[jj - 1];
+      jj--;
+    }
+    idx[jj] = pos;
+    distSq[jj] = d;
+    return nFound < k ? nFound + 1 : k;
+  }
+
+  static inline double _distSq(const double* a, const double* b)
+  {
+    const double d0 = a[0] - b[0];
+    const double d1 = a[1] - b[1];
+    const double d2 = a[2] - b[2];
+    return d0 * d0 + d1 * d1 + d2 * d2;
+  }
+
+  // copy the points in the order given by perm
+  void _copyPoints(const double* coords, const std::vector<int>& perm);
+};
+
+#endif // RADX_RADX2GRID_SPATIAL_INDEX_H_
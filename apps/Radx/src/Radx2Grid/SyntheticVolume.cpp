@@ -0,0 +1,344 @@
+#include "SyntheticVolume.hh"
+
+#include <Radx/NcfRadxFile.hh>
+#include <Radx/RadxField.hh>
+#include <Radx/RadxRay.hh>
+#include <Radx/RadxTime.hh>
+#include <Radx/RadxVol.hh>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <tbb/tbb.h>
+
+namespace {
+
+// 4/3 earth radius, as used by Polar2Cartesian
+const double IR = 4.0 * 6371008.0 / 3.0;
+
+const int NWAVES = 6;
+
+} // namespace
+
+SyntheticVolume::SyntheticVolume(const Config& config)
+  : _config(config)
+  , _volIndex(0)
+{
+  std::mt19937 gen(_config.seed);
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  const double maxRange =
+    _config.startRangeM + _config.nGates * _config.gateSpacingM;
+
+  // stratiform background: a few long-wavelength plane waves
+
+  for (int ii = 0; ii < NWAVES; ii++) {
+    double wavelength = 40000.0 + unit(gen) * 160000.0;
+    double dir = unit(gen) * 2.0 * M_PI;
+    Wave wave;
+    wave.kx = 2.0 * M_PI / wavelength * cos(dir);
+    wave.ky = 2.0 * M_PI / wavelength * sin(dir);
+    wave.phase = unit(gen) * 2.0 * M_PI;
+    wave.amp = 0.5 + unit(gen);
+    _waves.push_back(wave);
+  }
+
+  // convective cells, placed within the scanned disc
+
+  for (int ii = 0; ii < _config.nCells; ii++) {
+    double rr = sqrt(unit(gen)) * maxRange * 0.9;
+    double az = unit(gen) * 2.0 * M_PI;
+    Cell cell;
+    cell.x = rr * sin(az);
+    cell.y = rr * cos(az);
+    cell.radius = 2000.0 + unit(gen) * 6000.0;
+    cell.peakDbz = 15.0 + unit(gen) * 25.0;
+    _cells.push_back(cell);
+  }
+
+  // pick the background threshold that gives the requested coverage,
+  // by sampling the background over the scanned disc
+
+  double coverage = std::min(1.0, std::max(0.0, _config.precipCoverage));
+  if (coverage <= 0.0) {
+    _threshold = 1.0e99;
+  } else if (coverage >= 1.0) {
+    _threshold = -1.0e99;
+  } else {
+    const int nSamples = 20000;
+    std::vector<double> samples(nSamples);
+    for (int ii = 0; ii < nSamples; ii++) {
+      double rr = sqrt(unit(gen)) * maxRange;
+      double az = unit(gen) * 2.0 * M_PI;
+      samples[ii] = _background(rr * sin(az), rr * cos(az));
+    }
+    size_t nth = size_t((1.0 - coverage) * (nSamples - 1));
+    std::nth_element(samples.begin(), samples.begin() + nth, samples.end());
+    _threshold = samples[nth];
+  }
+}
+
+void
+SyntheticVolume::setVolumeIndex(int ivol)
+{
+  _volIndex = ivol;
+}
+
+size_t
+SyntheticVolume::getNRays() const
+{
+  return size_t(_config.nSweeps) * _config.nRaysPerSweep;
+}
+
+size_t
+SyntheticVolume::getNPoints() const
+{
+  return getNRays() * _config.nGates;
+}
+
+std::string
+SyntheticVolume::getFileName() const
+{
+  RadxTime startTime(_config.startTime +
+                     time_t(_volIndex * _config.volumeDurationSecs));
+  char name[128];
+  sprintf(name, "cfrad.%.4d%.2d%.2d_%.2d%.2d%.2d_%s_SUR.nc",
+          startTime.getYear(), startTime.getMonth(), startTime.getDay(),
+          startTime.getHour(), startTime.getMin(), startTime.getSec(),
+          _config.instrumentName.c_str());
+  return name;
+}
+
+double
+SyntheticVolume::_background(double x, double y) const
+{
+  double sum = 0.0, norm = 0.0;
+  for (const Wave& wave : _waves) {
+    sum += wave.amp * sin(wave.kx * x + wave.ky * y + wave.phase);
+    norm += wave.amp;
+  }
+  return sum / norm;
+}
+
+// reflectivity at a point, or INVALID_DATA where there is no echo
+
+double
+SyntheticVolume::_dbz(double x, double y, double z) const
+{
+  // echo pattern moves with the steering wind
+
+  double dt = _volIndex * _config.volumeDurationSecs;
+  double xx = x - _config.windU * dt;
+  double yy = y - _config.windV * dt;
+
+  double convective = 0.0;
+  for (const Cell& cell : _cells) {
+    double dx = xx - cell.x;
+    double dy = yy - cell.y;
+    double d2 = (dx * dx + dy * dy) / (cell.radius * cell.radius);
+    if (d2 < 9.0) {
+      convective = std::max(convective, cell.peakDbz * exp(-0.5 * d2));
+    }
+  }
+
+  double bg = _background(xx, yy);
+  if (bg < _threshold && convective < 5.0) {
+    return INVALID_DATA;
+  }
+
+  // stratiform echo tops out at half the convective echo top
+
+  double zKm = z / 1000.0;
+  double top = (convective > 5.0) ? _config.echoTopKm : _config.echoTopKm * 0.5;
+  if (zKm > top) {
+    return INVALID_DATA;
+  }
+
+  double dbz = 15.0 + 15.0 * std::max(0.0, bg - _threshold) + convective;
+  return dbz * (1.0 - 0.5 * zKm / top);
+}
+
+double
+SyntheticVolume::_fieldValue(size_t ifield, double dbz, double azDeg,
+                             double elDeg) const
+{
+  const std::string& name = _config.fields[ifield];
+  if (name.find("REF") == 0 || name.find("DBZ") == 0) {
+    return dbz;
+  }
+  if (name.find("VEL") == 0) {
+    double az = azDeg * M_PI / 180.0;
+    double el = elDeg * M_PI / 180.0;
+    return (_config.windU * sin(az) + _config.windV * cos(az)) * cos(el);
+  }
+  return 0.2 + 0.05 * (dbz - 15.0);
+}
+
+double
+SyntheticVolume::_elevationDeg(int isweep) const
+{
+  if (_config.nSweeps < 2) {
+    return _config.minElevDeg;
+  }
+  return _config.minElevDeg + isweep * (_config.maxElevDeg - _config.minElevDeg) /
+                                (_config.nSweeps - 1);
+}
+
+// gate location relative to the radar, using the same 4/3 earth model as
+// Polar2Cartesian::calculateXYZ
+
+void
+SyntheticVolume::_gateLocation(double range, double elDeg, double azDeg,
+                               double& x, double& y, double& z) const
+{
+  double el = elDeg * M_PI / 180.0;
+  double h0 = sqrt(range * range + 2.0 * range * IR * sin(el) + IR * IR) - IR;
+  double s = IR * asin(range * cos(el) / (IR + h0));
+  double az = azDeg * M_PI / 180.0;
+  x = s * sin(az);
+  y = s * cos(az);
+  z = h0 + _config.sensorHtAglM;
+}
+
+void
+SyntheticVolume::_computeRay(size_t iray,
+                             std::vector<std::vector<float>>& vals) const
+{
+  int isweep = int(iray / _config.nRaysPerSweep);
+  double azDeg = (iray % _config.nRaysPerSweep) * 360.0 / _config.nRaysPerSweep;
+  double elDeg = _elevationDeg(isweep);
+  vals.resize(_config.fields.size());
+  for (auto& fvals : vals) {
+    fvals.resize(_config.nGates);
+  }
+  for (int igate = 0; igate < _config.nGates; igate++) {
+    double x, y, z;
+    _gateLocation(_config.startRangeM + igate * _config.gateSpacingM, elDeg,
+                  azDeg, x, y, z);
+    double dbz = _dbz(x, y, z);
+    for (size_t ifield = 0; ifield < vals.size(); ifield++) {
+      vals[ifield][igate] =
+        (dbz == INVALID_DATA) ? INVALID_DATA_F
+                              : float(_fieldValue(ifield, dbz, azDeg, elDeg));
+    }
+  }
+}
+
+void
+SyntheticVolume::fillRepository(Repository& store) const
+{
+  const size_t nRays = getNRays();
+  const size_t nGates = _config.nGates;
+
+  store.timeDim = nRays;
+  store.rangeDim = nGates;
+  store.nPoints = nRays * nGates;
+  store.latitude = float(_config.latitudeDeg);
+  store.longitude = float(_config.longitudeDeg);
+  store.altitude = float(_config.altitudeM);
+  store.altitudeAgl = float(_config.sensorHtAglM);
+  store.instrumentName = _config.instrumentName;
+  RadxTime startTime(_config.startTime +
+                     time_t(_volIndex * _config.volumeDurationSecs));
+  store.startDateTime = startTime.asString(0);
+  store.inputFile = getFileName();
+
+  store.gateSize.assign(nRays, float(_config.gateSpacingM));
+  store.rayStartRange.assign(nRays, float(_config.startRangeM));
+  store.rayNGates.assign(nRays, int(nGates));
+  store.rayStartIndex.resize(nRays);
+  store.azimuth.resize(nRays);
+  store.elevation.resize(nRays);
+  store.timeVar.resize(nRays);
+  store.rangeVar.resize(nGates);
+  for (size_t igate = 0; igate < nGates; igate++) {
+    store.rangeVar[igate] =
+      float(_config.startRangeM + igate * _config.gateSpacingM);
+  }
+  for (size_t iray = 0; iray < nRays; iray++) {
+    int isweep = int(iray / _config.nRaysPerSweep);
+    store.rayStartIndex[iray] = int(iray * nGates);
+    store.azimuth[iray] =
+      float((iray % _config.nRaysPerSweep) * 360.0 / _config.nRaysPerSweep);
+    store.elevation[iray] = float(_elevationDeg(isweep));
+    store.timeVar[iray] = float(iray * _config.volumeDurationSecs / nRays);
+  }
+
+  std::vector<std::shared_ptr<RepositoryField>> fields;
+  for (const auto& name : _config.fields) {
+    auto field = std::make_shared<RepositoryField>();
+    field->fieldValues.resize(store.nPoints);
+    fields.push_back(field);
+    store.inFields[name] = field;
+  }
+
+  tbb::parallel_for(size_t(0), nRays, [&](size_t iray) {
+    std::vector<std::vector<float>> vals;
+    _computeRay(iray, vals);
+    for (size_t ifield = 0; ifield < fields.size(); ifield++) {
+      std::copy(vals[ifield].begin(), vals[ifield].end(),
+                fields[ifield]->fieldValues.begin() + iray * nGates);
+    }
+  });
+}
+
+int
+SyntheticVolume::writeCfRadial(const std::string& path) const
+{
+  RadxVol vol;
+  vol.setInstrumentName(_config.instrumentName);
+  vol.setSiteName(_config.instrumentName);
+  vol.setTitle("Synthetic radar volume");
+  vol.setSource("Radx2GridSynth");
+  vol.setLocation(_config.latitudeDeg, _config.longitudeDeg,
+                  _config.altitudeM / 1000.0);
+  vol.setSensorHtAglM(_config.sensorHtAglM);
+  vol.setRadarBeamWidthDegH(1.0);
+  vol.setRadarBeamWidthDegV(1.0);
+  vol.setVolumeNumber(_volIndex);
+
+  const size_t nRays = getNRays();
+  const time_t volStart =
+    _config.startTime + time_t(_volIndex * _config.volumeDurationSecs);
+  std::vector<std::vector<float>> vals;
+  for (size_t iray = 0; iray < nRays; iray++) {
+    int isweep = int(iray / _config.nRaysPerSweep);
+    double secs = iray * _config.volumeDurationSecs / nRays;
+    RadxRay* ray = new RadxRay();
+    ray->setTime(volStart + time_t(secs), (secs - floor(secs)) * 1.0e9);
+    ray->setVolumeNumber(_volIndex);
+    ray->setSweepNumber(isweep);
+    ray->setSweepMode(Radx::SWEEP_MODE_AZIMUTH_SURVEILLANCE);
+    ray->setAzimuthDeg((iray % _config.nRaysPerSweep) * 360.0 /
+                       _config.nRaysPerSweep);
+    ray->setElevationDeg(_elevationDeg(isweep));
+    ray->setFixedAngleDeg(_elevationDeg(isweep));
+    ray->setRangeGeom(_config.startRangeM / 1000.0,
+                      _config.gateSpacingM / 1000.0);
+
+    _computeRay(iray, vals);
+    for (size_t ifield = 0; ifield < _config.fields.size(); ifield++) {
+      const std::string& name = _config.fields[ifield];
+      bool isVel = name.find("VEL") == 0;
+      RadxField* fld = new RadxField(name, isVel ? "m/s" : "dBZ");
+      fld->setLongName(isVel ? "radial_velocity" : "synthetic_" + name);
+      fld->setTypeFl32(INVALID_DATA_F);
+      fld->addDataFl32(_config.nGates, vals[ifield].data());
+      ray->addField(fld);
+    }
+    vol.addRay(ray);
+  }
+  vol.loadVolumeInfoFromRays();
+  vol.loadSweepInfoFromRays();
+
+  // force the n_points ragged layout read by PolarDataStream
+
+  NcfRadxFile file;
+  file.setNcFormat(RadxFile::NETCDF4);
+  file.setWriteForceNgatesVary(true);
+  if (file.writeToPath(vol, path)) {
+    std::cerr << "ERROR - SyntheticVolume::writeCfRadial" << std::endl;
+    std::cerr << file.getErrStr() << std::endl;
+    return -1;
+  }
+  return 0;
+}
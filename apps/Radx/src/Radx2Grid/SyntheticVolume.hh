@@ -0,0 +1,102 @@
+#ifndef RADX_RADX2GRID_SYNTHETIC_VOLUME_H_
+#define RADX_RADX2GRID_SYNTHETIC_VOLUME_H_
+
+#include "PolarDataStream.hh"
+#include <ctime>
+#include <string>
+#include <vector>
+
+// Generates synthetic PPI volumes for scaling benchmarks.
+//
+// The echo is a smooth stratiform background, thresholded so that
+// precipCoverage of the scanned area holds echo, plus a number of
+// convective cells which drift with the steering wind between volumes.
+// The same volume can be loaded straight into a Repository, or written
+// as a CfRadial file (n_points ragged layout) readable by both the
+// INTERP_MODE_CART_MAP fast path and the legacy Radx-based interpolators.
+
+class SyntheticVolume
+{
+public:
+  struct Config
+  {
+    int nSweeps = 14;
+    int nRaysPerSweep = 360;
+    int nGates = 1832;
+    double minElevDeg = 0.5;
+    double maxElevDeg = 19.5;
+    double startRangeM = 2125.0;
+    double gateSpacingM = 250.0;
+
+    // fraction of the scanned area holding echo, 0 to 1
+    double precipCoverage = 0.3;
+    int nCells = 12;
+    double echoTopKm = 10.0;
+
+    // steering wind for cell motion and radial velocity (m/s)
+    double windU = 10.0;
+    double windV = 5.0;
+
+    // REF/DBZ get reflectivity, VEL radial velocity, anything else a
+    // smooth value correlated with reflectivity
+    std::vector<std::string> fields = { "REF" };
+
+    unsigned int seed = 1;
+    double latitudeDeg = 41.4132;
+    double longitudeDeg = -81.8597;
+    double altitudeM = 233.0;
+    double sensorHtAglM = 20.0;
+    std::string instrumentName = "SYNTH";
+    time_t startTime = 1356541835; // 2012-12-26T17:10:35Z
+    double volumeDurationSecs = 300.0;
+  };
+
+  SyntheticVolume(const Config& config);
+
+  // Volume number ivol starts ivol * volumeDurationSecs after startTime,
+  // with the cells moved on accordingly.
+  void setVolumeIndex(int ivol);
+
+  size_t getNRays() const;
+  size_t getNPoints() const;
+
+  // Fill the input side of a repository, as
+  // PolarDataStream::LoadDataFromNetCDFFilesIntoRepository would.
+  void fillRepository(Repository& store) const;
+
+  // Write the volume as CfRadial. Returns 0 on success, -1 on failure.
+  int writeCfRadial(const std::string& path) const;
+
+  // Name of the CfRadial file for the current volume index.
+  std::string getFileName() const;
+
+private:
+  struct Cell
+  {
+    double x, y;     // position at startTime (m)
+    double radius;   // gaussian radius (m)
+    double peakDbz;  // added to the background at the core
+  };
+
+  struct Wave
+  {
+    double kx, ky, phase, amp;
+  };
+
+  Config _config;
+  int _volIndex;
+  std::vector<Cell> _cells;
+  std::vector<Wave> _waves;
+  double _threshold;
+
+  double _background(double x, double y) const;
+  double _dbz(double x, double y, double z) const;
+  double _fieldValue(size_t ifield, double dbz, double azDeg,
+                     double elDeg) const;
+  double _elevationDeg(int isweep) const;
+  void _gateLocation(double range, double elDeg, double azDeg, double& x,
+                     double& y, double& z) const;
+  void _computeRay(size_t iray, std::vector<std::vector<float>>& vals) const;
+};
+
+#endif // RADX_RADX2GRID_SYNTHETIC_VOLUME_H_
@@ -37,6 +37,7 @@
 
 #include "Radx2Grid.hh"
 #include "Thread.hh"
+#include "PerfCounters.hh"
 #include <cassert>
 
 /////////////////////////////////
@@ -95,6 +96,8 @@ void Thread::signalWorkToStart()
 
 void Thread::waitForStartSignal() 
 {
+  // count this thread's work in the PERF output
+  PerfCounters::registerThread();
   pthread_mutex_lock(&_startMutex);
   while (!_startFlag) {
     pthread_cond_wait(&_startCond, &_startMutex);
@@ -0,0 +1,151 @@
+#include "TraceEvents.hh"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <unistd.h>
+
+std::atomic<bool> TraceEvents::_enabled(false);
+std::string TraceEvents::_path;
+std::mutex TraceEvents::_registryMutex;
+std::vector<std::unique_ptr<TraceEvents::ThreadBuffer>> TraceEvents::_registry;
+thread_local TraceEvents::ThreadBuffer* TraceEvents::_localBuffer = nullptr;
+
+namespace {
+
+const std::chrono::steady_clock::time_point _epoch =
+  std::chrono::steady_clock::now();
+
+void
+_writeEscaped(std::ostream& out, const std::string& str)
+{
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      out << '\\';
+    }
+    out << c;
+  }
+}
+
+} // namespace
+
+void
+TraceEvents::enable(const std::string& path)
+{
+  _path = path;
+  _enabled.store(true, std::memory_order_relaxed);
+}
+
+long
+TraceEvents::nowUs()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+           std::chrono::steady_clock::now() - _epoch)
+    .count();
+}
+
+TraceEvents::ThreadBuffer*
+TraceEvents::_threadBuffer()
+{
+  if (_localBuffer == nullptr) {
+    auto buf = new ThreadBuffer();
+    buf->events.reserve(1024);
+    std::lock_guard<std::mutex> lock(_registryMutex);
+    buf->tid = int(_registry.size()) + 1;
+    _registry.emplace_back(buf);
+    _localBuffer = buf;
+  }
+  return _localBuffer;
+}
+
+void
+TraceEvents::setThreadName(const std::string& name)
+{
+  if (!isEnabled()) {
+    return;
+  }
+  _threadBuffer()->name = name;
+}
+
+void
+TraceEvents::complete(const char* name, const char* category, long startUs,
+                      long endUs, int volume)
+{
+  if (!isEnabled()) {
+    return;
+  }
+  _threadBuffer()->events.push_back(
+    { name, category, 'X', startUs, endUs - startUs, 0.0, volume });
+}
+
+void
+TraceEvents::counter(const char* name, long tsUs, double value, int volume)
+{
+  if (!isEnabled()) {
+    return;
+  }
+  _threadBuffer()->events.push_back(
+    { name, "counter", 'C', tsUs, 0, value, volume });
+}
+
+int
+TraceEvents::write()
+{
+  if (!isEnabled()) {
+    return 0;
+  }
+
+  std::ofstream out(_path, std::ios::trunc);
+  if (!out) {
+    std::cerr << "ERROR - TraceEvents::write" << std::endl;
+    std::cerr << "  Cannot open trace file: " << _path << std::endl;
+    return -1;
+  }
+
+  const int pid = int(getpid());
+  bool first = true;
+  auto sep = [&]() {
+    out << (first ? "\n" : ",\n");
+    first = false;
+  };
+
+  std::lock_guard<std::mutex> lock(_registryMutex);
+  size_t nEvents = 0;
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  for (const auto& buf : _registry) {
+    if (!buf->name.empty()) {
+      sep();
+      out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid
+          << ",\"tid\":" << buf->tid << ",\"args\":{\"name\":\"";
+      _writeEscaped(out, buf->name);
+      out << "\"}}";
+    }
+    for (const Event& ev : buf->events) {
+      sep();
+      out << "{\"name\":\"" << ev.name << "\",\"cat\":\"" << ev.category
+          << "\",\"ph\":\"" << ev.phase << "\",\"pid\":" << pid
+          << ",\"tid\":" << buf->tid << ",\"ts\":" << ev.ts;
+      if (ev.phase == 'X') {
+        out << ",\"dur\":" << ev.dur;
+        if (ev.volume >= 0) {
+          out << ",\"args\":{\"volume\":" << ev.volume << "}";
+        }
+      } else {
+        out << ",\"args\":{\"value\":" << ev.value << "}";
+      }
+      out << "}";
+    }
+    nEvents += buf->events.size();
+  }
+  out << "\n]}\n";
+  out.close();
+
+  if (!out) {
+    std::cerr << "ERROR - TraceEvents::write" << std::endl;
+    std::cerr << "  Failed writing trace file: " << _path << std::endl;
+    return -1;
+  }
+  std::cerr << "Wrote " << nEvents << " trace events to " << _path
+            << std::endl;
+  return 0;
+}
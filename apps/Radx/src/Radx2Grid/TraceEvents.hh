@@ -0,0 +1,108 @@
+#ifndef RADX_RADX2GRID_TRACE_EVENTS_H_
+#define RADX_RADX2GRID_TRACE_EVENTS_H_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Records begin/end spans of the Radx2GridPlus pipeline and writes them in
+// the Chrome/Perfetto trace-event JSON format.
+//
+// Each thread appends to its own buffer, so recording never takes a lock
+// after the first event on a thread. When tracing is disabled every call
+// returns after a single relaxed load.
+
+class TraceEvents
+{
+public:
+  // Turn recording on. Events are written to path by write().
+  static void enable(const std::string& path);
+
+  static inline bool isEnabled()
+  {
+    return _enabled.load(std::memory_order_relaxed);
+  }
+
+  // Label the calling thread in the timeline.
+  static void setThreadName(const std::string& name);
+
+  // Add a complete ('X') event. volume < 0 means the span is not tied to a
+  // particular volume.
+  static void complete(const char* name, const char* category, long startUs,
+                       long endUs, int volume = -1);
+
+  // Add a counter ('C') sample.
+  static void counter(const char* name, long tsUs, double value,
+                      int volume = -1);
+
+  // Microseconds on the trace clock.
+  static long nowUs();
+
+  // Write all buffered events. Call once every traced thread has joined.
+  // Returns 0 on success, -1 on failure.
+  static int write();
+
+private:
+  struct Event
+  {
+    const char* name;
+    const char* category;
+    char phase;
+    long ts;
+    long dur;
+    double value;
+    int volume;
+  };
+
+  struct ThreadBuffer
+  {
+    int tid;
+    std::string name;
+    std::vector<Event> events;
+  };
+
+  static ThreadBuffer* _threadBuffer();
+
+  static std::atomic<bool> _enabled;
+  static std::string _path;
+
+  // buffers are owned here so they outlive the threads that filled them
+  static std::mutex _registryMutex;
+  static std::vector<std::unique_ptr<ThreadBuffer>> _registry;
+  static thread_local ThreadBuffer* _localBuffer;
+};
+
+// Scoped span: records a complete event covering its lifetime.
+
+class TraceSpan
+{
+public:
+  TraceSpan(const char* name, const char* category, int volume = -1)
+    : _name(name)
+    , _category(category)
+    , _volume(volume)
+    , _start(TraceEvents::isEnabled() ? TraceEvents::nowUs() : -1)
+  {
+  }
+
+  ~TraceSpan()
+  {
+    if (_start >= 0) {
+      TraceEvents::complete(_name, _category, _start, TraceEvents::nowUs(),
+                            _volume);
+    }
+  }
+
+  TraceSpan(const TraceSpan&) = delete;
+  TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+  const char* _name;
+  const char* _category;
+  int _volume;
+  long _start;
+};
+
+#endif // RADX_RADX2GRID_TRACE_EVENTS_H_
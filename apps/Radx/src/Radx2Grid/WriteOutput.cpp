@@ -1,13 +1,56 @@
 #include "WriteOutput.hh"
+#include "TraceEvents.hh"
 
 #include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
 #include <memory>
+#include <mutex>
 #include <sstream>
-#include <fstream>
 #include "netcdf"
+#include <cpl_string.h>
+#include <gdal_priv.h>
+#include <hdf5.h>
+#include <sys/stat.h>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <zlib.h>
+
+#if !H5_VERSION_GE(1, 10, 3)
+#include <hdf5_hl.h>
+#define H5Dwrite_chunk H5DOwrite_chunk
+#endif
 
 using namespace std;
 
+namespace {
+
+// write a whole file, returns 0 on success, -1 on failure
+int
+_writeFile(const std::string& path, const void* data, size_t len)
+{
+	std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+	out.write(static_cast<const char*>(data), len);
+	return out ? 0 : -1;
+}
+
+int
+_makeDir(const std::string& path)
+{
+	if (mkdir(path.c_str(), 0775) != 0 && errno != EEXIST) {
+		std::cerr << "ERROR - WriteOutput::_writeZarr" << std::endl;
+		std::cerr << "  Cannot create directory: " << path << std::endl;
+		std::cerr << "  " << strerror(errno) << std::endl;
+		return -1;
+	}
+	return 0;
+}
+
+} // namespace
+
 
 WriteOutput::WriteOutput(const shared_ptr<Cart2Grid>& grid,
 		const shared_ptr<Repository>& store,
@@ -31,171 +74,863 @@ WriteOutput::writeOutputFile()
 {
 
 	if (_params.output_format == Params::output_format_t::CF_NETCDF) {
-		// Write out netcdf
-
-		std::string outputFileName("ncf_");
-		outputFileName += _store->instrumentName;
-		outputFileName += "_";
-		outputFileName += _store->startDateTime;
-		std::replace(outputFileName.begin(), outputFileName.end(), ':', '-');
-		outputFileName += ".ncf";
-		std::cout << outputFileName << std::endl;
-		std::string xDim("x0");
-		std::string yDim("y0");
-		std::string zDim("z0");
-		std::string xCoordinateVar("x0");
-		std::string yCoordinateVar("y0");
-		std::string zCoordinateVar("z0");
-
-		std::vector<float> xCoordinates;
-		std::vector<float> yCoordinates;
-		std::vector<float> zCoordinates;
-		//TODO: Remove this hard coded string. std::string reflName("reflectivity");
-
-		// WHY NOT USE std::iota? 
-		// It increments only by 1. If we really want, we can implement our own version of
-		// iota that takes another parameter called "stride".  
-		for (int i = 0; i < _grid->getGridDimX(); i++)
-			xCoordinates.push_back(_grid->getDMinX() + i * 0.5);
-		for (int i = 0; i < _grid->getGridDimY(); i++)
-			yCoordinates.push_back(_grid->getDMinY() + i * 0.5);
-		for (int i = 0; i < _grid->getGridDimZ(); i++)
-			zCoordinates.push_back(_grid->getDMinZ() + i * 0.5);
-
-		// Open file for writing.
-		netCDF::NcFile opFile(outputFileName, netCDF::NcFile::replace);
-		// Add dimensions to the file.
-		netCDF::NcDim x0Dim = opFile.addDim(xDim, _grid->getGridDimX());
-		netCDF::NcDim y0Dim = opFile.addDim(yDim, _grid->getGridDimY());
-		netCDF::NcDim z0Dim = opFile.addDim(zDim, _grid->getGridDimZ());
-
-		// define coordinate variables
-		netCDF::NcVar x0Var =
-			opFile.addVar(xCoordinateVar, netCDF::ncFloat, x0Dim);
-		netCDF::NcVar y0Var =
-			opFile.addVar(yCoordinateVar, netCDF::ncFloat, y0Dim);
-		netCDF::NcVar z0Var =
-			opFile.addVar(zCoordinateVar, netCDF::ncFloat, z0Dim);
-
-		// write coordinate variable data
+		return _writeNetCDF();
+
+	} else if (_params.output_format == Params::output_format_t::RASTER) {
+		return _writeGeoTiff();
+
+	} else if (_params.output_format == Params::output_format_t::ZARR) {
+		return _writeZarr();
+
+	} else {
+		// Show a warning that outputs format are not supported
+		std::cerr << "The output format specified is not supported" << std::endl;
+		return -1;
+	}
+
+	return 0;
+}
+
+/////////////////////////////////////////////////////
+// write out data as netCDF, streaming one z-slab at a time
+// from the grid. Fields are stored (z0, y0, x0), and for the
+// netCDF4 styles chunked by horizontal plane. If compression
+// is on, the chunks are deflated in parallel and written
+// directly, see _writeCompressedChunks(). With output_packing
+// set, fields are written as short or byte with scale_factor,
+// add_offset and _FillValue, from the grid packed by Cart2Grid.
+
+	int
+WriteOutput::_writeNetCDF()
+{
+	std::string outputFileName("ncf_");
+	outputFileName += _store->instrumentName;
+	outputFileName += "_";
+	outputFileName += _store->startDateTime;
+	std::replace(outputFileName.begin(), outputFileName.end(), ':', '-');
+	outputFileName += ".ncf";
+	std::cout << outputFileName << std::endl;
+
+	const size_t nx = _grid->getGridDimX();
+	const size_t ny = _grid->getGridDimY();
+	const size_t nz = _grid->getGridDimZ();
+	const Params::grid_xy_geom_t xyGeom = _grid->getStructXYGeom();
+	const Params::grid_z_geom_t zGeom = _grid->getStructZGeom();
+
+	netCDF::NcFile::FileFormat format = netCDF::NcFile::nc4;
+	switch (_params.netcdf_style) {
+		case Params::CLASSIC:
+			format = netCDF::NcFile::classic;
+			break;
+		case Params::NC64BIT:
+			format = netCDF::NcFile::classic64;
+			break;
+		case Params::NETCDF4_CLASSIC:
+			format = netCDF::NcFile::nc4classic;
+			break;
+		default:
+			format = netCDF::NcFile::nc4;
+	}
+	const bool isNc4 = format == netCDF::NcFile::nc4 ||
+		format == netCDF::NcFile::nc4classic;
+	const bool compress = isNc4 && _params.netcdf_compressed &&
+		_params.netcdf_compression_level > 0;
+	std::vector<size_t> chunkShape = _chunkShape();
+
+	auto fields = _grid->getOutputFinalGrid();
+	const map<string, PackedField>& packed = _grid->getPackedGrid();
+
+	try {
+		netCDF::NcFile opFile(outputFileName, netCDF::NcFile::replace, format);
+
+		netCDF::NcDim x0Dim = opFile.addDim("x0", nx);
+		netCDF::NcDim y0Dim = opFile.addDim("y0", ny);
+		netCDF::NcDim z0Dim = opFile.addDim("z0", nz);
+
+		// coordinate variables, km from the radar
+
+		std::vector<float> xCoordinates(nx);
+		std::vector<float> yCoordinates(ny);
+		std::vector<float> zCoordinates(nz);
+		for (size_t i = 0; i < nx; i++)
+			xCoordinates[i] = xyGeom.minx + i * xyGeom.dx;
+		for (size_t j = 0; j < ny; j++)
+			yCoordinates[j] = xyGeom.miny + j * xyGeom.dy;
+		for (size_t k = 0; k < nz; k++)
+			zCoordinates[k] = zGeom.minz + k * zGeom.dz;
+
+		netCDF::NcVar x0Var = opFile.addVar("x0", netCDF::ncFloat, x0Dim);
+		netCDF::NcVar y0Var = opFile.addVar("y0", netCDF::ncFloat, y0Dim);
+		netCDF::NcVar z0Var = opFile.addVar("z0", netCDF::ncFloat, z0Dim);
+		x0Var.putAtt("units", "km");
+		y0Var.putAtt("units", "km");
+		z0Var.putAtt("units", "km");
+
+		// define field variables before writing any data, so that
+		// classic files stay in define mode only once
+
+		std::vector<netCDF::NcDim> fieldDim = { z0Dim, y0Dim, x0Dim };
+		std::vector<netCDF::NcVar> fieldVars;
+		for (auto const& field : fields) {
+			netCDF::NcVar nc_field;
+			auto pf = packed.find(field.first);
+			if (pf == packed.end()) {
+				nc_field = opFile.addVar(field.first, netCDF::ncFloat, fieldDim);
+				nc_field.putAtt("_FillValue", netCDF::ncFloat, INVALID_DATA_F);
+			} else if (pf->second.nBytes == 1) {
+				nc_field = opFile.addVar(field.first, netCDF::ncByte, fieldDim);
+				nc_field.putAtt("_FillValue", netCDF::ncByte,
+						static_cast<signed char>(pf->second.fillValue));
+			} else {
+				nc_field = opFile.addVar(field.first, netCDF::ncShort, fieldDim);
+				nc_field.putAtt("_FillValue", netCDF::ncShort,
+						static_cast<short>(pf->second.fillValue));
+			}
+			if (pf != packed.end()) {
+				nc_field.putAtt("scale_factor", netCDF::ncFloat,
+						static_cast<float>(pf->second.scaleFactor));
+				nc_field.putAtt("add_offset", netCDF::ncFloat,
+						static_cast<float>(pf->second.addOffset));
+			}
+			if (isNc4) {
+				nc_field.setChunking(netCDF::NcVar::nc_CHUNKED, chunkShape);
+				if (compress) {
+					nc_field.setCompression(true, true,
+						_params.netcdf_compression_level);
+				}
+			}
+			fieldVars.push_back(nc_field);
+		}
+
+		// derived 2D products, small enough for netCDF to write
+		// directly
+
+		const map<string, DerivedProduct>& products =
+			_grid->getDerivedProducts();
+		std::vector<netCDF::NcDim> productDim = { y0Dim, x0Dim };
+		std::vector<netCDF::NcVar> productVars;
+		for (auto const& product : products) {
+			netCDF::NcVar nc_product =
+				opFile.addVar(product.first, netCDF::ncFloat, productDim);
+			nc_product.putAtt("_FillValue", netCDF::ncFloat, INVALID_DATA_F);
+			nc_product.putAtt("long_name", product.second.longName);
+			nc_product.putAtt("units", product.second.units);
+			if (compress) {
+				nc_product.setCompression(true, true,
+					_params.netcdf_compression_level);
+			}
+			productVars.push_back(nc_product);
+		}
+
+		// Add global Attributes
+		opFile.putAtt("instrument_name", _store->instrumentName);
+		opFile.putAtt("start_datetime", _store->startDateTime);
+		opFile.putAtt("latitude", netCDF::NcType::nc_FLOAT,
+				static_cast<float>(_store->latitude));
+		opFile.putAtt("longitude", netCDF::NcType::nc_FLOAT,
+				static_cast<float>(_store->longitude));
+
 		x0Var.putVar(xCoordinates.data());
 		y0Var.putVar(yCoordinates.data());
 		z0Var.putVar(zCoordinates.data());
 
-		for (auto const& field : _grid->getOutputFinalGrid())
-		{
-			//Define field Variable
-			std::vector<netCDF::NcDim> fieldDim;
-			fieldDim.push_back(x0Dim);
-			fieldDim.push_back(y0Dim);
-			fieldDim.push_back(z0Dim);
-
-			netCDF::NcVar nc_field =
-				opFile.addVar(field.first, netCDF::ncFloat, fieldDim);
-
-			//Write field data
-			std::vector<float> field_data;
-			for (auto i = field.second->cbegin(); i != field.second->cend(); i++) {
-				for (auto j = i->cbegin(); j != i->cend(); j++) {
-					field_data.insert(field_data.end(), j->begin(), j->end());
+		size_t iproduct = 0;
+		for (auto const& product : products) {
+			productVars[iproduct++].putVar(product.second.data.data());
+		}
+
+		// stream z-slabs; compressed fields are written after the
+		// file is closed
+
+		if (!compress) {
+			std::vector<float> plane(nx * ny);
+			size_t ifield = 0;
+			for (auto const& field : fields) {
+				TraceSpan span("putVar", "write");
+				auto pf = packed.find(field.first);
+				if (pf != packed.end()) {
+					// packed planes are already (y, x)
+					const PackedField& p = pf->second;
+					const size_t planeBytes = nx * ny * p.nBytes;
+					for (size_t k = 0; k < nz; k++) {
+						const unsigned char* bytes = p.data.data() + k * planeBytes;
+						if (p.nBytes == 1) {
+							fieldVars[ifield].putVar({ k, 0, 0 }, { 1, ny, nx },
+									reinterpret_cast<const signed char*>(bytes));
+						} else {
+							fieldVars[ifield].putVar({ k, 0, 0 }, { 1, ny, nx },
+									reinterpret_cast<const short*>(bytes));
+						}
+					}
+					ifield++;
+					continue;
 				}
+				const vector3d<double>& grid = *field.second;
+				for (size_t k = 0; k < nz; k++) {
+					tbb::parallel_for(size_t(0), ny, [&](size_t j) {
+						float* row = plane.data() + j * nx;
+						for (size_t i = 0; i < nx; i++) {
+							row[i] = static_cast<float>(grid[i][j][k]);
+						}
+					});
+					fieldVars[ifield].putVar({ k, 0, 0 }, { 1, ny, nx },
+							plane.data());
+				}
+				ifield++;
 			}
+		}
+	} catch (netCDF::exceptions::NcException& e) {
+		std::cerr << "ERROR - WriteOutput::_writeNetCDF" << std::endl;
+		std::cerr << "  Cannot write file: " << outputFileName << std::endl;
+		std::cerr << "  " << e.what() << std::endl;
+		return -1;
+	}
 
-			nc_field.putVar(field_data.data());
+	if (compress) {
+		return _writeCompressedChunks(outputFileName, chunkShape);
+	}
+	return 0;
+}
+
+/////////////////////////////////////////////////////
+// chunk shape for the (z0, y0, x0) field variables.
+// One z level per chunk, so reading a horizontal plane
+// touches only that plane's chunks. Planes larger than
+// 1M cells are split into bands of whole rows.
+
+	std::vector<size_t>
+WriteOutput::_chunkShape()
+{
+	const size_t maxCells = 1 << 20;
+	const size_t nx = _grid->getGridDimX();
+	const size_t ny = _grid->getGridDimY();
+	size_t cx = std::min(nx, maxCells);
+	size_t cy = std::max(size_t(1), std::min(ny, maxCells / cx));
+	return { 1, cy, cx };
+}
+
+/////////////////////////////////////////////////////
+// Deflate the field chunks in parallel and write them with
+// the HDF5 direct chunk interface, into the datasets already
+// defined by _writeNetCDF(). netCDF and HDF5 would otherwise
+// run the deflate filter one chunk at a time on the caller.
+// The shuffle and deflate steps match the filters netCDF
+// set on the variables.
+
+	int
+WriteOutput::_writeCompressedChunks(const std::string& path,
+		const std::vector<size_t>& chunkShape)
+{
+	struct Chunk
+	{
+		std::string field;
+		const vector3d<double>* grid;
+		const PackedField* packed;
+		hsize_t offset[3];
+		std::vector<unsigned char> data;
+	};
+
+	const size_t nx = _grid->getGridDimX();
+	const size_t ny = _grid->getGridDimY();
+	const size_t nz = _grid->getGridDimZ();
+	const size_t cy = chunkShape[1];
+	const size_t cx = chunkShape[2];
+	const size_t nCells = cy * cx;
+	const int level = _params.netcdf_compression_level;
+
+	auto fields = _grid->getOutputFinalGrid();
+	const map<string, PackedField>& packed = _grid->getPackedGrid();
+	std::vector<Chunk> chunks;
+	for (auto const& field : fields) {
+		auto pf = packed.find(field.first);
+		const PackedField* p = pf == packed.end() ? nullptr : &pf->second;
+		for (size_t k = 0; k < nz; k++) {
+			for (size_t j0 = 0; j0 < ny; j0 += cy) {
+				for (size_t i0 = 0; i0 < nx; i0 += cx) {
+					// untouched regions of a sparse grid are left unallocated,
+					// and read back as _FillValue
+					if (_grid->isEmptyRegion(field.first, i0,
+								std::min(i0 + cx, nx) - 1, j0, std::min(j0 + cy, ny) - 1,
+								k, k)) {
+						continue;
+					}
+					chunks.push_back(
+						{ field.first, field.second.get(), p, { k, j0, i0 }, {} });
+				}
+			}
 		}
+	}
 
+	std::atomic<bool> failed(false);
+	{
+		TraceSpan span("deflate", "write");
+		tbb::parallel_for(tbb::blocked_range<size_t>(0, chunks.size()),
+				[&](const tbb::blocked_range<size_t>& r) {
+			std::vector<unsigned char> vals(nCells * sizeof(float));
+			std::vector<unsigned char> shuffled(vals.size());
+			for (size_t ic = r.begin(); ic != r.end(); ic++) {
+				Chunk& chunk = chunks[ic];
+				const size_t elemSize = _gatherChunk(*chunk.grid, chunk.packed,
+						chunk.offset[0], chunk.offset[1], chunk.offset[2], cy, cx,
+						vals.data());
+				if (_shuffleDeflate(vals.data(), nCells, elemSize, level,
+							shuffled, chunk.data)) {
+					failed = true;
+				}
+			}
+		});
+	}
+	if (failed) {
+		std::cerr << "ERROR - WriteOutput::_writeCompressedChunks" << std::endl;
+		std::cerr << "  Deflate failed for file: " << path << std::endl;
+		return -1;
+	}
 
-		// Add global Attributes
-		netCDF::NcGroupAtt groupAttr =
-			opFile.putAtt("instrument_name", _store->instrumentName);
-		groupAttr = opFile.putAtt("start_datetime", _store->startDateTime);
-		// groupAttr = opFile.putAtt("time_dimension", netCDF::NcType::nc_INT,
-		// static_cast<int>(_store->timeDim));  groupAttr =
-		// opFile.putAtt("range_dimension", netCDF::NcType::nc_INT,
-		// static_cast<int>(_store->rangeDim));  groupAttr =
-		// opFile.putAtt("n_points", netCDF::NcType::nc_INT,
-		// static_cast<int>(_store->nPoints));
-		groupAttr = opFile.putAtt("latitude",
-				netCDF::NcType::nc_FLOAT,
-				static_cast<float>(_store->latitude));
-		groupAttr = opFile.putAtt("longitude",
-				netCDF::NcType::nc_FLOAT,
-				static_cast<float>(_store->longitude));
-		// groupAttr = opFile.putAtt("altitude_agl", netCDF::NcType::nc_FLOAT,
-		// static_cast<float>(_store->altitudeAgl));
-		return 0;
+	TraceSpan span("writeChunks", "write");
+	hid_t file = H5Fopen(path.c_str(), H5F_ACC_RDWR, H5P_DEFAULT);
+	if (file < 0) {
+		std::cerr << "ERROR - WriteOutput::_writeCompressedChunks" << std::endl;
+		std::cerr << "  Cannot reopen file: " << path << std::endl;
+		return -1;
+	}
+	int iret = 0;
+	std::string openField;
+	hid_t dset = -1;
+	for (const Chunk& chunk : chunks) {
+		if (chunk.field != openField) {
+			if (dset >= 0) {
+				H5Dclose(dset);
+			}
+			openField = chunk.field;
+			dset = H5Dopen2(file, openField.c_str(), H5P_DEFAULT);
+		}
+		// filter mask 0 - all filters were applied
+		if (dset < 0 || H5Dwrite_chunk(dset, H5P_DEFAULT, 0, chunk.offset,
+					chunk.data.size(), chunk.data.data()) < 0) {
+			std::cerr << "ERROR - WriteOutput::_writeCompressedChunks" << std::endl;
+			std::cerr << "  Cannot write field " << chunk.field
+				<< " to file: " << path << std::endl;
+			iret = -1;
+			break;
+		}
+	}
+	if (dset >= 0) {
+		H5Dclose(dset);
+	}
+	H5Fclose(file);
+	return iret;
+}
 
+/////////////////////////////////////////////////////
+// Gather the (1, cy, cx) chunk at offset (k, j0, i0) of a
+// field into dest, x varying fastest. Packed fields are
+// copied from the packed planes, others converted to float.
+// Edge chunks are padded to full size with the fill value.
+// Returns the element size in bytes.
 
-	} else if (_params.output_format == Params::output_format_t::RASTER) {
+	size_t
+WriteOutput::_gatherChunk(const vector3d<double>& grid,
+		const PackedField* packed, size_t k, size_t j0, size_t i0,
+		size_t cy, size_t cx, unsigned char* dest)
+{
+	const size_t nx = _grid->getGridDimX();
+	const size_t ny = _grid->getGridDimY();
+	const size_t nCells = cy * cx;
+	const size_t rowLen = std::min(cx, nx - i0);
+
+	if (packed != nullptr) {
+		const size_t elemSize = packed->nBytes;
+		if (elemSize == 1) {
+			std::fill_n(reinterpret_cast<int8_t*>(dest), nCells,
+					static_cast<int8_t>(packed->fillValue));
+		} else {
+			std::fill_n(reinterpret_cast<int16_t*>(dest), nCells,
+					static_cast<int16_t>(packed->fillValue));
+		}
+		const unsigned char* plane =
+			packed->data.data() + k * nx * ny * elemSize;
+		for (size_t jj = 0; jj < cy && j0 + jj < ny; jj++) {
+			memcpy(dest + jj * cx * elemSize,
+					plane + ((j0 + jj) * nx + i0) * elemSize, rowLen * elemSize);
+		}
+		return elemSize;
+	}
 
-		// Construct projection WKT;
-		stringstream prj_writer;
-		prj_writer << "PROJCS[\"World_Azimuthal_Equidistant\",";
-		prj_writer << "GEOGCS[\"GCS_WGS_1984\",";
-		prj_writer << "DATUM[\"D_WGS_1984\",";
-		prj_writer << "SPHEROID[\"WGS_1984\",6378137,298.257223563]],";
-		prj_writer << "PRIMEM[\"Greenwich\",0],";
-		prj_writer << "UNIT[\"Degree\",0.017453292519943295]],";
-		prj_writer << "PROJECTION[\"Azimuthal_Equidistant\"],";
-		prj_writer << "PARAMETER[\"False_Easting\",0],";
-		prj_writer << "PARAMETER[\"False_Northing\",0],";
-		prj_writer << "PARAMETER[\"Central_Meridian\"," << _store->longitude << "],";
-		prj_writer << "PARAMETER[\"Latitude_Of_Origin\"," << _store->latitude << "],";
-		prj_writer << "UNIT[\"Meter\",1]]";
-		prj_writer.flush();
-
-		std::string outputFileName("grd_");
-		outputFileName += _store->instrumentName;
-		outputFileName += "_";
-		outputFileName += _store->startDateTime;
-		std::replace(outputFileName.begin(), outputFileName.end(), ':', '_');
-
-		for (const auto& kv : _grid->getOutputFinalGrid()) {
-			string field_name = kv.first;
-			double z0 = _params.grid_z_geom.minz;
-			for (int z = 0; z < _grid->getGridDimZ(); z++) {
-				double h =
-					(z0 + z * _params.grid_z_geom.dz) * 1000.0; // Convert to meters
-				char h_cstr[6];
+	float* vals = reinterpret_cast<float*>(dest);
+	std::fill_n(vals, nCells, INVALID_DATA_F);
+	for (size_t jj = 0; jj < cy && j0 + jj < ny; jj++) {
+		for (size_t ii = 0; ii < rowLen; ii++) {
+			vals[jj * cx + ii] = static_cast<float>(grid[i0 + ii][j0 + jj][k]);
+		}
+	}
+	return sizeof(float);
+}
+
+/////////////////////////////////////////////////////
+// Byte shuffle, as the HDF5 and Zarr shuffle filters, then
+// zlib deflate into out. Returns 0 on success, -1 on failure.
+
+	int
+WriteOutput::_shuffleDeflate(const unsigned char* bytes, size_t nCells,
+		size_t elemSize, int level, std::vector<unsigned char>& shuffled,
+		std::vector<unsigned char>& out)
+{
+	const size_t nBytes = nCells * elemSize;
+	shuffled.resize(std::max(shuffled.size(), nBytes));
+	for (size_t b = 0; b < elemSize; b++) {
+		for (size_t n = 0; n < nCells; n++) {
+			shuffled[b * nCells + n] = bytes[n * elemSize + b];
+		}
+	}
+
+	uLongf destLen = compressBound(nBytes);
+	out.resize(destLen);
+	if (compress2(out.data(), &destLen, shuffled.data(), nBytes, level) !=
+			Z_OK) {
+		return -1;
+	}
+	out.resize(destLen);
+	return 0;
+}
+
+/////////////////////////////////////////////////////
+// projection WKT: azimuthal equidistant, centred on the radar
+
+	std::string
+WriteOutput::_projectionWkt()
+{
+	stringstream prj_writer;
+	prj_writer << "PROJCS[\"World_Azimuthal_Equidistant\",";
+	prj_writer << "GEOGCS[\"GCS_WGS_1984\",";
+	prj_writer << "DATUM[\"D_WGS_1984\",";
+	prj_writer << "SPHEROID[\"WGS_1984\",6378137,298.257223563]],";
+	prj_writer << "PRIMEM[\"Greenwich\",0],";
+	prj_writer << "UNIT[\"Degree\",0.017453292519943295]],";
+	prj_writer << "PROJECTION[\"Azimuthal_Equidistant\"],";
+	prj_writer << "PARAMETER[\"False_Easting\",0],";
+	prj_writer << "PARAMETER[\"False_Northing\",0],";
+	prj_writer << "PARAMETER[\"Central_Meridian\"," << _store->longitude << "],";
+	prj_writer << "PARAMETER[\"Latitude_Of_Origin\"," << _store->latitude << "],";
+	prj_writer << "UNIT[\"Meter\",1]]";
+	return prj_writer.str();
+}
+
+/////////////////////////////////////////////////////
+// write out data as tiled, compressed GeoTIFF.
+// Each field goes to its own file, with one band per level,
+// or to one file per level, depending on raster_layout.
+// Files are written in parallel, and GDAL compresses the
+// tiles of each file on all cores.
+
+	int
+WriteOutput::_writeGeoTiff()
+{
+	static std::once_flag gdalRegistered;
+	std::call_once(gdalRegistered, []() { GDALAllRegister(); });
+
+	GDALDriver* driver = GetGDALDriverManager()->GetDriverByName("GTiff");
+	if (driver == NULL) {
+		std::cerr << "ERROR - WriteOutput::_writeGeoTiff" << std::endl;
+		std::cerr << "  GDAL GTiff driver not available" << std::endl;
+		return -1;
+	}
+
+	std::string outputFileName("grd_");
+	outputFileName += _store->instrumentName;
+	outputFileName += "_";
+	outputFileName += _store->startDateTime;
+	std::replace(outputFileName.begin(), outputFileName.end(), ':', '_');
+
+	const int nx = _grid->getGridDimX();
+	const int ny = _grid->getGridDimY();
+	const int nz = _grid->getGridDimZ();
+	const Params::grid_xy_geom_t xyGeom = _grid->getStructXYGeom();
+	const Params::grid_z_geom_t zGeom = _grid->getStructZGeom();
+	const std::string wkt = _projectionWkt();
+
+	// north-up, origin at the top-left corner of the top-left cell
+	double geoTransform[6] = {
+		(xyGeom.minx - 0.5 * xyGeom.dx) * 1000.0, xyGeom.dx * 1000.0, 0.0,
+		(xyGeom.miny + (ny - 0.5) * xyGeom.dy) * 1000.0, 0.0, -xyGeom.dy * 1000.0
+	};
+
+	// tile size must be a multiple of 16
+	int tileSize = std::max(16, (_params.raster_tile_size / 16) * 16);
+	char tileStr[32];
+	sprintf(tileStr, "%d", tileSize);
+	char** options = NULL;
+	options = CSLSetNameValue(options, "TILED", "YES");
+	options = CSLSetNameValue(options, "BLOCKXSIZE", tileStr);
+	options = CSLSetNameValue(options, "BLOCKYSIZE", tileStr);
+	options = CSLSetNameValue(options, "BIGTIFF", "IF_SAFER");
+	// the files are written in parallel, one per task, so GDAL compresses
+	// each in the calling thread only
+	options = CSLSetNameValue(options, "NUM_THREADS", "1");
+	if (_params.raster_compression == Params::RASTER_COMPRESS_LZW) {
+		options = CSLSetNameValue(options, "COMPRESS", "LZW");
+		options = CSLSetNameValue(options, "PREDICTOR", "3");
+	} else if (_params.raster_compression == Params::RASTER_COMPRESS_DEFLATE) {
+		options = CSLSetNameValue(options, "COMPRESS", "DEFLATE");
+		options = CSLSetNameValue(options, "PREDICTOR", "3");
+	}
+
+	// overview factors, until the overview fits in one tile
+	std::vector<int> overviews;
+	if (_params.raster_build_overviews) {
+		for (int factor = 2; std::max(nx, ny) / (factor / 2) > tileSize;
+				factor *= 2) {
+			overviews.push_back(factor);
+		}
+	}
+
+	// one job per output file
+	struct Job
+	{
+		std::string path;
+		const vector3d<double>* grid;
+		const DerivedProduct* product;
+		int k0, nk;
+	};
+	std::vector<Job> jobs;
+	for (const auto& kv : _grid->getOutputFinalGrid()) {
+		const std::string& field_name = kv.first;
+		if (_params.raster_layout == Params::RASTER_FILE_PER_LEVEL) {
+			for (int z = 0; z < nz; z++) {
+				double h = (zGeom.minz + z * zGeom.dz) * 1000.0; // Convert to meters
+				char h_cstr[16];
 				sprintf(h_cstr, "%05.0f", h);
-				string h_str(h_cstr);
-				// Write projection file
-				ofstream prj_file;
-				prj_file.open(outputFileName + "_" + h_str + "_" + field_name + ".prj",
-						std::ios::trunc);
-				prj_file << prj_writer.str();
-				prj_file.flush();
-				prj_file.close();
-
-				// Write grid file
-				ofstream grd_file;
-				grd_file.open(outputFileName + "_" + h_str + "_" + field_name + ".asc",
-						std::ios::trunc);
-				auto ref_grid = kv.second;
-				grd_file << "NCOLS " << _params.grid_xy_geom.nx << std::endl;
-				grd_file << "NROWS " << _params.grid_xy_geom.ny << std::endl;
-				grd_file << "XLLCENTER " << _params.grid_xy_geom.minx * 1000.0
-					<< std::endl;
-				grd_file << "YLLCENTER " << _params.grid_xy_geom.miny * 1000.0
-					<< std::endl;
-				grd_file << "CELLSIZE " << _params.grid_xy_geom.dx * 1000.0 << std::endl;
-				grd_file << "NODATA_VALUE " << INVALID_DATA << std::endl;
-
-				for (int j = _grid->getGridDimY() - 1; j >= 0; --j) {
-					for (int i = 0; i < _grid->getGridDimX(); i++) {
-						grd_file << (*ref_grid)[i][j][z] << " ";
+				jobs.push_back({ outputFileName + "_" + h_cstr + "_" + field_name +
+						".tif", kv.second.get(), nullptr, z, 1 });
+			}
+		} else {
+			jobs.push_back({ outputFileName + "_" + field_name + ".tif",
+					kv.second.get(), nullptr, 0, nz });
+		}
+	}
+	// derived 2D products, one band
+	for (const auto& kv : _grid->getDerivedProducts()) {
+		jobs.push_back({ outputFileName + "_" + kv.first + ".tif", nullptr,
+				&kv.second, 0, 1 });
+	}
+
+	std::atomic<int> nFailed(0);
+	tbb::parallel_for(size_t(0), jobs.size(), [&](size_t ijob) {
+		const Job& job = jobs[ijob];
+		TraceSpan span("writeGeoTiff", "write");
+
+		GDALDataset* ds = driver->Create(job.path.c_str(), nx, ny, job.nk,
+				GDT_Float32, options);
+		if (ds == NULL) {
+			std::cerr << "ERROR - WriteOutput::_writeGeoTiff" << std::endl;
+			std::cerr << "  Cannot create file: " << job.path << std::endl;
+			nFailed++;
+			return;
+		}
+		ds->SetGeoTransform(geoTransform);
+		ds->SetProjection(wkt.c_str());
+
+		std::vector<float> plane(size_t(nx) * ny);
+		bool ok = true;
+		for (int b = 0; b < job.nk && ok; b++) {
+			const int k = job.k0 + b;
+
+			// rows run north to south
+			for (int j = 0; j < ny; j++) {
+				float* row = plane.data() + size_t(ny - 1 - j) * nx;
+				if (job.product != nullptr) {
+					std::copy_n(job.product->data.data() + size_t(j) * nx, nx, row);
+					continue;
+				}
+				const vector3d<double>& grid = *job.grid;
+				for (int i = 0; i < nx; i++) {
+					row[i] = static_cast<float>(grid[i][j][k]);
+				}
+			}
+
+			GDALRasterBand* band = ds->GetRasterBand(b + 1);
+			band->SetNoDataValue(INVALID_DATA);
+			char desc[64];
+			if (job.product != nullptr) {
+				snprintf(desc, sizeof(desc), "%s (%s)",
+						job.product->longName.c_str(), job.product->units.c_str());
+			} else {
+				sprintf(desc, "%.0f m", (zGeom.minz + k * zGeom.dz) * 1000.0);
+			}
+			band->SetDescription(desc);
+			ok = band->RasterIO(GF_Write, 0, 0, nx, ny, plane.data(), nx, ny,
+					GDT_Float32, 0, 0) == CE_None;
+		}
+
+		if (ok && !overviews.empty()) {
+			ok = ds->BuildOverviews("AVERAGE", int(overviews.size()),
+					overviews.data(), 0, NULL, NULL, NULL) == CE_None;
+		}
+		GDALClose(ds);
+
+		if (!ok) {
+			std::cerr << "ERROR - WriteOutput::_writeGeoTiff" << std::endl;
+			std::cerr << "  Cannot write file: " << job.path << std::endl;
+			nFailed++;
+		}
+	});
+
+	CSLDestroy(options);
+	return nFailed > 0 ? -1 : 0;
+}
+
+/////////////////////////////////////////////////////
+// write out data as a Zarr v2 directory store. Each field
+// is an array of (1, cs, cs) chunks over (z0, y0, x0), each
+// chunk in its own file, so a reader fetches one tile of one
+// level with one read. Chunks are gathered, shuffled and
+// deflated and written in parallel. Array metadata are in
+// .zarray/.zattrs files, and consolidated in .zmetadata.
+// Data are little-endian, as the hosts we run on.
+
+	int
+WriteOutput::_writeZarr()
+{
+	std::string storeName("zarr_");
+	storeName += _store->instrumentName;
+	storeName += "_";
+	storeName += _store->startDateTime;
+	std::replace(storeName.begin(), storeName.end(), ':', '-');
+	storeName += ".zarr";
+	std::cout << storeName << std::endl;
+
+	const size_t nx = _grid->getGridDimX();
+	const size_t ny = _grid->getGridDimY();
+	const size_t nz = _grid->getGridDimZ();
+	const Params::grid_xy_geom_t xyGeom = _grid->getStructXYGeom();
+	const Params::grid_z_geom_t zGeom = _grid->getStructZGeom();
+	const size_t cy = std::min(ny, size_t(_params.zarr_chunk_size));
+	const size_t cx = std::min(nx, size_t(_params.zarr_chunk_size));
+	const size_t nCells = cy * cx;
+	const int level = _params.zarr_compression_level;
+
+	auto fields = _grid->getOutputFinalGrid();
+	const map<string, PackedField>& packed = _grid->getPackedGrid();
+
+	if (_makeDir(storeName)) {
+		return -1;
+	}
+
+	// metadata documents, keyed by path in the store
+	std::vector<std::pair<std::string, std::string>> metadata;
+	metadata.push_back({ ".zgroup", "{\"zarr_format\": 2}" });
+	{
+		std::ostringstream attrs;
+		attrs << std::setprecision(9);
+		attrs << "{\"instrument_name\": \"" << _store->instrumentName
+			<< "\", \"start_datetime\": \"" << _store->startDateTime
+			<< "\", \"latitude\": " << _store->latitude
+			<< ", \"longitude\": " << _store->longitude << "}";
+		metadata.push_back({ ".zattrs", attrs.str() });
+	}
+
+	// coordinate variables, km from the radar, one uncompressed chunk each
+
+	struct Coord
+	{
+		std::string name;
+		std::vector<float> vals;
+	};
+	std::vector<Coord> coords = { { "x0", {} }, { "y0", {} }, { "z0", {} } };
+	for (size_t i = 0; i < nx; i++)
+		coords[0].vals.push_back(xyGeom.minx + i * xyGeom.dx);
+	for (size_t j = 0; j < ny; j++)
+		coords[1].vals.push_back(xyGeom.miny + j * xyGeom.dy);
+	for (size_t k = 0; k < nz; k++)
+		coords[2].vals.push_back(zGeom.minz + k * zGeom.dz);
+	for (const Coord& coord : coords) {
+		const std::string dir = storeName + "/" + coord.name;
+		if (_makeDir(dir) ||
+				_writeFile(dir + "/0", coord.vals.data(),
+					coord.vals.size() * sizeof(float))) {
+			std::cerr << "ERROR - WriteOutput::_writeZarr" << std::endl;
+			std::cerr << "  Cannot write coordinate: " << dir << std::endl;
+			return -1;
+		}
+		std::ostringstream zarray;
+		zarray << "{\"zarr_format\": 2, \"shape\": [" << coord.vals.size()
+			<< "], \"chunks\": [" << coord.vals.size()
+			<< "], \"dtype\": \"<f4\", \"compressor\": null, "
+			<< "\"fill_value\": null, \"filters\": null, \"order\": \"C\"}";
+		metadata.push_back({ coord.name + "/.zarray", zarray.str() });
+		metadata.push_back({ coord.name + "/.zattrs",
+				"{\"_ARRAY_DIMENSIONS\": [\"" + coord.name +
+				"\"], \"units\": \"km\"}" });
+	}
+
+	// field arrays
+
+	struct Chunk
+	{
+		std::string path;
+		const vector3d<double>* grid;
+		const PackedField* packed;
+		const DerivedProduct* product;
+		size_t k, j0, i0;
+	};
+	std::vector<Chunk> chunks;
+	for (auto const& field : fields) {
+		auto pf = packed.find(field.first);
+		const PackedField* p = pf == packed.end() ? nullptr : &pf->second;
+		const std::string dir = storeName + "/" + field.first;
+		if (_makeDir(dir)) {
+			return -1;
+		}
+
+		std::ostringstream zarray;
+		zarray << std::setprecision(9);
+		zarray << "{\"zarr_format\": 2, \"shape\": [" << nz << ", " << ny
+			<< ", " << nx << "], \"chunks\": [1, " << cy << ", " << cx << "], ";
+		if (p == nullptr) {
+			zarray << "\"dtype\": \"<f4\", \"fill_value\": " << INVALID_DATA_F;
+		} else {
+			zarray << "\"dtype\": \"" << (p->nBytes == 1 ? "|i1" : "<i2")
+				<< "\", \"fill_value\": " << p->fillValue;
+		}
+		const size_t elemSize = p == nullptr ? sizeof(float) : p->nBytes;
+		if (level > 0) {
+			zarray << ", \"compressor\": {\"id\": \"zlib\", \"level\": "
+				<< level << "}, \"filters\": [{\"id\": \"shuffle\", "
+				<< "\"elementsize\": " << elemSize << "}]";
+		} else {
+			zarray << ", \"compressor\": null, \"filters\": null";
+		}
+		zarray << ", \"order\": \"C\"}";
+		metadata.push_back({ field.first + "/.zarray", zarray.str() });
+
+		std::ostringstream attrs;
+		attrs << std::setprecision(9);
+		attrs << "{\"_ARRAY_DIMENSIONS\": [\"z0\", \"y0\", \"x0\"]";
+		if (p != nullptr) {
+			attrs << ", \"scale_factor\": " << static_cast<float>(p->scaleFactor)
+				<< ", \"add_offset\": " << static_cast<float>(p->addOffset);
+		}
+		attrs << "}";
+		metadata.push_back({ field.first + "/.zattrs", attrs.str() });
+
+		// chunk keys are <k>.<j>.<i> chunk indices. Missing chunks
+		// read as fill_value, so untouched regions of a sparse grid
+		// are not written.
+		for (size_t k = 0; k < nz; k++) {
+			for (size_t j0 = 0; j0 < ny; j0 += cy) {
+				for (size_t i0 = 0; i0 < nx; i0 += cx) {
+					if (_grid->isEmptyRegion(field.first, i0,
+								std::min(i0 + cx, nx) - 1, j0, std::min(j0 + cy, ny) - 1,
+								k, k)) {
+						continue;
 					}
-					grd_file << std::endl;
+					std::ostringstream path;
+					path << dir << "/" << k << "." << j0 / cy << "." << i0 / cx;
+					chunks.push_back(
+							{ path.str(), field.second.get(), p, nullptr, k, j0, i0 });
 				}
-				grd_file.close();
 			}
 		}
+	}
 
-	} else {
-		// Show a warning that outputs format are not supported
-		std::cerr << "The output format specified is not supported" << std::endl;
+	// derived 2D products, (y0, x0) with the same tiles
+
+	std::string zarrayCompressor = ", \"compressor\": null, \"filters\": null";
+	if (level > 0) {
+		std::ostringstream compressor;
+		compressor << ", \"compressor\": {\"id\": \"zlib\", \"level\": "
+			<< level << "}, \"filters\": [{\"id\": \"shuffle\", "
+			<< "\"elementsize\": " << sizeof(float) << "}]";
+		zarrayCompressor = compressor.str();
+	}
+	for (auto const& product : _grid->getDerivedProducts()) {
+		const std::string dir = storeName + "/" + product.first;
+		if (_makeDir(dir)) {
+			return -1;
+		}
+		std::ostringstream zarray;
+		zarray << "{\"zarr_format\": 2, \"shape\": [" << ny << ", " << nx
+			<< "], \"chunks\": [" << cy << ", " << cx
+			<< "], \"dtype\": \"<f4\", \"fill_value\": " << INVALID_DATA_F
+			<< zarrayCompressor << ", \"order\": \"C\"}";
+		metadata.push_back({ product.first + "/.zarray", zarray.str() });
+		metadata.push_back({ product.first + "/.zattrs",
+				"{\"_ARRAY_DIMENSIONS\": [\"y0\", \"x0\"], \"long_name\": \"" +
+				product.second.longName + "\", \"units\": \"" +
+				product.second.units + "\"}" });
+		for (size_t j0 = 0; j0 < ny; j0 += cy) {
+			for (size_t i0 = 0; i0 < nx; i0 += cx) {
+				std::ostringstream path;
+				path << dir << "/" << j0 / cy << "." << i0 / cx;
+				chunks.push_back(
+						{ path.str(), nullptr, nullptr, &product.second, 0, j0, i0 });
+			}
+		}
+	}
+
+	std::atomic<int> nFailed(0);
+	{
+		TraceSpan span("writeZarrChunks", "write");
+		tbb::parallel_for(tbb::blocked_range<size_t>(0, chunks.size()),
+				[&](const tbb::blocked_range<size_t>& r) {
+			std::vector<unsigned char> vals(nCells * sizeof(float));
+			std::vector<unsigned char> shuffled(vals.size());
+			std::vector<unsigned char> deflated;
+			for (size_t ic = r.begin(); ic != r.end(); ic++) {
+				const Chunk& chunk = chunks[ic];
+				size_t elemSize = sizeof(float);
+				if (chunk.product != nullptr) {
+					float* tile = reinterpret_cast<float*>(vals.data());
+					const float* plane = chunk.product->data.data();
+					const size_t rowLen = std::min(cx, nx - chunk.i0);
+					std::fill_n(tile, nCells, INVALID_DATA_F);
+					for (size_t jj = 0; jj < cy && chunk.j0 + jj < ny; jj++) {
+						std::copy_n(plane + (chunk.j0 + jj) * nx + chunk.i0, rowLen,
+								tile + jj * cx);
+					}
+				} else {
+					elemSize = _gatherChunk(*chunk.grid, chunk.packed, chunk.k,
+							chunk.j0, chunk.i0, cy, cx, vals.data());
+				}
+				int iret = 0;
+				if (level > 0) {
+					iret = _shuffleDeflate(vals.data(), nCells, elemSize, level,
+							shuffled, deflated) ||
+						_writeFile(chunk.path, deflated.data(), deflated.size());
+				} else {
+					iret = _writeFile(chunk.path, vals.data(), nCells * elemSize);
+				}
+				if (iret) {
+					std::cerr << "ERROR - WriteOutput::_writeZarr" << std::endl;
+					std::cerr << "  Cannot write chunk: " << chunk.path << std::endl;
+					nFailed++;
+				}
+			}
+		});
+	}
+	if (nFailed > 0) {
 		return -1;
 	}
 
+	// metadata last, so a store with metadata has all its chunks
+
+	std::string consolidated =
+		"{\"zarr_consolidated_format\": 1, \"metadata\": {";
+	for (size_t ii = 0; ii < metadata.size(); ii++) {
+		const std::string& key = metadata[ii].first;
+		const std::string& doc = metadata[ii].second;
+		consolidated += (ii ? ", \"" : "\"") + key + "\": " + doc;
+		if (_writeFile(storeName + "/" + key, doc.data(), doc.size())) {
+			std::cerr << "ERROR - WriteOutput::_writeZarr" << std::endl;
+			std::cerr << "  Cannot write metadata: " << key << std::endl;
+			return -1;
+		}
+	}
+	consolidated += "}}";
+	if (_writeFile(storeName + "/.zmetadata", consolidated.data(),
+				consolidated.size())) {
+		std::cerr << "ERROR - WriteOutput::_writeZarr" << std::endl;
+		std::cerr << "  Cannot write metadata: .zmetadata" << std::endl;
+		return -1;
+	}
 	return 0;
 }
@@ -4,6 +4,7 @@
 #include "Cart2Grid.hh"
 #include "PolarDataStream.hh"
 #include <memory>
+#include <string>
 #include <vector>
 
 class WriteOutput
@@ -16,6 +17,21 @@ public:
   int writeOutputFile();
 
 private:
+  int _writeNetCDF();
+  std::vector<size_t> _chunkShape();
+  int _writeCompressedChunks(const std::string& path,
+                             const std::vector<size_t>& chunkShape);
+  size_t _gatherChunk(const vector3d<double>& grid, const PackedField* packed,
+                      size_t k, size_t j0, size_t i0, size_t cy, size_t cx,
+                      unsigned char* dest);
+  static int _shuffleDeflate(const unsigned char* bytes, size_t nCells,
+                             size_t elemSize, int level,
+                             std::vector<unsigned char>& shuffled,
+                             std::vector<unsigned char>& out);
+  std::string _projectionWkt();
+  int _writeGeoTiff();
+  int _writeZarr();
+
   std::shared_ptr<Cart2Grid> _grid;
   std::shared_ptr<Repository> _store;
   const Params& _params;
@@ -0,0 +1,172 @@
+#!/bin/bash
+#
+# Golden-output regression test and end-to-end benchmark for Radx2Grid.
+#
+# Grids the input volumes with a legacy interpolator (INTERP_MODE_CART by
+# default) and with Radx2GridPlus (INTERP_MODE_CART_MAP), using the same
+# params file for both, then compares the grids with Radx2GridCompare.
+# Exits non-zero if any field of any volume is outside the tolerances.
+# Wall times of the two paths are reported alongside.
+#
+# Usage: run_regression.sh [options]
+#   -b dir     directory holding Radx2Grid and Radx2GridCompare (default .)
+#   -p file    params file (default ./Radx2Grid.params)
+#   -i dir     input volumes (default ../../../../KCLE2012122617/20121226)
+#   -w dir     work dir (default /tmp/Radx2Grid_regression)
+#   -l mode    legacy interp_mode (default INTERP_MODE_CART)
+#   -g dir     compare with stored golden grids in dir, instead of
+#              running the legacy path
+#   -n reps    runs of each path for the wall-time benchmark (default 1)
+#   -f fields  comma-separated fields to compare (default REF)
+#   -t args    tolerance args for Radx2GridCompare, e.g.
+#              "-max_rmse 1.5 -max_coverage_diff 0.05"
+#   -s         also run the fast path with superob_gates, and compare it
+#              with the per-gate fast path grids
+
+bin_dir=.
+params=./Radx2Grid.params
+input_dir=../../../../KCLE2012122617/20121226
+work_dir=/tmp/Radx2Grid_regression
+legacy_mode=INTERP_MODE_CART
+golden_dir=
+reps=1
+fields=REF
+tolerances=
+superob=
+
+while getopts "b:p:i:w:l:g:n:f:t:sh" opt; do
+  case $opt in
+    b) bin_dir=$OPTARG ;;
+    p) params=$OPTARG ;;
+    i) input_dir=$OPTARG ;;
+    w) work_dir=$OPTARG ;;
+    l) legacy_mode=$OPTARG ;;
+    g) golden_dir=$OPTARG ;;
+    n) reps=$OPTARG ;;
+    f) fields=$OPTARG ;;
+    t) tolerances=$OPTARG ;;
+    s) superob=1 ;;
+    *) sed -n '3,24p' "$0"; exit 1 ;;
+  esac
+done
+
+abspath() { (cd "$(dirname "$1")" && echo "$(pwd)/$(basename "$1")"); }
+
+radx2grid=$(abspath "$bin_dir/Radx2Grid")
+compare=$(abspath "$bin_dir/Radx2GridCompare")
+params=$(abspath "$params")
+inputs=$(ls "$(abspath "$input_dir")"/*.nc 2>/dev/null)
+if [ -z "$inputs" ]; then
+  echo "ERROR - no input volumes in $input_dir" >&2
+  exit 1
+fi
+
+rm -rf "$work_dir"
+mkdir -p "$work_dir/legacy" "$work_dir/fast" "$work_dir/superob"
+
+# same params for both paths, apart from the interpolation mode
+
+make_params() {
+  sed -e "s/^interp_mode = .*;/interp_mode = $1;/" \
+      -e "s/^output_format = .*;/output_format = CF_NETCDF;/" \
+      -e "s|^output_dir = .*;|output_dir = \"$2\";|" \
+      -e "/^superob_gates = .*;/d" \
+      "$params" > "$3"
+  echo "superob_gates = ${4:-FALSE};" >> "$3"
+}
+make_params "$legacy_mode" "$work_dir/legacy" "$work_dir/legacy.params"
+make_params INTERP_MODE_CART_MAP "$work_dir/fast" "$work_dir/fast.params"
+make_params INTERP_MODE_CART_MAP "$work_dir/superob" \
+  "$work_dir/superob.params" TRUE
+
+# run one path reps times, printing the wall time of each run
+
+run_path() {
+  local name=$1 dir=$2 params_file=$3
+  for ((irep = 0; irep < reps; irep++)); do
+    local start end
+    start=$(date +%s.%N)
+    (cd "$dir" && "$radx2grid" -params "$params_file" -f $inputs) \
+      > "$work_dir/$name.log" 2>&1
+    if [ $? -ne 0 ]; then
+      echo "ERROR - $name run failed, see $work_dir/$name.log" >&2
+      exit 1
+    fi
+    end=$(date +%s.%N)
+    echo "$end $start" | awk '{ printf "%.3f\n", $1 - $2 }'
+  done
+}
+
+summarize() {
+  sort -n | awk -v name="$1" '
+    { t[NR] = $1; sum += $1 }
+    END { printf "%-8s runs %d  min %.3f s  median %.3f s  mean %.3f s\n",
+          name, NR, t[1], t[int((NR + 1) / 2)], sum / NR }'
+}
+
+echo "Benchmark, $(echo $inputs | wc -w) volumes:"
+fast_times=$(run_path fast "$work_dir/fast" "$work_dir/fast.params") || exit 1
+echo "$fast_times" | summarize fast
+if [ -n "$superob" ]; then
+  superob_times=$(run_path superob "$work_dir/superob" \
+                  "$work_dir/superob.params") || exit 1
+  echo "$superob_times" | summarize superob
+fi
+if [ -z "$golden_dir" ]; then
+  legacy_times=$(run_path legacy "$work_dir/legacy" \
+                 "$work_dir/legacy.params") || exit 1
+  echo "$legacy_times" | summarize legacy
+  echo "$legacy_times $fast_times" | awk -v reps="$reps" '
+    { for (i = 1; i <= reps; i++) { l += $i; f += $(i + reps) } }
+    END { if (f > 0) printf "speedup  %.2fx\n", l / f }'
+  golden_dir=$work_dir/legacy
+fi
+
+# pair the grids in time order and compare
+
+golden_files=($(find "$golden_dir" -name "*.nc" | sort))
+test_files=($(find "$work_dir/fast" -name "*.ncf" | sort))
+if [ ${#golden_files[@]} -ne ${#test_files[@]} ]; then
+  echo "ERROR - ${#golden_files[@]} golden grids but" \
+       "${#test_files[@]} fast path grids" >&2
+  exit 1
+fi
+
+echo
+echo "Comparison with $golden_dir:"
+status=0
+header=
+for ((ii = 0; ii < ${#golden_files[@]}; ii++)); do
+  "$compare" $header -fields "$fields" $tolerances \
+    "${golden_files[$ii]}" "${test_files[$ii]}" || status=1
+  header=-no_header
+done
+
+if [ $status -ne 0 ]; then
+  echo "FAILED - fast path differs from $legacy_mode beyond tolerances"
+fi
+
+# superobbing accuracy, against gridding each gate
+
+if [ -n "$superob" ]; then
+  superob_files=($(find "$work_dir/superob" -name "*.ncf" | sort))
+  echo
+  echo "Superobbing, compared with the per-gate fast path:"
+  superob_status=0
+  header=
+  for ((ii = 0; ii < ${#test_files[@]}; ii++)); do
+    "$compare" $header -fields "$fields" $tolerances \
+      "${test_files[$ii]}" "${superob_files[$ii]}" || superob_status=1
+    header=-no_header
+  done
+  if [ $superob_status -ne 0 ]; then
+    echo "FAILED - superobbing differs from per-gate gridding beyond" \
+         "tolerances"
+    status=1
+  fi
+fi
+
+if [ $status -eq 0 ]; then
+  echo "PASSED"
+fi
+exit $status
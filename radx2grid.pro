@@ -22,26 +22,38 @@ INCLUDEPATH += \
 # Input
 HEADERS += \
            apps/Radx/src/Radx2Grid/Args.hh \
+           apps/Radx/src/Radx2Grid/BrickGrid.hh \
+           apps/Radx/src/Radx2Grid/BucketIndex.hh \
            apps/Radx/src/Radx2Grid/CartInterp.hh \
+           apps/Radx/src/Radx2Grid/FastTransform.hh \
+           apps/Radx/src/Radx2Grid/FlatKdTree.hh \
            apps/Radx/src/Radx2Grid/Interp.hh \
+           apps/Radx/src/Radx2Grid/LeastSquares.hh \
            apps/Radx/src/Radx2Grid/OutputMdv.hh \
            apps/Radx/src/Radx2Grid/Params.hh \
            apps/Radx/src/Radx2Grid/PolarInterp.hh \
            apps/Radx/src/Radx2Grid/PpiInterp.hh \
+           apps/Radx/src/Radx2Grid/RadiusOfInfluence.hh \
            apps/Radx/src/Radx2Grid/Radx2Grid.hh \
            apps/Radx/src/Radx2Grid/Radx2GridPlus.hh \
            apps/Radx/src/Radx2Grid/ReorderInterp.hh \
            apps/Radx/src/Radx2Grid/SatInterp.hh \
+           apps/Radx/src/Radx2Grid/SpaceFillingCurve.hh \
+           apps/Radx/src/Radx2Grid/SpatialIndex.hh \
            apps/Radx/src/Radx2Grid/SvdData.hh \
            apps/Radx/src/Radx2Grid/Thread.hh \
            apps/Radx/src/Radx2Grid/PolarDataStream.hh \
            apps/Radx/src/Radx2Grid/Polar2Cartesian.hh \
            apps/Radx/src/Radx2Grid/ThreadQueue.hh \
+           apps/Radx/src/Radx2Grid/PerfCounters.hh \
+           apps/Radx/src/Radx2Grid/TraceEvents.hh \
            apps/Radx/src/Radx2Grid/WriteOutput.hh \
            apps/Radx/src/Radx2Grid/Cart2Grid.hh
 
 SOURCES += apps/Radx/src/Radx2Grid/Args.cc \
+           apps/Radx/src/Radx2Grid/BucketIndex.cpp \
            apps/Radx/src/Radx2Grid/CartInterp.cc \
+           apps/Radx/src/Radx2Grid/FlatKdTree.cpp \
            apps/Radx/src/Radx2Grid/Interp.cc \
            apps/Radx/src/Radx2Grid/Main.cc \
            apps/Radx/src/Radx2Grid/OutputMdv.cc \
@@ -51,11 +63,15 @@ SOURCES += apps/Radx/src/Radx2Grid/Args.cc \
            apps/Radx/src/Radx2Grid/PolarInterp.cc \
            apps/Radx/src/Radx2Grid/PpiInterp.cc \
            apps/Radx/src/Radx2Grid/Radx2Grid.cc \
+           apps/Radx/src/Radx2Grid/RadiusOfInfluence.cpp \
            apps/Radx/src/Radx2Grid/Radx2GridPlus.cc \
            apps/Radx/src/Radx2Grid/ReorderInterp.cc \
            apps/Radx/src/Radx2Grid/SatInterp.cc \
+           apps/Radx/src/Radx2Grid/SpatialIndex.cpp \
            apps/Radx/src/Radx2Grid/SvdData.cc \
            apps/Radx/src/Radx2Grid/Thread.cc \
+           apps/Radx/src/Radx2Grid/PerfCounters.cpp \
+           apps/Radx/src/Radx2Grid/TraceEvents.cpp \
            apps/Radx/src/Radx2Grid/WriteOutput.cpp \
            apps/Radx/src/Radx2Grid/Cart2Grid.cpp
 
@@ -79,6 +95,7 @@ LIBS += -lradar \
     -lnetcdf_c++4 \
     -lnetcdf_c++ \
     -lnetcdf \
+    -lgdal \
     -lhdf5_cpp \
     -lhdf5_hl \
     -lhdf5 \